@@ -0,0 +1,501 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <atomic>
+
+#include "utility.h"
+#include "plctags.h"
+#include "list_tags.h"
+#include "tag_table.h"
+#include "udt_layout.h"
+
+using namespace std::chrono;
+
+
+#define BENCH_DEFAULT_GATEWAY "127.0.0.1"
+#define BENCH_DEFAULT_CONCURRENCY 16
+#define BENCH_DEFAULT_DURATION_S 10.0
+#define BENCH_DEFAULT_WARMUP_S 2.0
+
+#define BENCH_USAGE \
+    "Usage: plctagt bench [options]\n" \
+    "  --gateway IP        PLC address (default " BENCH_DEFAULT_GATEWAY ")\n" \
+    "  --path PATH         CIP path (default " DEFAULT_PATH ")\n" \
+    "  --cpu CPU           PLC type (default " DEFAULT_CPU ")\n" \
+    "  --protocol P        libplctag protocol (default " DEFAULT_PROTOCOL ")\n" \
+    "  --attrs A           extra tag attributes, e.g. allow_packing=0 for ab_server\n" \
+    "  --tags LIST         Name:TYPE[count],... tags to read (TYPE and count optional)\n" \
+    "  --filter TEXT       list the controller and read every tag whose name contains TEXT\n" \
+    "  --concurrency N     reads kept in flight (default 16)\n" \
+    "  --duration S        measured seconds (default 10)\n" \
+    "  --warmup S          unmeasured seconds first (default 2)\n" \
+    "  --json FILE         also write the results as JSON, - for stdout instead of the table\n" \
+    "  --histograms        add the per operation/type latency histograms (create, read) to the output\n" \
+    "  --accessor-threads N  instead of network reads, time plc_tag_get_* calls on the read data from\n" \
+    "                      1, 2, 4 .. N threads, each on its own handles, --duration seconds per step\n"
+
+
+struct BenchTag {
+    string name;
+    string type;
+    int count;
+    uint16_t cip_type;      /* 0 until the first read tells, for untyped specs */
+};
+
+struct BenchStats {
+    int64_t reads = 0;
+    int64_t errors = 0;
+    vector<int64_t> latency_us;
+};
+
+struct BenchLane {
+    int32_t handle;
+    size_t tag_index;
+    uint16_t cip_type;
+    BenchStats *stats;      /* per type bucket, resolved once so completions do no map lookups */
+    steady_clock::time_point started;
+    bool in_flight;
+    uint32_t seq;           /* the read in flight, bumped by issue() */
+    uint32_t started_seq;   /* set by the callback on READ_STARTED */
+};
+
+struct BenchQueue {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::pair<BenchLane *, int32_t>> completed;
+};
+
+static BenchQueue *bench_queue = nullptr;
+
+/* set around plc_tag_read(), which delivers the events still pending on the handle itself */
+static thread_local bool bench_issuing = false;
+
+
+/*
+ * Timeouts are handled (and aborted) by the bench loop itself. The READ_COMPLETED of an aborted read can
+ * still be pending on the handle; the library delivers it before the next read's READ_STARTED or inside
+ * the plc_tag_read() that starts it, and it must not count as that read's result or latency.
+ */
+static void benchCallback(int32_t tag, int event, int status, void *userdata) {
+    (void)tag;
+
+    BenchLane *lane = static_cast<BenchLane *>(userdata);
+
+    if(event == PLCTAG_EVENT_READ_STARTED) {
+        lane->started_seq = lane->seq;
+        return;
+    }
+
+    if(event != PLCTAG_EVENT_READ_COMPLETED || bench_issuing || lane->started_seq != lane->seq) { return; }
+
+    {
+        std::lock_guard<std::mutex> lock(bench_queue->mutex);
+        bench_queue->completed.push_back({ lane, status });
+    }
+    bench_queue->cv.notify_one();
+}
+
+
+/*
+ * Accessor scaling: every handle has been read once, then 1, 2, 4 .. max_threads threads each spin
+ * on the getters of their own share of the handles. Nothing goes on the wire, so this measures the
+ * library's handle lookup and tag locking; calls/s should grow with the thread count up to the
+ * number of cores.
+ */
+static std::atomic<uint32_t> bench_sink{0};
+
+static int benchAccessors(const vector<int32_t> &handles, int max_threads, double duration_s, const string &json_file) {
+    struct Step {
+        int threads;
+        int64_t calls;
+        double calls_per_s;
+    };
+    vector<Step> steps;
+
+    for(int threads = 1;; threads = min(threads * 2, max_threads)) {
+        std::atomic<bool> go{false}, stop{false};
+        vector<int64_t> calls(threads, 0);
+        vector<std::thread> workers;
+
+        for(int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                vector<int32_t> mine;
+                for(size_t i = (size_t)t; i < handles.size(); i += (size_t)threads) mine.push_back(handles[i]);
+
+                int64_t n = 0;
+                uint32_t sink = 0;
+                while(!go) std::this_thread::yield();
+                while(!stop) {
+                    for(int32_t handle : mine) sink += plc_tag_get_uint8(handle, 0) + (uint32_t)plc_tag_get_size(handle);
+                    n += (int64_t)mine.size() * 2;
+                }
+                calls[t] = n;
+                bench_sink += sink;     /* keeps the getters from being optimized away */
+            });
+        }
+
+        auto start = steady_clock::now();
+        go = true;
+        std::this_thread::sleep_for(duration<double>(duration_s));
+        stop = true;
+        for(auto &w : workers) w.join();
+        double seconds = duration<double>(steady_clock::now() - start).count();
+
+        int64_t total = 0;
+        for(int64_t n : calls) total += n;
+        steps.push_back({ threads, total, total / seconds });
+
+        if(threads == max_threads) break;
+    }
+
+    if(json_file != "-") {
+        printf("%zu handles, %.1fs per step, %u hardware threads\n", handles.size(), duration_s, std::thread::hardware_concurrency());
+        printf("%8s %14s %14s %14s %8s\n", "THREADS", "CALLS", "CALLS/S", "PER THREAD/S", "SCALING");
+        for(const auto &step : steps) {
+            printf("%8d %14lld %14.0f %14.0f %8.2f\n", step.threads, (long long)step.calls, step.calls_per_s,
+                   step.calls_per_s / step.threads, step.calls_per_s / steps[0].calls_per_s);
+        }
+    }
+
+    if(!json_file.empty()) {
+        string out = ssprintf("{\"handles\": %zu, \"duration_s\": %.3f, \"hardware_threads\": %u, \"accessors\": [", handles.size(),
+                              duration_s, std::thread::hardware_concurrency());
+        for(size_t i = 0; i < steps.size(); i++) {
+            out += ssprintf("%s{\"threads\": %d, \"calls\": %lld, \"calls_per_s\": %.1f}", i ? ", " : "", steps[i].threads,
+                            (long long)steps[i].calls, steps[i].calls_per_s);
+        }
+        out += "]}\n";
+
+        FILE *fp = json_file == "-" ? stdout : fopen(json_file.c_str(), "w");
+        if(!fp) {
+            fprintf(stderr, "Unable to write %s\n", json_file.c_str());
+            return 1;
+        }
+        fputs(out.c_str(), fp);
+        if(fp != stdout) fclose(fp);
+    }
+
+    return 0;
+}
+
+
+static int64_t percentile(const vector<int64_t> &sorted, double p) {
+    if(sorted.empty()) return 0;
+    size_t index = (size_t)std::ceil(p / 100.0 * (double)sorted.size());
+    return sorted[index > 0 ? index - 1 : 0];
+}
+
+
+int bench(int argc, char **argv) {
+    string gateway = BENCH_DEFAULT_GATEWAY, path = DEFAULT_PATH, cpu = DEFAULT_CPU, protocol = DEFAULT_PROTOCOL;
+    string attrs, filter, json_file;
+    bool histograms = false;
+    int concurrency = BENCH_DEFAULT_CONCURRENCY;
+    int accessor_threads = 0;
+    double duration_s = BENCH_DEFAULT_DURATION_S;
+    double warmup_s = BENCH_DEFAULT_WARMUP_S;
+    vector<BenchTag> tags;
+
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if(arg == "--help" || arg == "-h") {
+            fputs(BENCH_USAGE, stdout);
+            return 0;
+        } else if(arg == "--histograms") {
+            histograms = true;
+            continue;
+        } else if(!has_value) {
+            fprintf(stderr, "Missing value for %s\n%s", arg.c_str(), BENCH_USAGE);
+            return 1;
+        }
+
+        string value = argv[++i];
+        if(arg == "--gateway") {
+            gateway = value;
+        } else if(arg == "--path") {
+            path = value;
+        } else if(arg == "--cpu") {
+            cpu = value;
+        } else if(arg == "--protocol") {
+            protocol = value;
+        } else if(arg == "--attrs") {
+            attrs = value;
+        } else if(arg == "--filter") {
+            filter = value;
+        } else if(arg == "--concurrency") {
+            concurrency = max(1, atoi(value.c_str()));
+        } else if(arg == "--accessor-threads") {
+            accessor_threads = max(1, atoi(value.c_str()));
+        } else if(arg == "--duration") {
+            duration_s = atof(value.c_str());
+        } else if(arg == "--warmup") {
+            warmup_s = max(0.0, atof(value.c_str()));
+        } else if(arg == "--json") {
+            json_file = value;
+        } else if(arg == "--tags") {
+            std::stringstream ss(value);
+            string spec;
+            while(getline(ss, spec, ',')) {
+                BenchTag tag;
+                if(!parseTagSpec(spec, tag.name, tag.type, tag.count)) {
+                    fprintf(stderr, "Bad tag spec \"%s\"\n", spec.c_str());
+                    return 1;
+                }
+                tag.cip_type = getTagTypeCode(tag.type);
+                tags.push_back(tag);
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n%s", arg.c_str(), BENCH_USAGE);
+            return 1;
+        }
+    }
+
+    if(!filter.empty()) {
+        TagTable entries;
+        vector<UdtEntry> udts;
+        UdtLayouts layouts;
+        const char *list_argv[3] = { "", gateway.c_str(), path.c_str() };
+        string scratch;
+
+        list_tags(3, list_argv, entries, udts);
+        layouts.build(udts);
+
+        for(size_t row = 0; row < entries.size(); row++) {
+            string_view name = entries.fullName(row, scratch);
+            uint16_t cip_type = entries.type(row);
+            const UdtLayout *layout = layouts.find(cip_type);
+            string type = layout ? layout->name : getTagType(cip_type);
+
+            if(name.find(filter) == string::npos || type.empty() || type == ".UNKNOWN.") continue;
+            if((cip_type & TYPE_IS_STRUCT) && !layout && type != "STRING_LGX") continue;
+
+            tags.push_back({ string(name), type, entries.elemCount(row) > 0 ? entries.elemCount(row) : 1, cip_type });
+        }
+    }
+
+    if(tags.empty() || duration_s <= 0) {
+        fprintf(stderr, "Nothing to read, give --tags or --filter and a positive --duration.\n%s", BENCH_USAGE);
+        return 1;
+    }
+
+    /*
+     * one lane is one handle with at most one read outstanding. Every tag gets at least one lane and
+     * enough copies that the window can be filled; at most `concurrency` lanes are busy at once.
+     */
+    BenchQueue queue;
+    bench_queue = &queue;
+
+    size_t copies = ((size_t)max(concurrency, accessor_threads) + tags.size() - 1) / tags.size();
+    vector<BenchLane> lanes;
+    lanes.reserve(copies * tags.size());
+
+    for(size_t c = 0; c < copies; c++) {
+        for(size_t t = 0; t < tags.size(); t++) {
+            string es;
+            string tagstring = buildTagstring(gateway, tags[t].name, tags[t].count, path, cpu, protocol);
+            if(!attrs.empty()) tagstring += "&" + attrs;
+
+            int32_t handle = createTag(es, tagstring, DATA_TIMEOUT, tags[t].cip_type);
+            if(handle < 0) {
+                fprintf(stderr, "%s: %s", tags[t].name.c_str(), es.c_str());
+                continue;
+            }
+
+            lanes.push_back({ handle, t, tags[t].cip_type, nullptr, steady_clock::now(), false, 0, 0 });
+        }
+    }
+
+    if(lanes.empty()) {
+        fprintf(stderr, "No tags could be created.\n");
+        return 1;
+    }
+
+    if(accessor_threads > 0) {
+        vector<int32_t> handles;
+        for(auto &lane : lanes) {
+            int32_t rc = plc_tag_read(lane.handle, DATA_TIMEOUT);
+            if(rc != PLCTAG_STATUS_OK) {
+                fprintf(stderr, "%s: %s\n", tags[lane.tag_index].name.c_str(), plc_tag_decode_error(rc));
+                continue;
+            }
+            handles.push_back(lane.handle);
+        }
+
+        int rc = handles.empty() ? 1 : benchAccessors(handles, accessor_threads, duration_s, json_file);
+        for(auto &lane : lanes) destroyTag(lane.handle);
+        return rc;
+    }
+
+    for(auto &lane : lanes) { plc_tag_register_callback_ex(lane.handle, benchCallback, &lane); }
+
+    /* grouped by the CIP type the tags resolve to; untyped specs are placed by their first good read */
+    map<uint16_t, BenchStats> stats;
+    map<uint16_t, string> type_names;
+    for(auto &lane : lanes) {
+        if(!lane.cip_type) continue;
+        lane.stats = &stats[lane.cip_type];
+        type_names.emplace(lane.cip_type, tags[lane.tag_index].type);
+    }
+
+    /* the type bytes of a Logix read reply: the atomic CIP type, or 0xA0 0x02 and a structure handle */
+    auto resolveType = [&](BenchLane &lane) {
+        uint8_t type_bytes[16];
+        int len = plc_tag_get_byte_array_attribute(lane.handle, "raw_tag_type_bytes", type_bytes, (int)sizeof(type_bytes));
+        uint16_t code = len >= 2 ? (uint16_t)(type_bytes[0] | (type_bytes[1] << 8)) : 0;
+        bool is_struct = code == 0x02A0;
+
+        lane.cip_type = is_struct ? TYPE_IS_STRUCT : code;
+        lane.stats = &stats[lane.cip_type];
+        type_names.emplace(lane.cip_type, is_struct ? "STRUCT" : (code ? getTagType(code, ssprintf("%04X", code)) : "?"));
+    };
+
+    auto start = steady_clock::now();
+    auto measure_from = start + duration_cast<steady_clock::duration>(duration<double>(warmup_s));
+    auto end = measure_from + duration_cast<steady_clock::duration>(duration<double>(duration_s));
+
+    int in_flight = 0;
+    size_t cursor = 0;
+
+    auto record = [&](BenchLane &lane, int32_t status, steady_clock::time_point now) {
+        lane.in_flight = false;
+        in_flight--;
+        if(!lane.stats && status == PLCTAG_STATUS_OK) resolveType(lane);
+        if(lane.started < measure_from) return;
+
+        if(!lane.stats) type_names.emplace(0, "?");
+        BenchStats &s = lane.stats ? *lane.stats : stats[0];
+        if(status == PLCTAG_STATUS_OK) {
+            s.reads++;
+            s.latency_us.push_back(duration_cast<microseconds>(now - lane.started).count());
+            recordLatency(TagOp::READ, lane.cip_type, (uint64_t)duration_cast<nanoseconds>(now - lane.started).count());
+        } else {
+            s.errors++;
+        }
+    };
+
+    auto issue = [&](BenchLane &lane) {
+        lane.started = steady_clock::now();
+        lane.in_flight = true;
+        lane.seq++;
+        in_flight++;
+
+        bench_issuing = true;
+        int32_t rc = plc_tag_read(lane.handle, 0);
+        bench_issuing = false;
+        if(rc != PLCTAG_STATUS_PENDING) {
+            /* finished (or failed) without going async, no callback will follow */
+            record(lane, rc, steady_clock::now());
+        }
+    };
+
+    for(;;) {
+        auto now = steady_clock::now();
+        bool running = now < end;
+
+        for(auto &lane : lanes) {
+            if(lane.in_flight && now - lane.started > milliseconds(DATA_TIMEOUT)) {
+                plc_tag_abort(lane.handle);
+                record(lane, PLCTAG_ERR_TIMEOUT, now);
+            }
+        }
+
+        /* top up the window round robin so every tag gets its turn */
+        for(size_t tried = 0; running && in_flight < concurrency && tried < lanes.size(); tried++) {
+            BenchLane &lane = lanes[cursor];
+            cursor = (cursor + 1) % lanes.size();
+            if(!lane.in_flight) issue(lane);
+        }
+
+        if(!running && in_flight == 0) break;
+
+        std::deque<std::pair<BenchLane *, int32_t>> done;
+        {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.cv.wait_for(lock, milliseconds(50), [&] { return !queue.completed.empty(); });
+            done.swap(queue.completed);
+        }
+
+        now = steady_clock::now();
+        for(auto &d : done) {
+            if(d.first->in_flight) record(*d.first, d.second, now);
+        }
+    }
+
+    for(auto &lane : lanes) {
+        plc_tag_unregister_callback(lane.handle);
+        destroyTag(lane.handle);
+    }
+    bench_queue = nullptr;
+
+    /* report */
+    BenchStats total;
+    for(auto &kv : stats) {
+        sort(kv.second.latency_us.begin(), kv.second.latency_us.end());
+        total.reads += kv.second.reads;
+        total.errors += kv.second.errors;
+        total.latency_us.insert(total.latency_us.end(), kv.second.latency_us.begin(), kv.second.latency_us.end());
+    }
+    sort(total.latency_us.begin(), total.latency_us.end());
+
+    auto row = [&](const string &type, const BenchStats &s) {
+        return ssprintf("%-20s %10lld %8lld %12.1f %9lld %9lld %9lld %9lld\n", type.c_str(), (long long)s.reads, (long long)s.errors,
+                        s.reads / duration_s, (long long)percentile(s.latency_us, 50), (long long)percentile(s.latency_us, 90),
+                        (long long)percentile(s.latency_us, 99), (long long)(s.latency_us.empty() ? 0 : s.latency_us.back()));
+    };
+    auto json = [&](const BenchStats &s) {
+        return ssprintf("{\"reads\": %lld, \"errors\": %lld, \"reads_per_s\": %.1f, \"p50_us\": %lld, \"p90_us\": %lld, \"p99_us\": %lld, \"max_us\": %lld}",
+                        (long long)s.reads, (long long)s.errors, s.reads / duration_s, (long long)percentile(s.latency_us, 50),
+                        (long long)percentile(s.latency_us, 90), (long long)percentile(s.latency_us, 99),
+                        (long long)(s.latency_us.empty() ? 0 : s.latency_us.back()));
+    };
+
+    if(json_file != "-") {
+        printf("%s %s  %zu tags, %zu handles, concurrency %d, %.1fs (+%.1fs warmup)\n", gateway.c_str(), path.c_str(),
+               tags.size(), lanes.size(), concurrency, duration_s, warmup_s);
+        printf("%-20s %10s %8s %12s %9s %9s %9s %9s\n", "TYPE", "READS", "ERRORS", "READS/S", "P50(us)", "P90(us)", "P99(us)", "MAX(us)");
+        for(const auto &kv : stats) fputs(row(type_names[kv.first], kv.second).c_str(), stdout);
+        fputs(row("ALL", total).c_str(), stdout);
+
+        if(histograms) {
+            printf("\n");
+            for(const auto &line : latencyReport()) printf("%s\n", line.c_str());
+        }
+    }
+
+    if(!json_file.empty()) {
+        string out = ssprintf("{\"gateway\": \"%s\", \"path\": \"%s\", \"tags\": %zu, \"handles\": %zu, \"concurrency\": %d, "
+                              "\"duration_s\": %.3f, \"warmup_s\": %.3f, \"types\": {",
+                              gateway.c_str(), path.c_str(), tags.size(), lanes.size(), concurrency, duration_s, warmup_s);
+        bool first = true;
+        for(const auto &kv : stats) {
+            out += ssprintf("%s\"%s\": ", first ? "" : ", ", type_names[kv.first].c_str()) + json(kv.second);
+            first = false;
+        }
+        out += "}, \"total\": " + json(total);
+        if(histograms) out += ", \"histograms\": " + latencyReportJson();
+        out += "}\n";
+
+        FILE *fp = json_file == "-" ? stdout : fopen(json_file.c_str(), "w");
+        if(!fp) {
+            fprintf(stderr, "Unable to write %s\n", json_file.c_str());
+            return 1;
+        }
+        fputs(out.c_str(), fp);
+        if(fp != stdout) fclose(fp);
+    }
+
+    return total.errors > 0 ? 2 : 0;
+}
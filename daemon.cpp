@@ -0,0 +1,129 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+#include "utility.h"
+#include "plctags.h"
+#include "scan_daemon.h"
+
+
+#define DAEMON_USAGE \
+    "Usage: plctagt daemon --config FILE [options]\n" \
+    "  --config FILE       scan list, see below\n" \
+    "  --format F          ndjson (default) or binary, see scan_daemon.h\n" \
+    "  --socket PATH       serve the stream on a Unix socket instead of stdout\n" \
+    "  --max-in-flight N   outstanding reads over all tags (default 256)\n" \
+    "  --timeout MS        create and read timeout (default 5000)\n" \
+    "  --stats S           scan class statistics on stderr every S seconds (default 0, off)\n" \
+    "  --duration S        stop after S seconds (default: run until SIGINT/SIGTERM)\n" \
+    "\n" \
+    "Scan list, one tag per line like data_dumper.conf, # starts a comment:\n" \
+    "  NAME TYPE PERIOD_MS TAG_STRING\n" \
+    "Tags with the same period are read together as one scan class.\n"
+
+
+static std::atomic<bool> daemon_stop{false};
+
+static void daemonSignal(int sig) {
+    (void)sig;
+    daemon_stop = true;
+}
+
+
+int runDaemon(int argc, char **argv) {
+    string config, socket_path, es;
+    ScanFormat format = ScanFormat::NDJSON;
+    int max_in_flight = SCAN_DAEMON_MAX_IN_FLIGHT;
+    int time_out_ms = DATA_TIMEOUT;
+    int stats_every_s = 0;
+    int duration_s = 0;
+
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if(arg == "--help" || arg == "-h") {
+            fputs(DAEMON_USAGE, stdout);
+            return 0;
+        } else if(i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n%s", arg.c_str(), DAEMON_USAGE);
+            return 1;
+        }
+
+        string value = argv[++i];
+        if(arg == "--config") {
+            config = value;
+        } else if(arg == "--format") {
+            if(value == "ndjson") {
+                format = ScanFormat::NDJSON;
+            } else if(value == "binary") {
+                format = ScanFormat::BINARY;
+            } else {
+                fprintf(stderr, "Unknown format %s\n%s", value.c_str(), DAEMON_USAGE);
+                return 1;
+            }
+        } else if(arg == "--socket") {
+            socket_path = value;
+        } else if(arg == "--max-in-flight") {
+            max_in_flight = max(1, atoi(value.c_str()));
+        } else if(arg == "--timeout") {
+            time_out_ms = max(1, atoi(value.c_str()));
+        } else if(arg == "--stats") {
+            stats_every_s = max(0, atoi(value.c_str()));
+        } else if(arg == "--duration") {
+            duration_s = max(0, atoi(value.c_str()));
+        } else {
+            fprintf(stderr, "Unknown option %s\n%s", arg.c_str(), DAEMON_USAGE);
+            return 1;
+        }
+    }
+
+    vector<ScanListEntry> entries;
+    if(config.empty()) {
+        fprintf(stderr, "No --config given.\n%s", DAEMON_USAGE);
+        return 1;
+    }
+    if(!loadScanList(config, entries, es)) {
+        fputs(es.c_str(), stderr);
+        return 1;
+    }
+
+    signal(SIGINT, daemonSignal);
+    signal(SIGTERM, daemonSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    ScanDaemon scanner(max_in_flight, time_out_ms);
+    ScanOutput output;
+
+    int32_t rc = scanner.open(es, entries);
+    if(!es.empty()) fputs(es.c_str(), stderr);
+    if(rc != PLCTAG_STATUS_OK) return 1;
+
+    es.clear();
+    rc = output.open(es, format, socket_path, entries);
+    if(rc != PLCTAG_STATUS_OK) {
+        fputs(es.c_str(), stderr);
+        return 1;
+    }
+
+    if(duration_s > 0) {
+        signal(SIGALRM, daemonSignal);
+        alarm((unsigned)duration_s);
+    }
+
+    rc = scanner.run(es, output, daemon_stop, stats_every_s);
+
+    output.close();
+    scanner.close();
+
+    if(rc != PLCTAG_STATUS_OK) {
+        fputs(es.c_str(), stderr);
+        return 1;
+    }
+
+    return 0;
+}
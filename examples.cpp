@@ -3,6 +3,7 @@
 #include <vector>
 #include <random>
 #include <iostream>
+#include <chrono>
 
 #include "plctags.h"
 
@@ -16,6 +17,11 @@ void exerciseNumeric(std::string gateway, std::string path, std::string cpu, std
 int readTestString(vector<std::string> &values, std::string gateway, std::string path, std::string cpu, std::string protocol, std::string tagname, int count);
 int writeTestString(vector<std::string> &values, std::string gateway, std::string path, std::string cpu, std::string protocol, std::string tagname, int count);
 void exerciseString(std::string gateway, std::string path, std::string cpu, std::string protocol, std::string tagname, int count);
+template <typename T>
+void benchDecode(std::string gateway, std::string path, std::string cpu, std::string protocol, std::string tagname, int count, int iterations);
+template <typename T>
+void benchShardedRead(std::string gateway, std::string path, std::string cpu, std::string protocol, std::string tagname, int count,
+                      int shard_elems, int connections, int iterations);
 
 
 void exercise() {
@@ -27,6 +33,99 @@ void exercise() {
     // //exerciseNumeric<double>("192.168.0.102", "1,0", "contrologix", "ab-eip", "LREAL_ARRAY", 10); // LREAL - not supported by this PLC
 
     exerciseString("192.168.0.102", "1,0", "contrologix", "ab-eip", "TEST1", 10);    // STRING
+
+    // benchDecode<int32_t>("127.0.0.1", "1,0", "controllogix", "ab-eip", "TEST_DINTS", 1000, 1000);  // per-element vs array accessor decode
+    // benchShardedRead<int32_t>("127.0.0.1", "1,0", "controllogix", "ab-eip", "TEST_DINTS", 20000, 1000, 4, 20);  // one handle vs shards
+}
+
+/* times whole-array reads through one handle against a ShardedTag, and checks both return the same values */
+template <typename T>
+void benchShardedRead(std::string gateway, std::string path, std::string cpu, std::string protocol, std::string tagname, int count,
+                      int shard_elems, int connections, int iterations) {
+    using namespace std::chrono;
+    std::string es;
+
+    int32_t tag = createTag(es, buildTagstring(gateway, tagname, count, path, cpu, protocol));
+    if(tag < 0) {
+        std::cout << es << std::endl;
+        return;
+    }
+
+    ShardOptions options;
+    options.shard_elems = shard_elems;
+    options.connections = connections;
+
+    ShardedTag sharded;
+    if(sharded.open(es, gateway, tagname, count, (int)sizeof(T), options, path, cpu, protocol) != PLCTAG_STATUS_OK) {
+        std::cout << es << std::endl;
+        destroyTag(tag);
+        return;
+    }
+
+    vector<T> single, shards;
+    auto time_ms = [&](auto &&fn) {
+        auto start = high_resolution_clock::now();
+        for(int i = 0; i < iterations; i++) {
+            if(fn() != PLCTAG_STATUS_OK) {
+                std::cout << es << std::endl;
+                return -1.0;
+            }
+        }
+        return (double)duration_cast<microseconds>(high_resolution_clock::now() - start).count() / (1000.0 * iterations);
+    };
+
+    double one = time_ms([&] { single.clear(); return readNumericTag(es, tag, single); });
+    double many = time_ms([&] {
+        shards.clear();
+        int32_t rc = sharded.read(es);
+        return rc != PLCTAG_STATUS_OK ? rc : sharded.decode(es, shards);
+    });
+
+    std::cout << tagname << ": " << count << " x " << sizeof(T) << " bytes, " << iterations << " iterations" << std::endl;
+    std::cout << "  one handle  " << one << " ms/read" << std::endl;
+    std::cout << "  " << sharded.shardCount() << " shards/" << connections << " conn " << many << " ms/read ("
+              << (many > 0 ? one / many : 0) << "x)" << (single == shards ? "" : "  MISMATCH") << std::endl;
+
+    destroyTag(tag);
+}
+
+/* times decoding one read snapshot with plc_tag_get_* per element against the library array accessor */
+template <typename T>
+void benchDecode(std::string gateway, std::string path, std::string cpu, std::string protocol, std::string tagname, int count, int iterations) {
+    using namespace std::chrono;
+    std::string es;
+
+    int32_t tag = createTag(es, buildTagstring(gateway, tagname, count, path, cpu, protocol));
+    if(tag < 0) {
+        std::cout << es << std::endl;
+        return;
+    }
+
+    vector<T> values;
+    if(readNumericTag(es, tag, values) < 0) {
+        std::cout << es << std::endl;
+        destroyTag(tag);
+        return;
+    }
+    int elem_size = plc_tag_get_int_attribute(tag, "elem_size", 0);
+
+    auto time_ns = [&](auto &&fn) {
+        auto start = high_resolution_clock::now();
+        for(int i = 0; i < iterations; i++) {
+            values.clear();
+            fn();
+        }
+        return (double)duration_cast<nanoseconds>(high_resolution_clock::now() - start).count() / ((double)iterations * count);
+    };
+
+    double per_element = time_ns([&] { decodeNumericElements(tag, values, elem_size, count); });
+    double array = time_ns([&] { decodeNumericTag(es, tag, values); });
+
+    std::cout << tagname << ": " << count << " x " << sizeof(T) << " bytes, " << iterations << " iterations" << std::endl;
+    std::cout << "  per-element " << per_element << " ns/elem" << std::endl;
+    std::cout << "  array       " << array << " ns/elem (" << (array > 0 ? per_element / array : 0) << "x)" << std::endl;
+
+    destroyTag(tag);
 }
 
 template <typename T>
@@ -13,6 +13,8 @@
 #include <iomanip>
 #include <signal.h>
 #include <chrono>
+#include <filesystem>
+#include <functional>
 //#include <sys/types.h>
 
 using namespace std::chrono;
@@ -21,6 +23,13 @@ using namespace std;
 #include "utility.h"
 #include "plctags.h"
 #include "list_tags.h"
+#include "tag_table.h"
+#include "udt_layout.h"
+#include "tag_codec.h"
+#include "monitor.h"
+#include "tag_search.h"
+#include "plc_worker.h"
+#include "scan_recorder.h"
 
 
 #define STATE_FILENAME ".plctagt.last"
@@ -37,6 +46,11 @@ const int TAG_HISTORY_MAX = 10;
     "Next Page Section 3: PGDN\n" \
     "Clear Current Field: F5\n" \
     "Clear All Section 3 Fields: F6\n" \
+    "Latency Histograms: F3\n" \
+    "Monitor Tag (start/stop): F7\n" \
+    "Open/Close Recording: F8\n" \
+    "Step Recording: LEFT/RIGHT, SHIFT 100, HOME/END\n" \
+    "Search Listed Tags: F9 (words, type:DINT, prog:name)\n" \
     "Additional Options: F1\n" \
     "Quit: ESC\n" \
     ""
@@ -190,10 +204,21 @@ public:
         std::string last_type = sections[1]->fields[0].value; // track Section 2 type
 
         bool running = true;
+        bool repaint = true;
         while(running) {
-            updateUI();
+            if(repaint) updateUI();
+            repaint = true;
 
             int ch = getch();
+            if(ch == ERR) {
+                /* getch only times out while monitoring: repaint just the cells that changed */
+                pollMonitor();
+                repaint = false;
+                continue;
+            }
+
+            if(replay.isOpen() && stepReplay(ch)) continue;
+
             Section* sec = sections[act_sec];
             Field &f = sec->fields[act_field];
 
@@ -203,7 +228,7 @@ public:
             }
 
             switch(ch) {
-            case 27: running=false; break;
+            case 27: stopMonitor(); closeReplay(); running=false; break;
             case KEY_UP:
             case KEY_BTAB: moveFieldUp(); break;
             case KEY_DOWN:
@@ -221,13 +246,24 @@ public:
                 break;
             case KEY_F(2):
             {
-                int r = popupSelect({"LIST TAGS", "TIME PROFILES", }, "");
+                stopMonitor();
+                closeReplay();
+                int r = popupSelect({"LIST TAGS", "TIME PROFILES", "MONITOR LISTED TAGS", "RECORD SCANS", "OPEN RECORDING", }, "");
 
                 int i;
                 switch(r) {
                 case 0:
                     displayTags();
                     break;
+                case 2:
+                    monitorListedTags();
+                    break;
+                case 3:
+                    profileTags("", true);
+                    break;
+                case 4:
+                    openReplay();
+                    break;
                 case 1:
                     r = popupSelect({"TEST ALL", "BIT", "SINT", "INT", "DINT", "LINT", "REAL", "STRING"}, "Stress Tests");
                     switch(r) {
@@ -269,6 +305,9 @@ public:
             }
 
             break;
+            case KEY_F(3):
+                displayLatencies();
+                break;
             case KEY_F(4):
                 if(f.label == "Tagname:") {
                     f.options.clear();
@@ -281,8 +320,31 @@ public:
                 }
                 break;
             case KEY_F(6):
+                stopMonitor();
+                closeReplay();
                 clearSection3Fields();
                 break;
+            case KEY_F(7):
+                closeReplay();
+                if(monitor.active()) {
+                    stopMonitor();
+                } else {
+                    monitorCurrentTag();
+                }
+                break;
+            case KEY_F(8):
+                stopMonitor();
+                if(replay.isOpen()) {
+                    closeReplay();
+                } else {
+                    openReplay();
+                }
+                break;
+            case KEY_F(9):
+                stopMonitor();
+                closeReplay();
+                searchListedTags();
+                break;
 
             case KEY_LEFT: if(f.editable && (f.options.empty() || f.label == "Tagname:") && cursor_pos>0) cursor_pos--; break;
             case KEY_RIGHT: if(f.editable && (f.options.empty() || f.label == "Tagname:") && cursor_pos<(int)f.value.size()) cursor_pos++; break;
@@ -327,6 +389,7 @@ public:
 
         if(current_count != last_count) {
             last_count = current_count;
+            stopMonitor();
             updateSection3FromCount();
         }
     }
@@ -355,6 +418,60 @@ private:
     int rows, cols;
     int last_count = -1;
 
+    // ---------- Section 3 row provider ----------
+    // Long read-only lists (tag listings, monitored tags, recordings) are not copied into
+    // section 3: it keeps one Field per visible line and asks the provider for rows
+    // [scroll, scroll + visible) when it draws them. No provider: the fields are the values.
+    using RowFn = std::function<string(size_t row)>;
+    RowFn row_provider;
+    size_t provider_rows = 0;
+
+    bool providerActive() const { return (bool)row_provider; }
+    int section3Visible() const { return sections[2]->bottom - sections[2]->top - 1; }
+    int section3Total() const { return providerActive() ? (int)provider_rows : (int)sections[2]->fields.size(); }
+
+    void setSection3Provider(size_t count, RowFn fn) {
+        Section* sec3 = sections[2];
+        int page = (int)min<size_t>(count, (size_t)max(0, section3Visible()));
+        int width = getFieldWidth(getType(), cols - 2 - 6);
+
+        row_provider = std::move(fn);
+        provider_rows = count;
+        scroll = 0;
+        setFieldValue("Count:", to_string(count));
+
+        sec3->fields.clear();
+        for(int i = 0; i < page; i++) sec3->fields.push_back({"", "", 2, sec3->top + 1 + i, width, true, {}});
+        sec3->last_active = 0;
+        if(act_sec == 2) {
+            // an empty list has no field to stand on
+            if(page == 0) act_sec = 1;
+            act_field = 0;
+            cursor_pos = 0;
+        }
+    }
+
+    void clearSection3Provider() {
+        row_provider = nullptr;
+        provider_rows = 0;
+    }
+
+    // up/down in a provided list: the page of fields stays, the rows under it move
+    void moveProviderRow(int delta) {
+        int page = (int)sections[2]->fields.size();
+        int total = section3Total();
+        if(page == 0) return;
+
+        int row = scroll + act_field + delta;
+        if(row < 0) row = total - 1;
+        if(row >= total) row = 0;
+
+        if(row < scroll) scroll = row;
+        if(row >= scroll + page) scroll = row - page + 1;
+        act_field = row - scroll;
+        cursor_pos = 0;
+    }
+
     // ---------- Formatting helpers (new) ----------
     const char* getFormatForType(const std::string &type) {
         if(type == "BIT") return "%d";
@@ -546,6 +663,7 @@ private:
 
     // ---------- Section 3 update ----------
     void updateSection3FromVector(const std::vector<std::string>& values, bool forceUpdate = false) {
+        clearSection3Provider();
         Section* sec3 = sections[2];
         Section* sec2 = sections[1]; // Section 2 contains field types
         int count = (int)values.size();
@@ -588,6 +706,7 @@ private:
     }
 
     void clearSection3Fields() {
+        clearSection3Provider();
         Section* sec3 = sections[2];
         for (auto &f : sec3->fields) {
             if (f.editable) f.value.clear();
@@ -606,39 +725,54 @@ private:
 
         for(int r=sec3.top+1;r<sec3.bottom;++r){ mvaddch(r,0,ACS_VLINE); mvaddch(r,cols-1,ACS_VLINE); }
         mvaddch(sec3.bottom,0,ACS_LLCORNER); mvhline(sec3.bottom,1,ACS_HLINE,cols-2); mvaddch(sec3.bottom,cols-1,ACS_LRCORNER);
+        if(monitor.active()) mvprintw(sec3.bottom, 2, " MONITOR %dms - F7 stops ", monitor_period_ms);
+        if(searching) mvprintw(sec3.bottom, 2, " SEARCH: %s_  %s - ENTER takes, ESC leaves ", search_text.c_str(), search_status.c_str());
+        if(replay.isOpen()) mvprintw(sec3.bottom, 2, " REPLAY %s  cycle %llu/%llu  %s - F8 closes ", replay_file.c_str(),
+                                     (unsigned long long)replay_cycle + 1, (unsigned long long)replay.cycleCount(),
+                                     replayTime(replay.timestampNs(replay_cycle)).c_str());
     }
 
     void drawSection3Fields() {
         Section* sec3 = sections[2];
         int vis = sec3->bottom - sec3->top - 1;
-        int total = (int)sec3->fields.size();
-        if(act_sec == 2){
+        int total = section3Total();
+        if(act_sec == 2 && !providerActive()){
             if(act_field < scroll) scroll = act_field;
             if(act_field >= scroll + vis) scroll = act_field - vis + 1;
         }
         for(int i=0;i<vis;++i){
             int idx = i + scroll;
             if(idx >= total) break;
-            Field &f = sec3->fields[idx];
-            if(act_sec == 2 && idx == act_field) attron(A_REVERSE);
+            drawSection3Row(idx);
+        }
+    }
 
-            // Format the field value according to Section 2 Type, except while editing
-            char formatted[256];
-            std::string typeStr = "REAL32";
-            if(!sections[1]->fields.empty()) typeStr = sections[1]->fields[0].value;
-
-            if(act_sec == 2 && idx == act_field) {
-                // Show raw value while editing current field
-                std::snprintf(formatted, sizeof(formatted), "%s", f.value.c_str());
-            } else {
-                // Show formatted representation
-                formatValueForType(typeStr, f.value, formatted, sizeof(formatted));
-                f.value = formatted;
-            }
+    // one section 3 line, idx must be on screen (scroll <= idx < scroll + visible rows)
+    void drawSection3Row(int idx) {
+        Section* sec3 = sections[2];
+        int i = idx - scroll;
+        int fi = providerActive() ? i : idx;    // a provider only has fields for the visible page
+        Field &f = sec3->fields[fi];
+        bool active = act_sec == 2 && fi == act_field;
+        if(providerActive()) f.value = row_provider((size_t)idx);
+        if(active) attron(A_REVERSE);
+
+        // Format the field value according to Section 2 Type, except while editing
+        char formatted[256];
+        std::string typeStr = "REAL32";
+        if(!sections[1]->fields.empty()) typeStr = sections[1]->fields[0].value;
 
-            mvprintw(sec3->top + 1 + i, f.x, "%02d:%-*s", idx+1, f.width, formatted);
-            if(act_sec == 2 && idx == act_field) attroff(A_REVERSE);
+        if(active) {
+            // Show raw value while editing current field
+            std::snprintf(formatted, sizeof(formatted), "%s", f.value.c_str());
+        } else {
+            // Show formatted representation
+            formatValueForType(typeStr, f.value, formatted, sizeof(formatted));
+            f.value = formatted;
         }
+
+        mvprintw(sec3->top + 1 + i, f.x, "%02d:%-*s", idx+1, f.width, formatted);
+        if(active) attroff(A_REVERSE);
     }
 
     void drawSections12Fields() {
@@ -674,8 +808,8 @@ private:
         } else curs_set(0);
     }
 
-    void moveFieldUp() { storeTagOnLeave(); Section *sec = sections[act_sec]; do { act_field = (act_field-1+sec->fields.size())%sec->fields.size(); } while(!sec->fields[act_field].editable && sec->fields[act_field].label.empty()); cursor_pos=sec->fields[act_field].value.size(); }
-    void moveFieldDown() { storeTagOnLeave(); Section *sec = sections[act_sec]; do { act_field=(act_field+1)%sec->fields.size(); } while(!sec->fields[act_field].editable && sec->fields[act_field].label.empty()); cursor_pos=sec->fields[act_field].value.size(); }
+    void moveFieldUp() { if(act_sec == 2 && providerActive()) { moveProviderRow(-1); return; } storeTagOnLeave(); Section *sec = sections[act_sec]; do { act_field = (act_field-1+sec->fields.size())%sec->fields.size(); } while(!sec->fields[act_field].editable && sec->fields[act_field].label.empty()); cursor_pos=sec->fields[act_field].value.size(); }
+    void moveFieldDown() { if(act_sec == 2 && providerActive()) { moveProviderRow(1); return; } storeTagOnLeave(); Section *sec = sections[act_sec]; do { act_field=(act_field+1)%sec->fields.size(); } while(!sec->fields[act_field].editable && sec->fields[act_field].label.empty()); cursor_pos=sec->fields[act_field].value.size(); }
     void moveSectionPrev() { storeTagOnLeave(); sections[act_sec]->last_active=act_field; act_sec=(act_sec-1+(int)sections.size())%sections.size(); act_field=sections[act_sec]->last_active; cursor_pos=sections[act_sec]->fields[act_field].value.size(); }
     void moveSectionNext() { storeTagOnLeave(); sections[act_sec]->last_active=act_field; act_sec=(act_sec+1)%sections.size(); act_field=sections[act_sec]->last_active; cursor_pos=sections[act_sec]->fields[act_field].value.size(); }
 
@@ -687,7 +821,7 @@ private:
 
     void pageUpSection3() {
         Section* sec3 = sections[2];   // always Section 3
-        int total = sec3->fields.size();
+        int total = section3Total();
         int vis = sec3->bottom - sec3->top - 1;
 
         if (total <= vis) return; // no scrolling needed
@@ -703,7 +837,7 @@ private:
 
     void pageDownSection3() {
         Section* sec3 = sections[2];
-        int total = sec3->fields.size();
+        int total = section3Total();
         int vis = sec3->bottom - sec3->top - 1;
 
         if (total <= vis) return; // no scrolling needed
@@ -778,276 +912,33 @@ private:
     //     }
     // }
 
-    TagEntry expandTagentry(TagEntry e, string name, string type, uint16_t count = 1) {
-        return { "",
-                e.name + "." + name,
-                e.parentName,
-                0,
-                getTagTypeCode(type),
-                0, //getTypeByteCount(type),
-                count,
-                0,
-                0 };
-    }
-
     int tobefleshed = 0;
     vector<string> to_flesh;
-    void expand_tags(vector<TagEntry> &tagentries) {
-        vector<TagEntry> to_add;
-        vector<int> to_remove;
-        string type;
-        auto &t = tagentries;
-        for (int i = 0; i < tagentries.size(); i++) {
-            auto& e = tagentries[i];
-            // if (e.name.find("Local:12:I") != std::string::npos) {
-            //     raise(SIGTRAP);
-            // }
-            type = getTagType(e.type);
-            tobefleshed++;
-
-            if(type == "" || type == ".UNKNOWN.") {
-                tobefleshed--;
-                to_remove.push_back(i);
-                to_flesh.push_back(e.name);
-                //if(type == "") { raise(SIGTRAP); }
-                //raise(SIGTRAP);
-
-                ///////////////////////////////////
-                /// haven't yet looked up in PLC
-                ///////////////////////////////////
-                // __DEFVAL_00000A75
-                // SR1_SELECT
-                // SR1_RUNTIME
-                // SR1_LOAD
-                // SR1_COMMANDS
-                // SR1_AUTOSTART
-                // SE_CMDS_FROM_T10
-                // SE_BLDG_STAT
-                // R9S9_STATUS
-                // R9S8_STATUS
-                // R9S7_STATUS
-                // R9S6_STATUS
-                // R9S5_STATUS
-                // R9S4_STATUS
-                // R9S3_STATUS
-                // R9S1_STATUS
-                // R9S12_STATUS
-                // R9S12_CH_FAULT
-                // JAC_BOOL
-                // I_BUTTON
-                // Local:9:O
-                // Local:9:I
-                // Local:8:O
-                // Local:8:I
-                ///////////////////////////////////
-                ///
-            } else if(type == "Timer") {
-                tobefleshed--;
-                to_remove.push_back(i);
-                to_add.push_back(expandTagentry(e, "PRE", "DINT"));
-                to_add.push_back(expandTagentry(e, "ACC", "DINT"));
-                to_add.push_back(expandTagentry(e, "EN",  "BIT"));
-                to_add.push_back(expandTagentry(e, "TT",  "BIT"));
-                to_add.push_back(expandTagentry(e, "DN",  "BIT"));
-            } else if(type == "MESSAGE") {
-                tobefleshed--;
-                to_remove.push_back(i);
-                to_add.push_back(expandTagentry(e, "Flags",              "INT"));
-                to_add.push_back(expandTagentry(e, "EW",                 "BIT"));
-                to_add.push_back(expandTagentry(e, "ER",                 "BIT"));
-                to_add.push_back(expandTagentry(e, "DN",                 "BIT"));
-                to_add.push_back(expandTagentry(e, "ST",                 "BIT"));
-                to_add.push_back(expandTagentry(e, "EN",                 "BIT"));
-                to_add.push_back(expandTagentry(e, "TO",                 "BIT"));
-                to_add.push_back(expandTagentry(e, "EN_CC",              "BIT"));
-                to_add.push_back(expandTagentry(e, "ERR",                "INT"));
-                to_add.push_back(expandTagentry(e, "EXERR",              "DINT"));
-                to_add.push_back(expandTagentry(e, "ERR_SRC",            "SINT"));
-                to_add.push_back(expandTagentry(e, "DN_LEN",             "INT"));
-                to_add.push_back(expandTagentry(e, "REQ_LEN",            "INT"));
-                to_add.push_back(expandTagentry(e, "DestinationLink",    "INT"));
-                to_add.push_back(expandTagentry(e, "DestinationNode",    "INT"));
-                to_add.push_back(expandTagentry(e, "SourceLink",         "INT"));
-                to_add.push_back(expandTagentry(e, "Class",              "INT"));
-                to_add.push_back(expandTagentry(e, "Attribute",          "INT"));
-                to_add.push_back(expandTagentry(e, "Instance",           "DINT"));
-                to_add.push_back(expandTagentry(e, "LocalIndex",         "DINT"));
-                to_add.push_back(expandTagentry(e, "Channel",            "SINT"));
-                to_add.push_back(expandTagentry(e, "Rack",               "SINT"));
-                to_add.push_back(expandTagentry(e, "Group",              "SINT"));
-                to_add.push_back(expandTagentry(e, "Slot",               "SINT"));
-                to_add.push_back(expandTagentry(e, "Path",               "STRING_LGX"));
-                to_add.push_back(expandTagentry(e, "RemoteIndex",        "DINT"));
-                to_add.push_back(expandTagentry(e, "RemoteElement",      "STRING_LGX"));
-                to_add.push_back(expandTagentry(e, "UnconnectedTimeout", "DINT"));
-                to_add.push_back(expandTagentry(e, "ConnectionRate",     "DINT"));
-                to_add.push_back(expandTagentry(e, "TimeoutMultiplier",  "SINT"));
-            } else if(type == "COUNTER") {
-                tobefleshed--;
-                to_remove.push_back(i);
-                to_add.push_back(expandTagentry(e, "PRE", "DINT"));
-                to_add.push_back(expandTagentry(e, "ACC", "DINT"));
-                to_add.push_back(expandTagentry(e, "CU",  "BIT"));
-                to_add.push_back(expandTagentry(e, "CD",  "BIT"));
-                to_add.push_back(expandTagentry(e, "OV",  "BIT"));
-                to_add.push_back(expandTagentry(e, "UN",  "BIT"));
-            } else if(type == "ALARM_DIGITAL") {
-                tobefleshed--;
-                to_remove.push_back(i);
-                to_add.push_back(expandTagentry(e, "EnableIn",  "BIT"));
-                to_add.push_back(expandTagentry(e, "In",  "BIT"));
-                to_add.push_back(expandTagentry(e, "InFault",  "BIT"));
-                to_add.push_back(expandTagentry(e, "Condition",  "BIT"));
-                to_add.push_back(expandTagentry(e, "AckRequired",  "BIT"));
-                to_add.push_back(expandTagentry(e, "Latched",  "BIT"));
-                to_add.push_back(expandTagentry(e, "ProgAck",  "BIT"));
-                to_add.push_back(expandTagentry(e, "OperAck",  "BIT"));
-                to_add.push_back(expandTagentry(e, "ProgReset",  "BIT"));
-                to_add.push_back(expandTagentry(e, "OperReset",  "BIT"));
-                to_add.push_back(expandTagentry(e, "ProgSuppress",  "BIT"));
-                to_add.push_back(expandTagentry(e, "OperSuppress",  "BIT"));
-                to_add.push_back(expandTagentry(e, "ProgUnsuppress",  "BIT"));
-                to_add.push_back(expandTagentry(e, "OperUnsuppress",  "BIT"));
-                to_add.push_back(expandTagentry(e, "OperShelve",  "BIT"));
-                to_add.push_back(expandTagentry(e, "ProgUnshelve",  "BIT"));
-                to_add.push_back(expandTagentry(e, "OperUnshelve",  "BIT"));
-                to_add.push_back(expandTagentry(e, "ProgDisable",  "BIT"));
-                to_add.push_back(expandTagentry(e, "OperDisable",  "BIT"));
-                to_add.push_back(expandTagentry(e, "ProgEnable",  "BIT"));
-                to_add.push_back(expandTagentry(e, "OperEnable",  "BIT"));
-                to_add.push_back(expandTagentry(e, "AlarmCountReset",  "BIT"));
-                to_add.push_back(expandTagentry(e, "UseProgTime",  "BIT"));
-                to_add.push_back(expandTagentry(e, "ProgTime",         "LINT"));
-            } else if(type == "XFR_TYPE") {
-                tobefleshed--;
-                to_remove.push_back(i);
-                for(int i=0; i<e.elem_count; i++) {
-                    TagEntry ec = e;
-                    ec.name = e.name + "[" + to_string(i) + "]";
-                    to_add.push_back(expandTagentry(ec, "CONV_XFR", "SINT"));
-                    to_add.push_back(expandTagentry(ec, "ITLK_XFR", "SINT"));
-                    to_add.push_back(expandTagentry(ec, "ALLOCATED_UNIT", "DINT"));
-                    to_add.push_back(expandTagentry(ec, "COMMAND", "INT"));
-                    to_add.push_back(expandTagentry(ec, "RUNTIME.HOURS", "DINT"));
-                    to_add.push_back(expandTagentry(ec, "RUNTIME.MINUTES", "INT"));
-                    to_add.push_back(expandTagentry(ec, "WT.RATE", "DINT"));
-                    to_add.push_back(expandTagentry(ec, "WT.SCALE", "DINT"));
-                    to_add.push_back(expandTagentry(ec, "WT.TOTAL_TONNAGE", "DINT"));
-                    to_add.push_back(expandTagentry(ec, "FLOP_GATE", "SINT"));
-                    to_add.push_back(expandTagentry(ec, "T10_CONV_STAT", "SINT"));
-                    to_add.push_back(expandTagentry(ec, "MCT.MCT_00", "INT"));
-                    to_add.push_back(expandTagentry(ec, "MCT.MCT_01", "INT"));
-                    to_add.push_back(expandTagentry(ec, "MCT.MCT_02", "INT"));
-                    to_add.push_back(expandTagentry(ec, "MCT.MCT_03", "INT"));
-                    to_add.push_back(expandTagentry(ec, "LIGHTS", "DINT", 2));
-                }
-            } else if(type == "TIME_OF_DAY") {
-                to_remove.push_back(i);
-            } else if(type == "FULL_STRUCT") {
-                to_remove.push_back(i);
-            } else if(type == "RADIO_COMM_TYPE") {
-                to_remove.push_back(i);
-            } else if(type == "CONVEYOR_TYPE") {
-                to_remove.push_back(i);
-            } else if(type == "PM_XFR_STATUS_TYPE") {
-                to_remove.push_back(i);
-            } else if(type == "I_BUTTON") {
-                to_remove.push_back(i);
-            } else if(type == "SCALE_TYPE") {
-                to_remove.push_back(i);
-            } else if(type == "PM_XFR_STATUS_TYPE") {
-                to_remove.push_back(i);
-            } else if(type == "TIMESTAMP2_TYPE") {
-                to_remove.push_back(i);
-
-                // 1756 IO
-            } else if(type == "1756_DI_C") {
-                tobefleshed--;
-                to_remove.push_back(i);
-                to_add.push_back(expandTagentry(e, "DiagCOSDisable", "BIT"));
-                to_add.push_back(expandTagentry(e, "FilterOffOn_0_7", "SINT"));
-                to_add.push_back(expandTagentry(e, "FilterOnOff_0_7", "SINT"));
-                to_add.push_back(expandTagentry(e, "FilterOffOn_8_15", "SINT"));
-                to_add.push_back(expandTagentry(e, "FilterOnOff_8_15", "SINT"));
-                to_add.push_back(expandTagentry(e, "FilterOffOn_16_23", "SINT"));
-                to_add.push_back(expandTagentry(e, "FilterOnOff_16_23", "SINT"));
-                to_add.push_back(expandTagentry(e, "FilterOffOn_24_31", "SINT"));
-                to_add.push_back(expandTagentry(e, "FilterOnOff_24_31", "SINT"));
-                to_add.push_back(expandTagentry(e, "COSOnOffEn", "DINT"));
-                to_add.push_back(expandTagentry(e, "COSOffOnEn", "DINT"));
-            } else if(type == "1756_DI_I") {
-                tobefleshed--;
-                to_remove.push_back(i);
-                to_add.push_back(expandTagentry(e, "Fault", "DINT"));
-                to_add.push_back(expandTagentry(e, "Data", "DINT"));
-            } else if(type == "1756_DO_C") {
-                tobefleshed--;
-                to_remove.push_back(i);
-                to_add.push_back(expandTagentry(e, "ProgToFaultEn", "BIT"));
-                to_add.push_back(expandTagentry(e, "FaultMode", "DINT"));
-                to_add.push_back(expandTagentry(e, "FaultValue", "DINT"));
-                to_add.push_back(expandTagentry(e, "ProgMode", "DINT"));
-                to_add.push_back(expandTagentry(e, "ProgValue", "DINT"));
-            } else if(type == "1756_IF16_C") {
-                tobefleshed--;
-                to_remove.push_back(i);
-                to_add.push_back(expandTagentry(e, "ModuleFilter", "SINT"));
-                to_add.push_back(expandTagentry(e, "RealTimeSample", "INT"));
-                for(int i=0; i<16; i++) {
-                    TagEntry ec = e;
-                    string prefix = "Ch" + to_string(i) + "Config.";
-                    to_add.push_back(expandTagentry(e, prefix + "RangeType", "SINT"));
-                    to_add.push_back(expandTagentry(e, prefix + "DigitalFilter", "INT"));
-                    to_add.push_back(expandTagentry(e, prefix + "LowSignal", "REAL"));
-                    to_add.push_back(expandTagentry(e, prefix + "HighSignal", "REAL"));
-                    to_add.push_back(expandTagentry(e, prefix + "LowEngineering", "REAL"));
-                    to_add.push_back(expandTagentry(e, prefix + "HighEngineering", "REAL"));
-                    to_add.push_back(expandTagentry(e, prefix + "CalBias", "REAL"));
-                }
-            } else if(type == "1756_IF16_I") {
-                to_remove.push_back(i);
-
-                // not strictly data
-            } else if(type == "Routine") {
-                to_remove.push_back(i);
-            } else if(type == "Program") {
-                to_remove.push_back(i);
-            } else if(type == "Task") {
-                to_remove.push_back(i);
-
-                // unlocated
-            } else if(type == "CXN_STANDARD") {
-                to_remove.push_back(i);
-            } else if(type == "MAP_R999") {
-                to_remove.push_back(i);
-            } else {
-                // must be base type
-                if (string("BIT SINT INT DINT LINT REAL STRING_LGX").find(type) == std::string::npos) {
-                    TagEntry x = e;
-                    raise(SIGTRAP);
-                }
-            }
-        }
+    TagTable profile_table;             // what the last profile listed
+    vector<uint32_t> profiled_rows;     // the rows of it that were created, shown in section 3
+    string name_scratch;                // makeTagName joins program tags here
+    UdtLayouts udt_layouts;
+
+    // keeps what profileTags can read: atomic/string tags, and UDT instances whose template
+    // flattened to at least one leaf (read once as a whole, decoded from the layout offsets).
+    // Anything else (system types, Program/Routine/Task, templates we could not get) is dropped
+    // and listed in to_flesh.
+    void expand_tags(TagTable &tags) {
+        tobefleshed = 0;
+        to_flesh.clear();
+
+        tags.keepIf([&](size_t row) {
+            if(tagCodec(tags.type(row)) || udt_layouts.find(tags.type(row))) return true;
 
-        sort(to_remove.rbegin(), to_remove.rend());
-        for (int i : to_remove) {
-            tagentries[i] = tagentries.back();
-            tagentries.pop_back();
-        }
-        int i = 0;
-        for (auto &e : to_add) {
-            tagentries.push_back(e);
-            i++;
-        }
+            tobefleshed++;
+            to_flesh.push_back(string(tags.name(row)));
+            return false;
+        });
     }
 
-    string makeTagName(TagEntry te) {
-        string tagname = "";
-
-        if(te.parentName.size() > 0) tagname = te.parentName + ".";
-        tagname += te.name;
-
-        return tagname;
+    // valid until the next call
+    string_view makeTagName(const TagTable &tags, size_t row) {
+        return tags.fullName(row, name_scratch);
     }
 
     void showProgress(int i) {
@@ -1063,6 +954,19 @@ private:
         mvprintw(mid_y, mid_x, "          %d          ", i);
         refresh();
     }
+    void showProgress(int i, double rate) {
+        curs_set(0); // HIDE CURSOR
+
+        Section* sec3 = sections[2];
+
+        // Compute middle row of Section 3
+        int mid_y = sec3->top + (sec3->bottom - sec3->top) / 2;
+        int mid_x = cols / 2 - 20;  // center approx
+
+        // Draw progress text
+        mvprintw(mid_y, mid_x, "          %d  (%.0f reads/s)          ", i, rate);
+        refresh();
+    }
     void showProgressS(string &&s) {
         curs_set(0); // HIDE CURSOR
 
@@ -1077,159 +981,292 @@ private:
         refresh();
     }
 
-    void profileTags(string types = "") {
+    // ---------- PLC worker ----------
+    PlcWorker worker;
+
+    // the progress line of showProgressS, cleared first since the text keeps changing
+    void showWorkerProgress(const string &text) {
+        curs_set(0); // HIDE CURSOR
+
+        Section* sec3 = sections[2];
+        int mid_y = sec3->top + (sec3->bottom - sec3->top) / 2 - 1;
+        int mid_x = max(1, cols / 2 - (int)text.size() / 2);
+
+        mvhline(mid_y, 1, ' ', cols - 2);
+        mvprintw(mid_y, mid_x, "%.*s", max(0, cols - 1 - mid_x), text.c_str());
+        refresh();
+    }
+
+    // runs fn on the worker thread while the screen keeps showing its progress.
+    // ESC, or any key with any_key, cancels it; the result comes back either way.
+    PlcJobResult runOnWorker(const string &title, PlcWorker::JobFn fn, bool any_key = false) {
+        PlcJobResult result;
+        string text = title;
+        bool cancelling = false;
+
+        worker.submit(title, std::move(fn));
+        timeout(PLC_WORKER_UI_POLL_MS);
+        while(!worker.poll(result)) {
+            worker.progress(text);
+            showWorkerProgress(text + (cancelling ? "  - cancelling" : any_key ? "  - any key stops" : "  - ESC cancels"));
+
+            int ch = getch();
+            if(!cancelling && ch != ERR && ch != KEY_RESIZE && (ch == 27 || any_key)) {
+                worker.cancel();
+                cancelling = true;
+            }
+        }
+        timeout(-1);
+
+        return result;
+    }
+
+    // record == true: only tags a recording can hold, scanned over and over into a new
+    // .rec file until a key is pressed, instead of read and decoded once.
+    // The listing, creates, reads and destroys all run on the worker.
+    void profileTags(string types = "", bool record = false) {
         string gateway = getGateway();
         string path = getPath();
         string cpu = getCpu();
         string protocol = getProtocol();
-        vector<string> tags_created, tags_read, fail_create, fail_read;
-        int rc;
-
-        vector<TagEntry> tagentries;
-        const char* argv[3] = { (char*)"", gateway.c_str(), path.c_str() };
-        list_tags(3, argv, tagentries);
-        expand_tags(tagentries);
+        string what = types.size() ? " " + types : "";
+        vector<string> fail_create, fail_read;
 
-        // CREATE TAGS
-        vector<TagEntry> teRead;
-        vector<int> tags;
+        /* a type filter without a codec would match nothing, say so instead of profiling every tag */
+        const TagCodec *only = types.size() > 0 ? tagCodec(getTagTypeCode(types)) : nullptr;
+        if(types.size() > 0 && !only) {
+            popupMessage(ssprintf("ERROR: no codec for the tag type %s, nothing to profile.\n", types.c_str()));
+            return;
+        }
 
-        //showProgressS(ssprintf("pre-creating the tags: %s", types.c_str()));
-        showProgressS(ssprintf("pre-creating the%s tags", types.size() ? (" " + types).c_str() : "" ));
+        TagTable &tags = profile_table;
+        vector<uint32_t> rows;          // rows[i] of the table is read through handles[i]
+        vector<int32_t> handles;
+        vector<uint16_t> cip_types;
+        vector<int> elem_counts;
+        int comm_count = 0;
+        int leaf_count = 0;
+        int64_t duration_us = 0, destroy_us = 0;
+        CreateStats create_stats;
+        uint64_t cycles = 0, bytes = 0;
+
+        string record_file;
+        if(record) {
+            char stamp[32];
+            time_t now = time(nullptr);
+            strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+            record_file = ssprintf("plctagt-%s" REC_FILE_SUFFIX, stamp);
+        }
 
 #define PROGRESS_GROUP 100
-        //#define INVALID_TAG 32768
-        int progress = 0;
-        for (auto& e : tagentries) {
-            string es, type = getTagType(e.type);
-            //            e.instance_id = INVALID_TAG; // repurposing field as tag, initialize as invalid tag number
-            if(types.size() > 0 && types.find(type))  {
-                continue;
-            } else {
-                int i = 0;
+        PlcJobResult result = runOnWorker(ssprintf("listing the tags of %s", gateway.c_str()), [&](PlcJob &job) -> int32_t {
+            vector<UdtEntry> udtentries;
+            const char* argv[3] = { (char*)"", gateway.c_str(), path.c_str() };
+            tags.clear();
+            list_tags(3, argv, tags, udtentries);
+            udt_layouts.build(udtentries);
+            expand_tags(tags);
+
+            // CREATE TAGS, CREATE_WINDOW at a time
+            vector<uint32_t> candidates;
+            vector<string> tagstrings;
+            vector<uint16_t> candidate_types;
+            vector<int> candidate_counts;
+            string scratch;
+            for (uint32_t row = 0; row < (uint32_t)tags.size(); row++) {
+                uint16_t type = tags.type(row);
+                if(only && tagCodec(type) != only)  {
+                    continue;
+                }
+                if(record && !tagCodec(type)) {
+                    continue;
+                }
+
+                // arrays are read whole, UDT arrays are decoded element by element below
+                string name(tags.fullName(row, scratch));
+                int count = max(1, (int)tags.elemCount(row));
+                candidates.push_back(row);
+                tagstrings.push_back(buildTagstring(gateway, name, count, path, cpu, protocol));
+                candidate_types.push_back(type);
+                candidate_counts.push_back(count);
             }
 
-            // if (e.name.find("SE_BUILDING_STATUS[0].LIGHTS") != std::string::npos) {
-            //     //raise(SIGTRAP);
-            //     int i = 0;
-            // }
-            if(++progress % PROGRESS_GROUP == 0) showProgress(progress);
-
-            e.name = makeTagName(e); // repurposing field as prefixed tagname
-            //////////////////////////////////////////////////////
-            if(true) e.elem_count = 1;  //////////////////////////
-            //////////////////////////////////////////////////////
-            string tagstring = buildTagstring(gateway, e.name, e.elem_count, path, cpu, protocol);
-            int tag = createTag(es, tagstring);
-            if(tag < 0) {
-                es = ssprintf("Error creating tag %s (%X-%s): %s!\n", e.name.c_str(), e.type, type.c_str(), plc_tag_decode_error(tag));
-                fail_create.push_back(es);
-                continue;
+            AsyncTagCreator creator;
+            vector<int32_t> created;
+            string create_es;
+            creator.setCancel(&job.cancelFlag());
+            job.progress(ssprintf("pre-creating the%s tags", what.c_str()));
+            creator.create(create_es, tagstrings, candidate_types, created,
+                [&](size_t done, double rate) {
+                    if(done % PROGRESS_GROUP == 0) {
+                        job.progress(ssprintf("pre-creating the%s tags  %zu of %zu  (%.0f creates/s)", what.c_str(), done, tagstrings.size(), rate));
+                    }
+                });
+            create_stats = creator.stats();
+
+            for (size_t i = 0; i < created.size(); i++) {
+                uint16_t type = candidate_types[i];
+                if(created[i] < 0) {
+                    if(created[i] != PLCTAG_ERR_ABORT) {
+                        string name(tags.fullName(candidates[i], scratch));
+                        fail_create.push_back(ssprintf("Error creating tag %s (%X-%s): %s!\n", name.c_str(), type, getTagType(type).c_str(),
+                                                       plc_tag_decode_error(created[i])));
+                    }
+                    continue;
+                }
+                rows.push_back(candidates[i]);
+                handles.push_back(created[i]);
+                cip_types.push_back(type);
+                elem_counts.push_back(candidate_counts[i]);
             }
-            else {
-                //tags_created.push_back(ssprintf("%0.4x  %s", e.type, e.name.c_str()));
-                tags_created.push_back(formatTagDisplay(e, 10));
+
+            ScanRecorder recorder;
+            if(record && !job.cancelled()) {
+                vector<RecordedTag> recorded;
+                for(size_t i = 0; i < rows.size(); i++) {
+                    recorded.push_back({ string(tags.fullName(rows[i], scratch)), cip_types[i], recordedWidth(cip_types[i], elem_counts[i]) });
+                }
+
+                int32_t rc = recorder.open(job.error_string, record_file, recorded);
+                if(rc != PLCTAG_STATUS_OK) {
+                    destroyTags(handles);
+                    return rc;
+                }
             }
-            e.instance_id = tag;     // repurposing field as tag number
-            teRead.push_back(e);
-        }
+
+            // reads are issued SCAN_WINDOW at a time; completions are decoded here on the worker
+            AsyncTagScanner scanner;
+            string scan_es;
+            scanner.setCancel(&job.cancelFlag());
+            job.progress(record ? ssprintf("recording to %s", record_file.c_str()) : ssprintf("reading the%s tags", what.c_str()));
+
+            auto start_us = high_resolution_clock::now();
+            while(!job.cancelled()) {
+                if(record) {
+                    int32_t rc = recorder.beginCycle(job.error_string, duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count());
+                    if(rc != PLCTAG_STATUS_OK) break;
+                }
+
+                scanner.scan(scan_es, handles,
+                    [&](size_t index, int32_t rc) {
+                        string es, scratch;
+                        int tag = handles[index];
+                        uint16_t type = cip_types[index];
+                        comm_count++;
+                        if(record) {
+                            recorder.record(index, tag, rc);
+                        } else if(rc == PLCTAG_STATUS_OK) {
+                            const UdtLayout *layout = udt_layouts.find(type);
+                            const TagCodec *codec = tagCodec(type);
+                            if(layout) {
+                                vector<string> values;
+                                for(int e = 0; e < elem_counts[index] && rc == PLCTAG_STATUS_OK; e++) {
+                                    rc = decodeUdtLeaves(es, tag, *layout, e * (int)layout->instance_size, values);
+                                }
+                                leaf_count += (int)values.size();
+                            } else if(codec) {
+                                rc = codec->decode(es, tag, nullptr);
+                            } else {
+                                /* expand_tags only keeps types we can decode */
+                                rc = PLCTAG_ERR_UNSUPPORTED;
+                            }
+                        }
+
+                        if(rc != PLCTAG_STATUS_OK && rc != PLCTAG_ERR_ABORT && !record) {
+                            es = ssprintf("Error reading %s (%X-%s): %s!\n", string(tags.fullName(rows[index], scratch)).c_str(), type,
+                                          getTagType(type).c_str(), plc_tag_decode_error(rc));
+                            fail_read.push_back(es);
+                        }
+                    },
+                    [&](size_t done, double rate) {
+                        if(!record && done % PROGRESS_GROUP == 0) {
+                            job.progress(ssprintf("reading the%s tags  %zu  (%.0f reads/s)", what.c_str(), done, rate));
+                        }
+                    },
+                    cip_types);
+
+                if(!record) break;
+
+                recorder.endCycle();
+                if(recorder.cycles() % 10 == 0) {
+                    job.progress(ssprintf("recording to %s  %llu cycles  (%.0f reads/s)", record_file.c_str(),
+                                          (unsigned long long)recorder.cycles(), scanner.stats().readRate()));
+                }
+            }
+            duration_us = duration_cast<microseconds>(high_resolution_clock::now() - start_us).count();
+
+            if(record) {
+                cycles = recorder.cycles();
+                bytes = recorder.bytesUsed();
+                recorder.close();
+            }
+
+            job.progress(ssprintf("destroying the%s tags", what.c_str()));
+            auto destroy_start = high_resolution_clock::now();
+            destroyTags(handles);
+            destroy_us = duration_cast<microseconds>(high_resolution_clock::now() - destroy_start).count();
+
+            // stopping is how a recording ends, anything else cancelled is cut short
+            if(!job.error_string.empty()) return PLCTAG_ERR_BAD_STATUS;
+            return job.cancelled() && !record ? PLCTAG_ERR_ABORT : PLCTAG_STATUS_OK;
+        }, record);
+
         //***************************
         sections[1]->fields[0].value = "STRING";
         updateSection3Widths();
         //***************************
-        updateSection3FromVector(tags_created, true);
-        //updateUI();
+        profiled_rows = rows;
+        setSection3Provider(profiled_rows.size(), [this](size_t i) { return formatTagDisplay(profile_table, profiled_rows[i], 10); });
+        updateUI();
 
-        int comm_count = 0;
-        progress = 0;
-        showProgressS(ssprintf("reading the%s tags", types.size() ? (" " + types).c_str() : "" ));
-
-        auto start_us = high_resolution_clock::now();
-        for (auto& e : teRead) {
-            if(++progress % PROGRESS_GROUP == 0) showProgress(progress);
-            // if (e.name.find("C24_MCT") != std::string::npos) {
-            //     //raise(SIGTRAP);
-            //     int i = 0;
-            // }
-            string es, type;
-            int tag = e.instance_id;
-            type = getTagType(e.type);
-            //if(!type.size()) raise(SIGTRAP);
-            //if(tag >= 0 && tag < INVALID_TAG && type.size() > 0) {
-            comm_count++;
-            rc = PLCTAG_STATUS_OK;
-            if(type == "BIT") {
-                vector<bool> values;
-                rc = readNumericTag(es, tag, values);
-            } else if(type == "SINT") {
-                vector<int8_t> values;
-                rc = readNumericTag(es, tag, values);
-            } else if(type == "INT") {
-                vector<int16_t> values;
-                rc = readNumericTag(es, tag, values);
-            } else if(type == "DINT") {
-                vector<int32_t> values;
-                rc = readNumericTag(es, tag, values);
-            } else if(type == "LINT") {
-                vector<int64_t> values;
-                rc = readNumericTag(es, tag, values);
-            } else if(type == "REAL") {
-                vector<float_t> values;
-                rc = readNumericTag(es, tag, values);
-            } else if(type == "STRING_LGX") {
-                vector<string> values;
-                rc = readStringTag(es, tag, values);
-            } else if(type == "BYTE") {
-                comm_count--;
-                raise(SIGTRAP);
-            } else if(type == "DWORD") {
-                comm_count--;
-                raise(SIGTRAP);
-            } else {
-                comm_count--;
-                raise(SIGTRAP);
-            }
+        auto duration_s  = static_cast<double>(duration_us) / 1000000.0;
+        auto read_rate = duration_s > 0 ? std::round((comm_count/duration_s) * 100) / 100 : 0.0;
 
-            if(rc != PLCTAG_STATUS_OK) {
-                es = ssprintf("Error reading %s (%X-%s): %s!\n", e.name.c_str(), e.type, type.c_str(), plc_tag_decode_error(tag));
-                fail_read.push_back(es);
-            } else {
-                //tags_read.push_back(e.name);
-            }
+        if(result.status != PLCTAG_STATUS_OK && result.status != PLCTAG_ERR_ABORT) {
+            popupMessage(result.error_string);
+            return;
         }
-        auto end_us = high_resolution_clock::now();
-        auto duration_us = duration_cast<microseconds>(end_us - start_us).count();
-        auto duration_s  = static_cast<double>(duration_us) / 1000000.0;
-        auto read_rate = std::round((comm_count/duration_s) * 100) / 100;
 
-        progress = 0;
-        showProgressS(ssprintf("destroying the%s tags", types.size() ? (" " + types).c_str() : "" ));
-        for (auto& e : teRead) {
-            if(++progress % PROGRESS_GROUP == 0) showProgress(progress);
-            plc_tag_destroy(e.instance_id);
+        if(record) {
+            popupMessage(ssprintf("%s\n%llu scan cycles of %zu tags, %.2f reads/s\n%.1f MB in %.2fs",
+                                  record_file.c_str(), (unsigned long long)cycles, handles.size(), read_rate,
+                                  bytes / 1e6, duration_s));
+            return;
         }
 
-        popupMessage(ssprintf("%s\n%.2f reads/s: %d reads in %dus / %.2fs  [%d]",
-                              types.size() ? types.c_str() : "ALL TAGS", read_rate, comm_count, duration_us, duration_s, tobefleshed));
+        auto destroy_s = static_cast<double>(destroy_us) / 1000000.0;
+        auto destroy_rate = destroy_s > 0 ? handles.size() / destroy_s : 0.0;
+
+        popupMessage(ssprintf("%s%s\n"
+                              "create  %.2f tags/s: %d tags in %.2fs, %d failed\n"
+                              "read    %.2f reads/s: %d reads in %dus / %.2fs  [%d]\n"
+                              "destroy %.2f tags/s: %zu tags in %.3fs\n"
+                              "%d UDT fields decoded",
+                              types.size() ? types.c_str() : "ALL TAGS", result.status == PLCTAG_ERR_ABORT ? " (cancelled)" : "",
+                              create_stats.createRate(), create_stats.creates, create_stats.duration_us / 1000000.0, create_stats.errors,
+                              read_rate, comm_count, (int)duration_us, duration_s, tobefleshed,
+                              destroy_rate, handles.size(), destroy_s,
+                              leaf_count));
 
         //int z = to_flesh.size();
     }
 
-    string formatTagDisplay(TagEntry e, int sTypeWidth = 18) {
+    string formatTagDisplay(const TagTable &tags, size_t row, int sTypeWidth = 18) {
         std::stringstream ss;
-        ss << std::hex << std::setfill('0') << std::setw(4) << e.type << std::setfill(' ') << "-";
+        uint16_t type = tags.type(row);
+        ss << std::hex << std::setfill('0') << std::setw(4) << type << std::setfill(' ') << "-";
 
-        ss << std::left << std::setw(sTypeWidth) << getTagType(e.type, "UNKN");
+        const TagCodec *codec = tagCodec(type);
+        ss << std::left << std::setw(sTypeWidth) << (codec ? string(codec->name) : getTagType(type, "UNKN"));
 
         ss << ":  ";
 
-        if (!e.parentName.empty())
-            ss << e.parentName << ".";
-        ss << e.name;
+        if (!tags.parent(row).empty())
+            ss << tags.parent(row) << ".";
+        ss << tags.name(row);
 
-        if (e.num_dimensions > 0) ss << "[" << e.dimensions[0] << "]";
-        if (e.num_dimensions > 1) ss << "[" << e.dimensions[1] << "]";
-        if (e.num_dimensions > 2) ss << "[" << e.dimensions[2] << "]";
+        ss << std::dec;
+        for (int d = 0; d < tags.numDimensions(row) && d < 3; d++) ss << "[" << tags.dimension(row, d) << "]";
 
         return ss.str();
     }
@@ -1238,141 +1275,348 @@ private:
         sections[1]->fields[0].value = "STRING";
         updateSection3Widths();
 
-        vector<string> seq;
         string gateway = getGateway();
         string path = getPath();
 
-        vector<TagEntry> tagentries;
+        TagTable tags;
+        vector<UdtEntry> udtentries;
         const char* argv[3] = { (char*)"", gateway.c_str(), path.c_str()};
-        list_tags(3, argv, tagentries);
+        PlcJobResult result = runOnWorker(ssprintf("listing the tags of %s", gateway.c_str()), [&](PlcJob &job) -> int32_t {
+            list_tags(3, argv, tags, udtentries);
+            // the listing cannot be interrupted, a cancel only drops what it found
+            return job.cancelled() ? PLCTAG_ERR_ABORT : PLCTAG_STATUS_OK;
+        });
+        if(result.status != PLCTAG_STATUS_OK) {
+            updateUI();
+            return;
+        }
+        listed_tags = std::move(tags);
+        tag_index.update(listed_tags);
+
+        // only the visible page is ever formatted
+        setSection3Provider(listed_tags.size(), [this](size_t i) { return formatTagDisplay(listed_tags, i); });
+    }
+
+    // ---------- Tag search ----------
+    TagSearchIndex tag_index;       // over listed_tags, updated by every LIST TAGS
+    vector<uint32_t> search_hits;   // listed_tags indexes matching search_text
+    string search_text, search_status;
+    bool searching = false;
 
-        for (const auto& e : tagentries) {
-            seq.push_back(formatTagDisplay(e));
+    // filter the listed tags as the user types; ENTER takes the selected tag, ESC shows all of them again
+    void searchListedTags() {
+        if(listed_tags.empty()) {
+            popupMessage("LIST TAGS first, the search looks through the listed tags");
+            return;
+        }
+
+        sections[1]->fields[0].value = "STRING";
+        updateSection3Widths();
+        searching = true;
+        runSearch();
+
+        while(searching) {
+            updateUI();
+
+            int ch = getch();
+            switch(ch) {
+            case 27:
+                searching = false;
+                setSection3Provider(listed_tags.size(), [this](size_t i) { return formatTagDisplay(listed_tags, i); });
+                break;
+            case 10:
+                searching = false;
+                if(act_sec == 2 && !search_hits.empty()) {
+                    sections[1]->fields[1].value = string(makeTagName(listed_tags, search_hits[scroll + act_field]));
+                    act_sec = 1;
+                    act_field = 1;
+                    cursor_pos = sections[1]->fields[1].value.size();
+                }
+                break;
+            case KEY_UP: if(act_sec == 2) moveProviderRow(-1); break;
+            case KEY_DOWN: if(act_sec == 2) moveProviderRow(1); break;
+            case KEY_PPAGE: pageUpSection3(); break;
+            case KEY_NPAGE: pageDownSection3(); break;
+            case KEY_BACKSPACE:
+            case 127:
+                if(!search_text.empty()) {
+                    search_text.pop_back();
+                    runSearch();
+                }
+                break;
+            default:
+                if(ch >= 32 && ch <= 126) {
+                    search_text += (char)ch;
+                    runSearch();
+                }
+                break;
+            }
         }
-        // sections[1]->fields[2].value = std::to_string(seq.size());
-        // setFieldValue("Count:", to_string(seq.size()));
-        updateSection3FromVector(seq);
     }
 
-    template <typename T>
-    int32_t readTagAndUpdateSection3(int32_t tag) {
-        int32_t rc;
+    void runSearch() {
+        TagSearchQuery query;
         string es;
-        vector<T> values;
 
-        if constexpr (std::is_same_v<T, string>) {
-            rc = readStringTag(es, tag, values);
-        } else {
-            rc = readNumericTag(es, tag, values);
+        // a half typed filter (type:DI) keeps the last hits
+        if(query.parse(es, search_text) != PLCTAG_STATUS_OK) {
+            search_status = es;
+            return;
+        }
+
+        auto start = steady_clock::now();
+        tag_index.search(query, search_hits);
+        double ms = duration_cast<microseconds>(steady_clock::now() - start).count() / 1000.0;
+        search_status = ssprintf("%zu of %zu in %.2fms", search_hits.size(), listed_tags.size(), ms);
+
+        act_sec = 2;
+        setSection3Provider(search_hits.size(), [this](size_t i) { return formatTagDisplay(listed_tags, search_hits[i]); });
+    }
+
+    // ---------- Live monitor ----------
+    TagMonitor monitor;
+    int monitor_period_ms = MONITOR_PERIOD_MS;
+    TagTable listed_tags;           // what the last LIST TAGS showed
+
+    void monitorCurrentTag() {
+        const TagCodec *codec = tagCodecForUiType(getType());
+        if(!codec) {
+            popupMessage(ssprintf("no codec for type %s", getType().c_str()));
+            return;
         }
 
-        if(rc < 0) {
+        string tagstring = buildTagstring(getGateway(), getTagname(), max(1, getCount()), getPath(), getCpu(), getProtocol());
+        startMonitor({ { "", tagstring, codec } }, getType());
+    }
+
+    void monitorListedTags() {
+        if(listed_tags.empty()) {
+            popupMessage("LIST TAGS first, the monitor watches the listed tags");
+            return;
+        }
+
+        vector<MonitorItem> items;
+        for(size_t row = 0; row < listed_tags.size(); row++) {
+            const TagCodec *codec = tagCodec(listed_tags.type(row));
+            if(!codec) continue;    // UDTs and system types have no single value to show
+
+            string name(makeTagName(listed_tags, row));
+            items.push_back({ name, buildTagstring(getGateway(), name, 1, getPath(), getCpu(), getProtocol()), codec });
+        }
+
+        startMonitor(items, "STRING");
+    }
+
+    void startMonitor(const vector<MonitorItem> &items, const string &display_type) {
+        static const vector<int> periods = { 50, 100, 250, 500, 1000 };
+        int r = popupSelect({ "50 ms", "100 ms", "250 ms", "500 ms", "1000 ms" }, "Monitor Period");
+        if(r < 0) return;
+        monitor_period_ms = periods[r];
+
+        stopMonitor();
+        showProgressS(ssprintf("creating %zu monitored tags", items.size()));
+
+        string es;
+        int32_t rc = monitor.start(es, items, monitor_period_ms, [&](size_t created) {
+            if(created % PROGRESS_GROUP == 0) showProgress((int)created);
+        });
+        if(rc != PLCTAG_STATUS_OK) {
             popupMessage(es);
-            return rc;
+            return;
         }
 
-        vector<string> seq;
-        for(int i=0; i<values.size(); ++i) {
-            if constexpr (std::is_same_v<T, string>) {
-                seq.push_back(values[i]);
-            } else {
-                seq.push_back(to_string(values[i]));
-            }
+        sections[1]->fields[0].value = display_type;
+        updateSection3Widths();
+        setSection3Provider(monitor.rowCount(), [this](size_t i) { return i < monitor.rowCount() ? monitor.row(i) : string(); });
+        updateUI();
+
+        timeout(MONITOR_UI_POLL_MS);
+    }
+
+    void stopMonitor() {
+        if(!monitor.active()) return;
+
+        monitor.stop();
+        timeout(-1);
+    }
+
+    void pollMonitor() {
+        if(!monitor.active()) return;
+
+        static vector<size_t> changed;
+        changed.clear();
+        if(monitor.poll(changed) == 0) return;
+
+        // rows off screen are fetched from the monitor when they scroll into view
+        int vis = min(section3Visible(), section3Total() - scroll);
+        for(size_t row : changed) {
+            if((int)row >= scroll && (int)row < scroll + vis) drawSection3Row((int)row);
         }
-        updateSection3FromVector(seq);
 
-        return rc;
+        setCursor();
+        refresh();
+    }
+
+    // ---------- Recording replay ----------
+    ScanRecording replay;
+    string replay_file;
+    uint64_t replay_cycle = 0;
+
+    static string replayTime(int64_t ns) {
+        time_t secs = (time_t)(ns / 1000000000);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&secs));
+        return ssprintf("%s.%03d", stamp, (int)(ns / 1000000 % 1000));
     }
 
-    template <typename T>
-    int32_t writeTagFromSection3(int32_t tag) {
-        int32_t rc;
+    void openReplay() {
+        vector<string> files;
+        std::error_code ec;
+        for(const auto &entry : std::filesystem::directory_iterator(".", ec)) {
+            if(entry.path().extension() == REC_FILE_SUFFIX) files.push_back(entry.path().filename().string());
+        }
+        if(files.empty()) {
+            popupMessage("no " REC_FILE_SUFFIX " recordings here, F2 RECORD SCANS makes one");
+            return;
+        }
+        sort(files.rbegin(), files.rend());    // newest first, the names carry the start time
+
+        int r = popupSelect(files, "Open Recording");
+        if(r < 0) return;
+
         string es;
+        if(replay.open(es, files[r]) != PLCTAG_STATUS_OK) {
+            popupMessage(es);
+            return;
+        }
+        if(replay.cycleCount() == 0) {
+            replay.close();
+            popupMessage(ssprintf("%s holds no scan cycles", files[r].c_str()));
+            return;
+        }
 
-        if constexpr (std::is_same_v<T, string>) {
-            vector<T> values = getSection3Values();
-            rc = writeStringTag(es, tag, values);
+        replay_file = files[r];
+        sections[1]->fields[0].value = "STRING";
+        updateSection3Widths();
+        showReplayCycle(0);
+        setSection3Provider(replay.tagCount(), [this](size_t i) { return replayRow(i); });
+    }
+
+    void closeReplay() {
+        if(!replay.isOpen()) return;
+        replay.close();
+    }
+
+    // one recorded tag at the current cycle, section 3 asks only for the visible ones
+    string replayRow(size_t i) {
+        static vector<string> values;
+        if(!replay.isOpen() || i >= replay.tagCount()) return "";
+
+        const RecordedTag &t = replay.tag(i);
+        if(!replay.ok(replay_cycle, i)) return t.name + ": no data";
+
+        values.clear();
+        replay.format(replay_cycle, i, values);
+        string text = t.name + " =";
+        for(const auto &v : values) text += " " + v;
+        return text;
+    }
+
+    // the scroll position is kept while stepping
+    void showReplayCycle(uint64_t cycle) {
+        replay_cycle = min(cycle, replay.cycleCount() - 1);
+    }
+
+    // LEFT/RIGHT step one cycle, SHIFT LEFT/RIGHT a hundred, HOME/END jump to the ends; false for other keys
+    bool stepReplay(int ch) {
+        uint64_t last = replay.cycleCount() - 1;
+
+        switch(ch) {
+        case KEY_LEFT: showReplayCycle(replay_cycle > 0 ? replay_cycle - 1 : 0); return true;
+        case KEY_RIGHT: showReplayCycle(replay_cycle + 1); return true;
+        case KEY_SLEFT: showReplayCycle(replay_cycle > 100 ? replay_cycle - 100 : 0); return true;
+        case KEY_SRIGHT: showReplayCycle(replay_cycle + 100); return true;
+        case KEY_HOME: showReplayCycle(0); return true;
+        case KEY_END: showReplayCycle(last); return true;
+        default: return false;
+        }
+    }
+
+    void displayLatencies() {
+        int r = popupSelect({"SHOW", "RESET"}, "Latency Histograms");
+
+        if(r == 0) {
+            sections[1]->fields[0].value = "STRING";
+            updateSection3Widths();
+            vector<string> lines = latencyReport();
+            TagHandleCache &cache = tagHandleCache();
+            lines.push_back("");
+            lines.push_back(ssprintf("tag handle cache: %zu open, %llu hits, %llu misses", cache.size(),
+                                     (unsigned long long)cache.hits(), (unsigned long long)cache.misses()));
+            updateSection3FromVector(lines, true);
+        } else if(r == 1) {
+            resetLatencies();
+            popupMessage("latency histograms cleared");
+        }
+    }
+
+    // [Read] on the worker, values gets the decoded elements
+    static int32_t readTagJob(PlcJob &job, const TagCodec &codec, const string &tagstring, vector<string> &values) {
+        int32_t tag = createTag(job.error_string, tagstring, DATA_TIMEOUT, codec.type);
+        if(tag < 0) return tag;
+
+        int32_t rc = cancellableTagRead(tag, DATA_TIMEOUT, codec.type, job.cancelFlag());
+        if(rc != PLCTAG_STATUS_OK) {
+            job.error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         } else {
-            vector<T> values = toNumericVector<T>(getSection3Values());
-            rc = writeNumericTag(es, tag, values);
+            rc = codec.decode(job.error_string, tag, &values);
         }
 
-        if(rc < 0) popupMessage(es);
+        destroyTag(tag);
+        return rc;
+    }
+
+    // [Write] on the worker
+    static int32_t writeTagJob(PlcJob &job, const TagCodec &codec, const string &tagstring, const vector<string> &values) {
+        int32_t tag = createTag(job.error_string, tagstring, DATA_TIMEOUT, codec.type);
+        if(tag < 0) return tag;
+
+        int32_t rc = codec.write(job.error_string, tag, values, DATA_TIMEOUT);
 
+        destroyTag(tag);
         return rc;
     }
 
     void handleEnterKey(Field &f) {
         string ftype = getType();
         int cnt = getCount();
-        string es;
 
         if(false) {
             //PLACEHOLDER
             //popupMessage(to_string(rc));
         } else  if(!f.editable && (f.label=="[Read]" || f.label=="[Write]")) {
-            string tagstring = buildTagstring(getGateway(), getTagname(), cnt, getPath(), getCpu(), getProtocol());
-            int32_t tag = createTag(es, tagstring);
-            if(tag < 0) {
-                popupMessage(es);
-                goto end_case;
+            stopMonitor();
+            closeReplay();
+            const TagCodec *codec = tagCodecForUiType(ftype);
+            if(!codec) {
+                popupMessage(ssprintf("no codec for type %s", ftype.c_str()));
+                return;
             }
 
-            if(f.label == "[Read]") {
-                if("INT8" == ftype || "BOOL" == ftype) {
-                    readTagAndUpdateSection3<int8_t>(tag);
-                } else if("INT16" == ftype) {
-                    readTagAndUpdateSection3<int16_t>(tag);
-                } else if("INT32" == ftype) {
-                    readTagAndUpdateSection3<int32_t>(tag);
-                } else if("INT64" == ftype) {
-                    readTagAndUpdateSection3<int64_t>(tag);
-                } else if("UINT8" == ftype) {
-                    readTagAndUpdateSection3<uint8_t>(tag);
-                } else if("UINT16" == ftype) {
-                    readTagAndUpdateSection3<uint16_t>(tag);
-                } else if("UINT32" == ftype) {
-                    readTagAndUpdateSection3<uint32_t>(tag);
-                } else if("UINT64" == ftype) {
-                    readTagAndUpdateSection3<uint64_t>(tag);
-                } else if("REAL32" == ftype) {
-                    readTagAndUpdateSection3<float_t>(tag);
-                } else if("REAL64" == ftype) {
-                    readTagAndUpdateSection3<double_t>(tag);
-                } else if("BIT" == ftype) {
-                    readTagAndUpdateSection3<bool>(tag);
-                } else if("STRING" == ftype) {
-                    readTagAndUpdateSection3<string>(tag);
-                }
-            } else if(f.label == "[Write]") {
-                if("INT8" == ftype || "BOOL" == ftype) {
-                    writeTagFromSection3<int8_t>(tag);
-                } else if("INT16" == ftype) {
-                    writeTagFromSection3<int16_t>(tag);
-                } else if("INT32" == ftype) {
-                    writeTagFromSection3<int32_t>(tag);
-                } else if("INT64" == ftype) {
-                    writeTagFromSection3<int64_t>(tag);
-                } else if("UINT8" == ftype) {
-                    writeTagFromSection3<uint8_t>(tag);
-                } else if("UINT16" == ftype) {
-                    writeTagFromSection3<uint16_t>(tag);
-                } else if("UINT32" == ftype) {
-                    writeTagFromSection3<uint32_t>(tag);
-                } else if("UINT64" == ftype) {
-                    writeTagFromSection3<uint64_t>(tag);
-                } else if("REAL32" == ftype) {
-                    writeTagFromSection3<float_t>(tag);
-                } else if("REAL64" == ftype) {
-                    writeTagFromSection3<double_t>(tag);
-                } else if("BIT" == ftype) {
-                    writeTagFromSection3<bool>(tag);
-                } else if("STRING" == ftype) {
-                    writeTagFromSection3<string>(tag);
-                }
+            string tagstring = buildTagstring(getGateway(), getTagname(), cnt, getPath(), getCpu(), getProtocol());
+            bool read = f.label == "[Read]";
+            vector<string> values;
+            if(!read) values = getSection3Values();
+
+            PlcJobResult result = runOnWorker(ssprintf("%s %s", read ? "reading" : "writing", getTagname().c_str()), [&](PlcJob &job) {
+                return read ? readTagJob(job, *codec, tagstring, values) : writeTagJob(job, *codec, tagstring, values);
+            });
+
+            if(result.status < 0) {
+                popupMessage(result.error_string);
+            } else if(read) {
+                updateSection3FromVector(values);
             }
-            plc_tag_destroy(tag);
-        end_case:;
         }
     }
 
@@ -46,28 +46,59 @@
 #include <limits.h>
 #include <platform.h>
 #include <stdlib.h>
+#include <string.h>
 #include <utils/atomic_utils.h>
 #include <utils/attr.h>
 #include <utils/debug.h>
 #include <utils/hash.h>
-#include <utils/hashtable.h>
 #include <utils/random_utils.h>
 #include <utils/rc.h>
 #include <utils/vector.h>
 
 
-#define INITIAL_TAG_TABLE_SIZE (201)
-
 #define TAG_ID_MASK (0xFFFFFFF)
 
-#define MAX_TAG_MAP_ATTEMPTS (50)
-
 /* these are only internal to the file */
 
 static volatile int32_t next_tag_id = 10; /* MAGIC */
-static volatile hashtable_p tags = NULL;
 static mutex_p tag_lookup_mutex = NULL;
 
+/*
+ * Tag ID lookup.
+ *
+ * Tags sit in an array indexed by the low bits of their ID, the rest of the
+ * ID works as a generation: lookup_tag() checks the whole ID on the tag it
+ * finds, so a stale handle whose slot was reused is not found.
+ * add_tag_lookup() skips IDs whose slot is taken and doubles the array before
+ * it gets half full.
+ *
+ * Readers take no lock. lookup_tag() counts itself in one of
+ * TAG_LOOKUP_READER_SHARDS counters chosen by the tag ID, so threads using
+ * different tags touch different cache lines, loads the array and the slot
+ * atomically and takes its reference before it counts itself out again.
+ * Writers hold tag_lookup_mutex. Removing a tag or replacing the array is
+ * followed by wait_for_tag_readers(), and only after that is the table's
+ * reference dropped or the old array freed. The counters come in two sets
+ * picked by tag_lookup_epoch. The writer flips the epoch before waiting on
+ * a set, so new readers use the other set and the wait always ends.
+ */
+typedef struct {
+    int capacity; /* power of two */
+    int count;
+    atomic_ptr_t slots[];
+} tag_lookup_table_t, *tag_lookup_table_p;
+
+typedef struct {
+    atomic_int32_t count;
+    uint8_t padding[64 - sizeof(atomic_int32_t)]; /* one cache line each */
+} tag_lookup_readers_t;
+
+#define TAG_LOOKUP_INITIAL_SIZE (256)
+#define TAG_LOOKUP_READER_SHARDS (64)
+static atomic_ptr_t tag_lookup_table = NULL;
+static atomic_int32_t tag_lookup_epoch = 0;
+static tag_lookup_readers_t tag_lookup_readers[2][TAG_LOOKUP_READER_SHARDS];
+
 atomic_bool library_terminating = false;
 
 static thread_p tag_tickler_thread = NULL;
@@ -76,15 +107,69 @@ static cond_p tag_tickler_wait = NULL;
 #define TAG_TICKLER_TIMEOUT_MIN_MS (10)
 static int64_t tag_tickler_wait_timeout_end = 0;
 
+/*
+ * The tickler only visits tags that have something to do.
+ *
+ * plc_tag_tickler_ready() puts a tag on tag_ready, with a reference, when it
+ * is created or destroyed, when a read, write or abort starts, when an event
+ * is raised and when the data of an auto-sync write tag changes. After its
+ * tickle a tag that is still busy goes back on tag_ready, an idle auto-sync
+ * tag waits in the timer wheel until tickle_due and anything else is dropped,
+ * so a pass costs O(active tags) instead of O(tag table capacity).
+ *
+ * tag_ready and tickle_queued are guarded by tag_ready_mutex. tag_ready_work,
+ * the wheel and the tickle_* fields the wheel uses belong to the tickler
+ * thread.
+ */
+static mutex_p tag_ready_mutex = NULL;
+static vector_p tag_ready = NULL;
+static vector_p tag_ready_work = NULL;
+#define TAG_READY_INITIAL_SIZE (200)
+#define TAG_READY_MAX_INC (10000)
+
+/*
+ * Hierarchical timer wheel for the idle auto-sync tags, 1ms per tick.
+ *
+ * Level n has TAG_WHEEL_SLOTS slots of TAG_WHEEL_SLOTS^n ticks each, so the
+ * four levels reach about 4.6 hours; later deadlines sit in the last slot that
+ * far out and are placed again when it comes up. Each slot is a list linked
+ * through tickle_next/tickle_prev, tickle_wheel_slot is the slot + 1. Adding
+ * and removing a tag is O(1). Every tick expires one level 0 slot, and each
+ * time a level wraps the next slot of the level above is spread over the
+ * levels below it.
+ */
+#define TAG_WHEEL_BITS (6)
+#define TAG_WHEEL_SLOTS (1 << TAG_WHEEL_BITS)
+#define TAG_WHEEL_MASK (TAG_WHEEL_SLOTS - 1)
+#define TAG_WHEEL_LEVELS (4)
+#define TAG_WHEEL_SPAN ((int64_t)1 << (TAG_WHEEL_BITS * TAG_WHEEL_LEVELS))
+static plc_tag_p tag_wheel[TAG_WHEEL_LEVELS * TAG_WHEEL_SLOTS];
+static int64_t tag_wheel_time = 0; /* every tick up to this one has expired. */
+static int tag_wheel_count = 0;
+
 // static mutex_p global_library_mutex = NULL;
 
 
 /* helper functions. */
 static plc_tag_p lookup_tag(int32_t id);
 static int add_tag_lookup(plc_tag_p tag);
+static plc_tag_p remove_tag_lookup(int32_t id);
+static int remove_tag_lookups(const int32_t *ids, int count, plc_tag_p *tags);
+static plc_tag_p tag_lookup_slot_unsafe(int32_t id);
+static tag_lookup_table_p tag_lookup_table_create(int capacity);
+static void wait_for_tag_readers(void);
 static int tag_id_inc(int id);
 static THREAD_FUNC(tag_tickler_func);
+static void tag_tickler_stop(void);
+static void tag_ready_push(plc_tag_p tag, int wake);
+static void tag_wheel_add(plc_tag_p tag);
+static void tag_wheel_remove(plc_tag_p tag);
+static void tag_wheel_advance(int64_t now, vector_p expired);
+static int64_t tag_wheel_next_due(void);
+static int64_t tag_auto_sync_first_read(plc_tag_p tag);
+static int tag_is_busy_unsafe(plc_tag_p tag);
 static int plc_tag_abort_impl(plc_tag_p tag);
+static void plc_tag_destroy_removed(plc_tag_p tag);
 static int set_tag_byte_order(plc_tag_p tag, attr attribs);
 static int check_byte_order_str(const char *byte_order, int length);
 static int get_string_total_length_unsafe(plc_tag_p tag, int string_start_offset);
@@ -140,20 +225,32 @@ int lib_init(void) {
 
     pdebug(DEBUG_INFO, "Setting up global library data.");
 
-    pdebug(DEBUG_INFO, "Creating tag hashtable.");
-    if((tags = hashtable_create(INITIAL_TAG_TABLE_SIZE)) == NULL) { /* MAGIC */
-        pdebug(DEBUG_ERROR, "Unable to create tag hashtable!");
+    pdebug(DEBUG_INFO, "Creating tag lookup table.");
+    atomic_set_ptr(&tag_lookup_table, tag_lookup_table_create(TAG_LOOKUP_INITIAL_SIZE));
+    if(!atomic_get_ptr(&tag_lookup_table)) {
+        pdebug(DEBUG_ERROR, "Unable to create tag lookup table!");
         return PLCTAG_ERR_NO_MEM;
     }
 
-    pdebug(DEBUG_INFO, "Creating tag hashtable mutex.");
+    pdebug(DEBUG_INFO, "Creating tag lookup mutex.");
     rc = mutex_create((mutex_p *)&tag_lookup_mutex);
-    if(rc != PLCTAG_STATUS_OK) { pdebug(DEBUG_ERROR, "Unable to create tag hashtable mutex!"); }
+    if(rc != PLCTAG_STATUS_OK) { pdebug(DEBUG_ERROR, "Unable to create tag lookup mutex!"); }
 
     pdebug(DEBUG_INFO, "Creating tag condition variable.");
     rc = cond_create((cond_p *)&tag_tickler_wait);
     if(rc != PLCTAG_STATUS_OK) { pdebug(DEBUG_ERROR, "Unable to create tag condition var!"); }
 
+    pdebug(DEBUG_INFO, "Creating tag ready queues.");
+    rc = mutex_create((mutex_p *)&tag_ready_mutex);
+    if(rc != PLCTAG_STATUS_OK) { pdebug(DEBUG_ERROR, "Unable to create tag ready queue mutex!"); }
+
+    tag_ready = vector_create(TAG_READY_INITIAL_SIZE, TAG_READY_MAX_INC);
+    tag_ready_work = vector_create(TAG_READY_INITIAL_SIZE, TAG_READY_MAX_INC);
+    if(!tag_ready || !tag_ready_work) {
+        pdebug(DEBUG_ERROR, "Unable to create tag ready queues!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
     pdebug(DEBUG_INFO, "Creating tag tickler thread.");
     rc = thread_create(&tag_tickler_thread, tag_tickler_func, 32 * 1024, NULL);
     if(rc != PLCTAG_STATUS_OK) { pdebug(DEBUG_ERROR, "Unable to create tag tickler thread!"); }
@@ -169,18 +266,17 @@ void lib_teardown(void) {
 
     atomic_set_bool(&library_terminating, true);
 
-    if(tag_tickler_wait) {
-        pdebug(DEBUG_INFO, "Signaling tag tickler condition var.");
-        cond_signal(tag_tickler_wait);
-    }
+    tag_tickler_stop();
 
-    if(tag_tickler_thread) {
-        pdebug(DEBUG_INFO, "Tearing down tag tickler thread.");
-        thread_join(tag_tickler_thread);
-        thread_destroy(&tag_tickler_thread);
-        tag_tickler_thread = NULL;
+    if(tag_ready_mutex) {
+        pdebug(DEBUG_INFO, "Tearing down tag ready queues.");
+        mutex_destroy(&tag_ready_mutex);
+        tag_ready_mutex = NULL;
     }
 
+    if(tag_ready) { vector_destroy(tag_ready); tag_ready = NULL; }
+    if(tag_ready_work) { vector_destroy(tag_ready_work); tag_ready_work = NULL; }
+
     if(tag_tickler_wait) {
         pdebug(DEBUG_INFO, "Tearing down tag tickler condition var.");
         cond_destroy(&tag_tickler_wait);
@@ -193,10 +289,10 @@ void lib_teardown(void) {
         tag_lookup_mutex = NULL;
     }
 
-    if(tags) {
-        pdebug(DEBUG_INFO, "Destroying tag hashtable.");
-        hashtable_destroy(tags);
-        tags = NULL;
+    if(atomic_get_ptr(&tag_lookup_table)) {
+        /* every thread using the library is done by now. */
+        pdebug(DEBUG_INFO, "Destroying tag lookup table.");
+        mem_free(atomic_set_ptr(&tag_lookup_table, NULL));
     }
 
     atomic_set_bool(&library_terminating, false);
@@ -228,6 +324,268 @@ int plc_tag_tickler_wake_impl(const char *func, int line_num) {
 }
 
 
+/*
+ * Hand a tag to the tickler. Safe with or without the tag API mutex held,
+ * takes only tag_ready_mutex. A tag that is already queued or is being
+ * destroyed is left alone.
+ */
+void plc_tag_tickler_ready(plc_tag_p tag) {
+    tag_ready_push(tag, 1);
+}
+
+
+/* tag API mutex held: new data for an auto-sync write, the tickler has to schedule it. */
+static inline void tag_set_dirty_unsafe(plc_tag_p tag) {
+    tag->tag_is_dirty = 1;
+    plc_tag_tickler_ready(tag);
+}
+
+
+static void tag_ready_push(plc_tag_p tag, int wake) {
+    int queued = 0;
+    plc_tag_p ref = NULL;
+
+    if(!tag || !tag_ready_mutex) { return; }
+
+    critical_block(tag_ready_mutex) {
+        if(!tag_ready || tag->tickle_queued) { break; }
+
+        /* NULL if the last reference is already gone. */
+        ref = rc_inc(tag);
+        if(!ref) { break; }
+
+        if(vector_set(tag_ready, vector_length(tag_ready), ref) == PLCTAG_STATUS_OK) {
+            tag->tickle_queued = 1;
+            queued = 1;
+            ref = NULL;
+        }
+    }
+
+    /* never run a destructor under the queue mutex. */
+    if(ref) {
+        pdebug(DEBUG_WARN, "Unable to queue tag %" PRId32 " for the tickler!", tag->tag_id);
+        rc_dec(ref);
+    }
+
+    if(queued && wake) { plc_tag_tickler_wake(); }
+}
+
+
+/* tickler thread only, the wheel takes over the caller's reference. */
+static void tag_wheel_add(plc_tag_p tag) {
+    int64_t due = tag->tickle_due;
+    int64_t delta = 0;
+    int level = 0;
+    int slot = 0;
+
+    if(due <= tag_wheel_time) { due = tag_wheel_time + 1; }
+    if(due - tag_wheel_time >= TAG_WHEEL_SPAN) { due = tag_wheel_time + TAG_WHEEL_SPAN - 1; }
+
+    delta = due - tag_wheel_time;
+    while(level < TAG_WHEEL_LEVELS - 1 && delta >= ((int64_t)1 << (TAG_WHEEL_BITS * (level + 1)))) { level++; }
+
+    slot = (level * TAG_WHEEL_SLOTS) + (int)((due >> (TAG_WHEEL_BITS * level)) & TAG_WHEEL_MASK);
+
+    tag->tickle_prev = NULL;
+    tag->tickle_next = tag_wheel[slot];
+    if(tag->tickle_next) { tag->tickle_next->tickle_prev = tag; }
+    tag_wheel[slot] = tag;
+
+    tag->tickle_wheel_slot = slot + 1;
+    tag_wheel_count++;
+}
+
+
+/* tickler thread only, the caller gets the reference the wheel held. */
+static void tag_wheel_remove(plc_tag_p tag) {
+    int slot = tag->tickle_wheel_slot - 1;
+
+    if(slot < 0) { return; }
+
+    if(tag->tickle_prev) {
+        tag->tickle_prev->tickle_next = tag->tickle_next;
+    } else {
+        tag_wheel[slot] = tag->tickle_next;
+    }
+
+    if(tag->tickle_next) { tag->tickle_next->tickle_prev = tag->tickle_prev; }
+
+    tag->tickle_next = NULL;
+    tag->tickle_prev = NULL;
+    tag->tickle_wheel_slot = 0;
+    tag_wheel_count--;
+}
+
+
+static void tag_wheel_expire(plc_tag_p tag, vector_p expired) {
+    if(vector_set(expired, vector_length(expired), tag) != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to queue expired tag %" PRId32 "!", tag->tag_id);
+        rc_dec(tag);
+    }
+}
+
+
+/* tickler thread only, moves the tags due by now, and their references, to expired. */
+static void tag_wheel_advance(int64_t now, vector_p expired) {
+    if(tag_wheel_count == 0 || tag_wheel_time == 0) {
+        tag_wheel_time = now;
+        return;
+    }
+
+    while(tag_wheel_time < now && tag_wheel_count > 0) {
+        plc_tag_p tag = NULL;
+        int level = 1;
+
+        tag_wheel_time++;
+
+        /* each level that wrapped hands its next slot down. */
+        while(level < TAG_WHEEL_LEVELS && (tag_wheel_time & (((int64_t)1 << (TAG_WHEEL_BITS * level)) - 1)) == 0) {
+            int slot = (level * TAG_WHEEL_SLOTS) + (int)((tag_wheel_time >> (TAG_WHEEL_BITS * level)) & TAG_WHEEL_MASK);
+
+            tag = tag_wheel[slot];
+
+            while(tag) {
+                plc_tag_p next = tag->tickle_next;
+
+                tag_wheel_remove(tag);
+
+                /* due this tick: the level 0 slot below is already the right one. */
+                if(tag->tickle_due <= tag_wheel_time) {
+                    tag_wheel_expire(tag, expired);
+                } else {
+                    tag_wheel_add(tag);
+                }
+
+                tag = next;
+            }
+
+            level++;
+        }
+
+        while(tag_wheel[tag_wheel_time & TAG_WHEEL_MASK]) {
+            tag = tag_wheel[tag_wheel_time & TAG_WHEEL_MASK];
+            tag_wheel_remove(tag);
+            tag_wheel_expire(tag, expired);
+        }
+    }
+
+    /* nothing left to expire, skip the empty ticks. */
+    if(tag_wheel_time < now) { tag_wheel_time = now; }
+}
+
+
+/* tickler thread only, when the wheel next needs a look: the first full level 0 slot or the next wrap. */
+static int64_t tag_wheel_next_due(void) {
+    int64_t next_wrap = 0;
+
+    if(tag_wheel_count == 0) { return INT64_MAX; }
+
+    next_wrap = (tag_wheel_time | TAG_WHEEL_MASK) + 1;
+
+    for(int64_t tick = tag_wheel_time + 1; tick < next_wrap; tick++) {
+        if(tag_wheel[tick & TAG_WHEEL_MASK]) { return tick; }
+    }
+
+    return next_wrap;
+}
+
+
+/*
+ * The first automatic read of a tag, somewhere in its first period so that
+ * tags created together do not all read in the same tick. With
+ * auto_sync_read_spread the offset is the bit reversed tag ID scaled to the
+ * period: tag IDs are handed out in sequence, so any run of 2^k tags with
+ * the same period lands in 2^k different parts of it, and the offsets are
+ * taken from multiples of the period so that tags created at different times
+ * stay staggered too. Without it the offset is random as before.
+ */
+static int64_t tag_auto_sync_first_read(plc_tag_p tag) {
+    int64_t now = time_ms();
+    int64_t period = (int64_t)tag->auto_sync_read_ms;
+    uint32_t id = (uint32_t)tag->tag_id;
+    int64_t first = 0;
+
+    if(period <= 0) { return 0; }
+
+    if(!tag->auto_sync_read_spread) { return now + (int64_t)(random_u64((uint64_t)period)); }
+
+    id = ((id >> 1) & 0x55555555) | ((id & 0x55555555) << 1);
+    id = ((id >> 2) & 0x33333333) | ((id & 0x33333333) << 2);
+    id = ((id >> 4) & 0x0F0F0F0F) | ((id & 0x0F0F0F0F) << 4);
+    id = ((id >> 8) & 0x00FF00FF) | ((id & 0x00FF00FF) << 8);
+    id = (id >> 16) | (id << 16);
+
+    first = ((now / period) * period) + (int64_t)(((uint64_t)id * (uint64_t)period) >> 32);
+    if(first <= now) { first += period; }
+
+    return first;
+}
+
+
+/* tag API mutex held: does the tickler have to look at this tag again without being asked? */
+static int tag_is_busy_unsafe(plc_tag_p tag) {
+    if(tag->read_in_flight || tag->write_in_flight || tag->read_complete || tag->write_complete) { return 1; }
+
+    if(atomic_get_bool(&tag->abort_requested)) { return 1; }
+
+    /* creation and protocol level operations the generic flags do not see. */
+    if(tag->vtable && tag->vtable->status && tag->vtable->status(tag) == PLCTAG_STATUS_PENDING) { return 1; }
+
+    return 0;
+}
+
+
+static void tag_tickler_stop(void) {
+    plc_tag_p tag = NULL;
+
+    if(tag_tickler_wait) {
+        pdebug(DEBUG_INFO, "Signaling tag tickler condition var.");
+        cond_signal(tag_tickler_wait);
+    }
+
+    if(tag_tickler_thread) {
+        pdebug(DEBUG_INFO, "Tearing down tag tickler thread.");
+        thread_join(tag_tickler_thread);
+        thread_destroy(&tag_tickler_thread);
+        tag_tickler_thread = NULL;
+    }
+
+    /* the thread is gone, release the references the queues hold. */
+    if(tag_ready_mutex && tag_ready) {
+        for(;;) {
+            tag = NULL;
+
+            critical_block(tag_ready_mutex) {
+                int len = vector_length(tag_ready);
+
+                if(len > 0) {
+                    tag = vector_remove(tag_ready, len - 1);
+                    tag->tickle_queued = 0;
+                }
+            }
+
+            if(!tag) { break; }
+
+            rc_dec(tag);
+        }
+    }
+
+    while(tag_ready_work && vector_length(tag_ready_work) > 0) {
+        rc_dec(vector_remove(tag_ready_work, vector_length(tag_ready_work) - 1));
+    }
+
+    for(int slot = 0; slot < TAG_WHEEL_LEVELS * TAG_WHEEL_SLOTS; slot++) {
+        while(tag_wheel[slot]) {
+            tag = tag_wheel[slot];
+            tag_wheel_remove(tag);
+            rc_dec(tag);
+        }
+    }
+
+    tag_wheel_time = 0;
+}
+
+
 int plc_tag_generic_wake_tag_impl(const char *func, int line_num, plc_tag_p tag) {
     int rc = PLCTAG_STATUS_OK;
 
@@ -344,8 +702,8 @@ void plc_tag_generic_tickler(plc_tag_p tag) {
             //     tag->auto_sync_next_read = current_time - (rand() % tag->auto_sync_read_ms);
             // }
 
-            /* do we need to read? */
-            if(tag->auto_sync_next_read < current_time) {
+            /* do we need to read? Zero is not scheduled yet, plc_tag_create_ex() sets it once the tag has its ID. */
+            if(tag->auto_sync_next_read && tag->auto_sync_next_read < current_time) {
                 /* make sure that we do not have an outstanding read or write. */
                 if(!tag->read_in_flight && !tag->tag_is_dirty && !tag->write_in_flight) {
                     int64_t periods = 0;
@@ -516,112 +874,127 @@ THREAD_FUNC(tag_tickler_func) {
     pdebug(DEBUG_INFO, "Starting.");
 
     while(!atomic_get_bool(&library_terminating)) {
-        int max_index = 0;
         int64_t timeout_wait_ms = TAG_TICKLER_TIMEOUT_MS;
+        int64_t current_time = time_ms();
+        vector_p swap = NULL;
 
         /* what is the maximum time we will wait until */
-        tag_tickler_wait_timeout_end = time_ms() + timeout_wait_ms;
+        tag_tickler_wait_timeout_end = current_time + timeout_wait_ms;
 
-        critical_block(tag_lookup_mutex) { max_index = hashtable_capacity(tags); }
+        /* take everything that was queued, tags queued from here on go to the next pass. */
+        critical_block(tag_ready_mutex) {
+            swap = tag_ready;
+            tag_ready = tag_ready_work;
+            tag_ready_work = swap;
 
-        for(int i = 0; i < max_index; i++) {
-            plc_tag_p tag = NULL;
-
-            critical_block(tag_lookup_mutex) {
-                /* look up the max index again. it may have changed. */
-                max_index = hashtable_capacity(tags);
+            for(int i = 0; i < vector_length(tag_ready_work); i++) {
+                plc_tag_p tag = vector_get(tag_ready_work, i);
+                tag->tickle_queued = 0;
+            }
+        }
 
-                if(i < max_index) {
-                    tag = hashtable_get_index(tags, i);
+        /* a queued tag is tickled now, it does not need its wheel entry. */
+        for(int i = 0; i < vector_length(tag_ready_work); i++) {
+            plc_tag_p tag = vector_get(tag_ready_work, i);
 
-                    if(tag) {
-                        debug_set_tag_id(tag->tag_id);
-                        pdebug(DEBUG_SPEW, "rc_inc: Acquiring reference to tag %" PRId32 ".", tag->tag_id);
-                        tag = rc_inc(tag);
-                    }
-                } else {
-                    debug_set_tag_id(0);
-                    tag = NULL;
-                }
+            if(tag->tickle_wheel_slot) {
+                tag_wheel_remove(tag);
+                rc_dec(tag);
             }
+        }
 
-            if(tag) {
-                debug_set_tag_id(tag->tag_id);
+        /* add the tags that are due, their reference moves with them. */
+        tag_wheel_advance(current_time, tag_ready_work);
 
-                if(!tag->skip_tickler) {
-                    pdebug(DEBUG_DETAIL, "Tickling tag %d.", tag->tag_id);
+        while(vector_length(tag_ready_work) > 0) {
+            plc_tag_p tag = vector_remove(tag_ready_work, vector_length(tag_ready_work) - 1);
+            int mapped = 0;
+            int release = 1;
 
-                    /* try to hold the tag API mutex while all this goes on. */
-                    if(mutex_try_lock(tag->api_mutex) == PLCTAG_STATUS_OK) {
-                        plc_tag_generic_tickler(tag);
+            /* destroyed tags come through once more so that their references are dropped. */
+            critical_block(tag_lookup_mutex) { mapped = (tag_lookup_slot_unsafe(tag->tag_id) == tag); }
 
-                        /* call the tickler function if we can. */
-                        if(tag->vtable && tag->vtable->tickler) {
-                            /* call the tickler on the tag. */
-                            tag->vtable->tickler(tag);
+            if(!mapped || tag->skip_tickler) {
+                rc_dec(tag);
+                continue;
+            }
 
-                            if(tag->read_complete) {
-                                tag->read_complete = 0;
-                                tag->read_in_flight = 0;
+            debug_set_tag_id(tag->tag_id);
 
-                                // tag->event_read_complete = 1;
-                                tag_raise_event(tag, PLCTAG_EVENT_READ_COMPLETED, tag->status);
+            pdebug(DEBUG_DETAIL, "Tickling tag %d.", tag->tag_id);
 
-                                /* wake immediately */
-                                plc_tag_tickler_wake();
-                                cond_signal(tag->tag_cond_wait);
-                            }
+            /* try to hold the tag API mutex while all this goes on. */
+            if(mutex_try_lock(tag->api_mutex) == PLCTAG_STATUS_OK) {
+                plc_tag_generic_tickler(tag);
 
-                            if(tag->write_complete) {
-                                tag->write_complete = 0;
-                                tag->write_in_flight = 0;
-                                tag->auto_sync_next_write = 0;
+                /* call the tickler function if we can. */
+                if(tag->vtable && tag->vtable->tickler) {
+                    /* call the tickler on the tag. */
+                    tag->vtable->tickler(tag);
 
-                                // tag->event_write_complete = 1;
-                                tag_raise_event(tag, PLCTAG_EVENT_WRITE_COMPLETED, tag->status);
+                    if(tag->read_complete) {
+                        tag->read_complete = 0;
+                        tag->read_in_flight = 0;
 
-                                /* wake immediately */
-                                plc_tag_tickler_wake();
-                                cond_signal(tag->tag_cond_wait);
-                            }
-                        }
+                        // tag->event_read_complete = 1;
+                        tag_raise_event(tag, PLCTAG_EVENT_READ_COMPLETED, tag->status);
 
-                        /* wake up earlier if the time until the next write wake up is sooner. */
-                        if(tag->auto_sync_next_write && tag->auto_sync_next_write < tag_tickler_wait_timeout_end) {
-                            tag_tickler_wait_timeout_end = tag->auto_sync_next_write;
-                        }
+                        /* wake immediately */
+                        plc_tag_tickler_wake();
+                        cond_signal(tag->tag_cond_wait);
+                    }
 
-                        /* wake up earlier if the time until the next read wake up is sooner. */
-                        if(tag->auto_sync_next_read && tag->auto_sync_next_read < tag_tickler_wait_timeout_end) {
-                            tag_tickler_wait_timeout_end = tag->auto_sync_next_read;
-                        }
+                    if(tag->write_complete) {
+                        tag->write_complete = 0;
+                        tag->write_in_flight = 0;
+                        tag->auto_sync_next_write = 0;
 
-                        /* we are done with the tag API mutex now. */
-                        mutex_unlock(tag->api_mutex);
+                        // tag->event_write_complete = 1;
+                        tag_raise_event(tag, PLCTAG_EVENT_WRITE_COMPLETED, tag->status);
 
-                        /* call callbacks */
-                        plc_tag_generic_handle_event_callbacks(tag);
-                    } else {
-                        pdebug(DEBUG_DETAIL, "Skipping tag as it is already locked.");
+                        /* wake immediately */
+                        plc_tag_tickler_wake();
+                        cond_signal(tag->tag_cond_wait);
                     }
+                }
 
+                if(tag_is_busy_unsafe(tag)) {
+                    /* look again next pass, the session thread wakes us when data comes in. */
+                    tag_ready_push(tag, 0);
                 } else {
-                    pdebug(DEBUG_DETAIL, "Tag has its own tickler.");
+                    int64_t due = INT64_MAX;
+
+                    /* a dirty tag does not read until its write is done, which queues it again. */
+                    if(tag->auto_sync_read_ms > 0 && tag->auto_sync_next_read && !tag->tag_is_dirty) { due = tag->auto_sync_next_read; }
+                    if(tag->auto_sync_next_write && tag->auto_sync_next_write < due) { due = tag->auto_sync_next_write; }
+
+                    if(due != INT64_MAX) {
+                        /* the wheel keeps our reference. */
+                        tag->tickle_due = due;
+                        tag_wheel_add(tag);
+                        release = 0;
+                    }
                 }
 
-                // pdebug(DEBUG_DETAIL, "Current time %" PRId64 ".", time_ms());
-                // pdebug(DEBUG_DETAIL, "Time to wake %" PRId64 ".", tag_tickler_wait_timeout_end);
-                // pdebug(DEBUG_DETAIL, "Auto read time %" PRId64 ".", tag->auto_sync_next_read);
-                // pdebug(DEBUG_DETAIL, "Auto write time %" PRId64 ".", tag->auto_sync_next_write);
+                /* we are done with the tag API mutex now. */
+                mutex_unlock(tag->api_mutex);
 
-                debug_set_tag_id(0);
-            }
+                /* call callbacks */
+                plc_tag_generic_handle_event_callbacks(tag);
 
-            if(tag) { rc_dec(tag); }
+                if(release) { rc_dec(tag); }
+            } else {
+                pdebug(DEBUG_DETAIL, "Tag is locked, trying again next pass.");
+                tag_ready_push(tag, 0);
+                rc_dec(tag);
+            }
 
             debug_set_tag_id(0);
         }
 
+        /* wake up earlier if the next automatic read or write is sooner. */
+        if(tag_wheel_next_due() < tag_tickler_wait_timeout_end) { tag_tickler_wait_timeout_end = tag_wheel_next_due(); }
+
         if(tag_tickler_wait) {
             int64_t time_to_wait = tag_tickler_wait_timeout_end - time_ms();
             int wait_rc = PLCTAG_STATUS_OK;
@@ -661,6 +1034,9 @@ static int plc_tag_abort_impl(plc_tag_p tag) {
 
     atomic_set_bool(&tag->abort_requested, true);
 
+    /* the tickler clears the abort and raises the event. */
+    plc_tag_tickler_ready(tag);
+
     /* if the tag does not use a tickler, then wake the PLC thread */
     if(tag->vtable && tag->vtable->wake_plc) { rc = tag->vtable->wake_plc(tag); }
 
@@ -933,14 +1309,11 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str,
         attr_destroy(attribs);
         rc_dec(tag);
         return PLCTAG_ERR_BAD_PARAM;
-    } else if(tag->auto_sync_read_ms > 0) {
-        /* how many periods did we already pass? */
-        // int64_t periods = (time_ms() / tag->auto_sync_read_ms);
-        // tag->auto_sync_next_read = (periods + 1) * tag->auto_sync_read_ms;
-        /* start some time in the future, but with random jitter. */
-        tag->auto_sync_next_read = time_ms() + (int64_t)(random_u64((uint64_t)tag->auto_sync_read_ms));
     }
 
+    /* the first read is set once the tag has its ID. */
+    tag->auto_sync_read_spread = (uint8_t)(attr_get_int(attribs, "auto_sync_read_spread", 0) ? 1 : 0);
+
     tag->auto_sync_write_ms = attr_get_int(attribs, "auto_sync_write_ms", 0);
     if(tag->auto_sync_write_ms < 0) {
         pdebug(DEBUG_WARN, "auto_sync_write_ms value must be positive!");
@@ -985,6 +1358,18 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str,
 
     pdebug(DEBUG_INFO, "Returning mapped tag ID %d", id);
 
+    /*
+     * The session thread may already have handed the tag to the tickler, which
+     * leaves auto_sync_next_read at zero alone until this sets it. The ready
+     * call below then puts the first read on the wheel.
+     */
+    if(tag->auto_sync_read_ms > 0) {
+        critical_block(tag->api_mutex) { tag->auto_sync_next_read = tag_auto_sync_first_read(tag); }
+    }
+
+    /* creation finishes in the tickler. */
+    plc_tag_tickler_ready(tag);
+
     /* wake up tag's PLC here. */
     if(tag->vtable && tag->vtable->wake_plc) {
         tag->vtable->wake_plc(tag);
@@ -1000,8 +1385,8 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str,
         pdebug(DEBUG_WARN, "Error %s while trying to create tag!", plc_tag_decode_error(rc));
         if(tag->vtable && tag->vtable->abort) { tag->vtable->abort(tag); }
 
-        /* remove the tag from the hashtable. */
-        critical_block(tag_lookup_mutex) { hashtable_remove(tags, (int64_t)tag->tag_id); }
+        /* remove the tag from the lookup table. */
+        remove_tag_lookup(tag->tag_id);
 
         rc_dec(tag);
         return rc;
@@ -1035,8 +1420,8 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str,
                 pdebug(DEBUG_WARN, "Error %s while waiting for tag creation to complete!", plc_tag_decode_error(rc));
                 if(tag->vtable && tag->vtable->abort) { tag->vtable->abort(tag); }
 
-                /* remove the tag from the hashtable. */
-                critical_block(tag_lookup_mutex) { hashtable_remove(tags, (int64_t)tag->tag_id); }
+                /* remove the tag from the lookup table. */
+                remove_tag_lookup(tag->tag_id);
 
                 rc_dec(tag);
                 return rc;
@@ -1054,8 +1439,8 @@ LIB_EXPORT int32_t plc_tag_create_ex(const char *attrib_str,
                 pdebug(DEBUG_WARN, "Error %s while trying to create tag!", plc_tag_decode_error(rc));
                 if(tag->vtable && tag->vtable->abort) { tag->vtable->abort(tag); }
 
-                /* remove the tag from the hashtable. */
-                critical_block(tag_lookup_mutex) { hashtable_remove(tags, (int64_t)tag->tag_id); }
+                /* remove the tag from the lookup table. */
+                remove_tag_lookup(tag->tag_id);
 
                 rc_dec(tag);
                 return rc;
@@ -1102,16 +1487,18 @@ LIB_EXPORT void plc_tag_shutdown(void) {
     /* close all tags. */
     pdebug(DEBUG_INFO, "Closing all tags.");
 
-    critical_block(tag_lookup_mutex) { tag_table_entries = hashtable_capacity(tags); }
+    critical_block(tag_lookup_mutex) { tag_table_entries = ((tag_lookup_table_p)atomic_get_ptr(&tag_lookup_table))->capacity; }
 
     for(int i = 0; i < tag_table_entries; i++) {
         plc_tag_p tag = NULL;
 
         critical_block(tag_lookup_mutex) {
-            tag_table_entries = hashtable_capacity(tags);
+            tag_lookup_table_p table = atomic_get_ptr(&tag_lookup_table);
+
+            tag_table_entries = table->capacity;
 
             if(i < tag_table_entries && tag_table_entries >= 0) {
-                tag = hashtable_get_index(tags, i);
+                tag = atomic_get_ptr(&table->slots[i]);
 
                 /* make sure the tag does not go away while we are using the pointer. */
                 if(tag) {
@@ -1134,6 +1521,9 @@ LIB_EXPORT void plc_tag_shutdown(void) {
 
     pdebug(DEBUG_INFO, "All tags closed.");
 
+    /* the tickler queues still hold references that would keep sessions open. */
+    tag_tickler_stop();
+
     pdebug(DEBUG_INFO, "Cleaning up library resources.");
 
     destroy_modules();
@@ -1512,13 +1902,83 @@ LIB_EXPORT int plc_tag_destroy(int32_t tag_id) {
         return PLCTAG_ERR_NULL_PTR;
     }
 
-    critical_block(tag_lookup_mutex) { tag = hashtable_remove(tags, tag_id); }
+    tag = remove_tag_lookup(tag_id);
 
     if(!tag) {
         pdebug(DEBUG_WARN, "Called with non-existent tag!");
         return PLCTAG_ERR_NOT_FOUND;
     }
 
+    plc_tag_destroy_removed(tag);
+
+    /* wake the tickler, the abort queued the tag so that it drops its references. */
+    plc_tag_tickler_wake();
+
+    pdebug(DEBUG_INFO, "Done.");
+
+    debug_set_tag_id(0);
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+/*
+ * plc_tag_destroy_many()
+ *
+ * plc_tag_destroy() for count tags. The IDs are taken out of the lookup table
+ * in one pass with one wait for the readers, instead of one of each per tag.
+ * Invalid and unknown IDs are skipped.
+ *
+ * Returns PLCTAG_STATUS_OK when every tag was destroyed, PLCTAG_ERR_NOT_FOUND
+ * when at least one was not found. The others are destroyed either way.
+ */
+
+LIB_EXPORT int plc_tag_destroy_many(const int32_t *tag_ids, int count) {
+    plc_tag_p *tags = NULL;
+    int removed = 0;
+
+    pdebug(DEBUG_INFO, "Starting.");
+
+    if(!tag_ids) {
+        pdebug(DEBUG_WARN, "Called with null tag ID array!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    if(count <= 0) {
+        pdebug(DEBUG_WARN, "The tag count must be positive.");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    tags = (plc_tag_p *)mem_alloc(count * (int)sizeof(plc_tag_p));
+    if(!tags) {
+        pdebug(DEBUG_WARN, "Unable to allocate the tag pointer array!");
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    removed = remove_tag_lookups(tag_ids, count, tags);
+
+    for(int i = 0; i < count; i++) {
+        if(!tags[i]) { continue; }
+
+        debug_set_tag_id((int)tags[i]->tag_id);
+        plc_tag_destroy_removed(tags[i]);
+    }
+
+    debug_set_tag_id(0);
+
+    mem_free(tags);
+
+    /* wake the tickler once, the aborts queued the tags so that it drops its references. */
+    plc_tag_tickler_wake();
+
+    pdebug(DEBUG_INFO, "Done, destroyed %d of %d tags.", removed, count);
+
+    return removed == count ? PLCTAG_STATUS_OK : PLCTAG_ERR_NOT_FOUND;
+}
+
+
+/* the rest of a destroy once the tag is out of the lookup table, takes over the table's reference. */
+static void plc_tag_destroy_removed(plc_tag_p tag) {
     /* abort anything in flight */
     pdebug(DEBUG_DETAIL, "Aborting any in-flight operations.");
 
@@ -1526,20 +1986,11 @@ LIB_EXPORT int plc_tag_destroy(int32_t tag_id) {
 
     critical_block(tag->api_mutex) { tag_raise_event(tag, PLCTAG_EVENT_DESTROYED, PLCTAG_STATUS_OK); }
 
-    /* wake the tickler */
-    plc_tag_tickler_wake();
-
     plc_tag_generic_handle_event_callbacks(tag);
 
     /* release the reference outside the mutex. */
     pdebug(DEBUG_DETAIL, "rc_dec: Releasing reference to tag %" PRId32 " and tag mutex not locked.", tag->tag_id);
     rc_dec(tag);
-
-    pdebug(DEBUG_INFO, "Done.");
-
-    debug_set_tag_id(0);
-
-    return PLCTAG_STATUS_OK;
 }
 
 
@@ -1585,6 +2036,13 @@ LIB_EXPORT int plc_tag_read(int32_t id, int timeout) {
             break;
         }
 
+        if(tag->data_borrowed) {
+            pdebug(DEBUG_WARN, "Tag data is borrowed, release it before reading!");
+            rc = PLCTAG_ERR_BUSY;
+            is_done = 1;
+            break;
+        }
+
         if(tag->read_in_flight || tag->write_in_flight) {
             pdebug(DEBUG_WARN, "An operation is already in flight!");
             rc = PLCTAG_ERR_BUSY;
@@ -1602,6 +2060,9 @@ LIB_EXPORT int plc_tag_read(int32_t id, int timeout) {
         tag->read_in_flight = 1;
         tag->status = PLCTAG_STATUS_PENDING;
 
+        /* the tickler finishes the read. */
+        plc_tag_tickler_ready(tag);
+
         /* clear the condition var */
         cond_clear(tag->tag_cond_wait);
 
@@ -1765,6 +2226,13 @@ LIB_EXPORT int plc_tag_write(int32_t id, int timeout) {
     }
 
     critical_block(tag->api_mutex) {
+        if(tag->data_borrowed) {
+            pdebug(DEBUG_WARN, "Tag data is borrowed, release it before writing!");
+            is_done = 1;
+            rc = PLCTAG_ERR_BUSY;
+            break;
+        }
+
         if(tag->read_in_flight || tag->write_in_flight) {
             pdebug(DEBUG_WARN, "Tag already has an operation in flight!");
             is_done = 1;
@@ -1776,6 +2244,9 @@ LIB_EXPORT int plc_tag_write(int32_t id, int timeout) {
         tag->write_in_flight = 1;
         tag->status = PLCTAG_STATUS_OK;
 
+        /* the tickler finishes the write. */
+        plc_tag_tickler_ready(tag);
+
         /*
          * This needs to be done before we raise the event below in case the user code
          * tries to do something tricky like abort the write.   In that case, the condition
@@ -1935,6 +2406,9 @@ LIB_EXPORT int plc_tag_get_int_attribute(int32_t id, const char *attrib_name, in
             } else if(str_cmp_i(attrib_name, "auto_sync_read_ms") == 0) {
                 tag->status = PLCTAG_STATUS_OK;
                 res = (int)tag->auto_sync_read_ms;
+            } else if(str_cmp_i(attrib_name, "auto_sync_read_spread") == 0) {
+                tag->status = PLCTAG_STATUS_OK;
+                res = (int)tag->auto_sync_read_spread;
             } else if(str_cmp_i(attrib_name, "auto_sync_write_ms") == 0) {
                 tag->status = PLCTAG_STATUS_OK;
                 res = (int)tag->auto_sync_write_ms;
@@ -2020,7 +2494,10 @@ LIB_EXPORT int plc_tag_set_int_attribute(int32_t id, const char *attrib_name, in
                 }
             } else if(str_cmp_i(attrib_name, "auto_sync_read_ms") == 0) {
                 if(new_value >= 0) {
+                    /* start over in the new period and let the tickler schedule it. */
                     tag->auto_sync_read_ms = new_value;
+                    tag->auto_sync_next_read = tag_auto_sync_first_read(tag);
+                    plc_tag_tickler_ready(tag);
                     tag->status = PLCTAG_STATUS_OK;
                     res = PLCTAG_STATUS_OK;
                 } else {
@@ -2028,6 +2505,12 @@ LIB_EXPORT int plc_tag_set_int_attribute(int32_t id, const char *attrib_name, in
                     tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
                     res = PLCTAG_ERR_OUT_OF_BOUNDS;
                 }
+            } else if(str_cmp_i(attrib_name, "auto_sync_read_spread") == 0) {
+                tag->auto_sync_read_spread = (new_value > 0 ? 1 : 0);
+                tag->auto_sync_next_read = tag_auto_sync_first_read(tag);
+                plc_tag_tickler_ready(tag);
+                tag->status = PLCTAG_STATUS_OK;
+                res = PLCTAG_STATUS_OK;
             } else if(str_cmp_i(attrib_name, "auto_sync_write_ms") == 0) {
                 if(new_value >= 0) {
                     tag->auto_sync_write_ms = new_value;
@@ -2251,7 +2734,7 @@ static int plc_tag_set_bit_impl(plc_tag_p tag, int offset_bit, int val) {
                tag->data[real_offset / 8]);
 
         if((real_offset >= 0) && ((real_offset / 8) < tag->size)) {
-            if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+            if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
             if(val) {
                 tag->data[real_offset / 8] |= (uint8_t)(1 << (real_offset % 8));
@@ -2368,7 +2851,7 @@ LIB_EXPORT int plc_tag_set_uint64(int32_t id, int offset, uint64_t val) {
 
         if(!tag->is_bit) {
             if((offset >= 0) && (offset + ((int)sizeof(uint64_t)) <= tag->size)) {
-                if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+                if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
                 tag->data[offset + tag->byte_order->int64_order[0]] = (uint8_t)((val >> 0) & 0xFF);
                 tag->data[offset + tag->byte_order->int64_order[1]] = (uint8_t)((val >> 8) & 0xFF);
@@ -2477,7 +2960,7 @@ LIB_EXPORT int plc_tag_set_int64(int32_t id, int offset, int64_t ival) {
 
         if(!tag->is_bit) {
             if((offset >= 0) && (offset + ((int)sizeof(int64_t)) <= tag->size)) {
-                if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+                if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
                 tag->data[offset + tag->byte_order->int64_order[0]] = (uint8_t)((val >> 0) & 0xFF);
                 tag->data[offset + tag->byte_order->int64_order[1]] = (uint8_t)((val >> 8) & 0xFF);
@@ -2578,7 +3061,7 @@ LIB_EXPORT int plc_tag_set_uint32(int32_t id, int offset, uint32_t val) {
 
         if(!tag->is_bit) {
             if((offset >= 0) && (offset + ((int)sizeof(uint32_t)) <= tag->size)) {
-                if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+                if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
                 tag->data[offset + tag->byte_order->int32_order[0]] = (uint8_t)((val >> 0) & 0xFF);
                 tag->data[offset + tag->byte_order->int32_order[1]] = (uint8_t)((val >> 8) & 0xFF);
@@ -2676,7 +3159,7 @@ LIB_EXPORT int plc_tag_set_int32(int32_t id, int offset, int32_t ival) {
 
         if(!tag->is_bit) {
             if((offset >= 0) && (offset + ((int)sizeof(int32_t)) <= tag->size)) {
-                if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+                if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
                 tag->data[offset + tag->byte_order->int32_order[0]] = (uint8_t)((val >> 0) & 0xFF);
                 tag->data[offset + tag->byte_order->int32_order[1]] = (uint8_t)((val >> 8) & 0xFF);
@@ -2773,7 +3256,7 @@ LIB_EXPORT int plc_tag_set_uint16(int32_t id, int offset, uint16_t val) {
 
         if(!tag->is_bit) {
             if((offset >= 0) && (offset + ((int)sizeof(uint16_t)) <= tag->size)) {
-                if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+                if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
                 tag->data[offset + tag->byte_order->int16_order[0]] = (uint8_t)((val >> 0) & 0xFF);
                 tag->data[offset + tag->byte_order->int16_order[1]] = (uint8_t)((val >> 8) & 0xFF);
@@ -2869,7 +3352,7 @@ LIB_EXPORT int plc_tag_set_int16(int32_t id, int offset, int16_t ival) {
 
         if(!tag->is_bit) {
             if((offset >= 0) && (offset + ((int)sizeof(int16_t)) <= tag->size)) {
-                if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+                if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
                 tag->data[offset + tag->byte_order->int16_order[0]] = (uint8_t)((val >> 0) & 0xFF);
                 tag->data[offset + tag->byte_order->int16_order[1]] = (uint8_t)((val >> 8) & 0xFF);
@@ -2963,7 +3446,7 @@ LIB_EXPORT int plc_tag_set_uint8(int32_t id, int offset, uint8_t val) {
 
         if(!tag->is_bit) {
             if((offset >= 0) && (offset + ((int)sizeof(uint8_t)) <= tag->size)) {
-                if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+                if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
                 tag->data[offset] = val;
 
@@ -3057,7 +3540,7 @@ LIB_EXPORT int plc_tag_set_int8(int32_t id, int offset, int8_t ival) {
 
         if(!tag->is_bit) {
             if((offset >= 0) && (offset + ((int)sizeof(int8_t)) <= tag->size)) {
-                if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+                if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
                 tag->data[offset] = val;
 
@@ -3167,7 +3650,7 @@ LIB_EXPORT int plc_tag_set_float64(int32_t id, int offset, double fval) {
         }
 
         if((offset >= 0) && (offset + ((int)sizeof(double)) <= tag->size)) {
-            if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+            if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
             uint64_t val;
             /* copy the data into the uint64 value */
@@ -3278,7 +3761,7 @@ LIB_EXPORT int plc_tag_set_float32(int32_t id, int offset, float fval) {
         }
 
         if((offset >= 0) && (offset + ((int)sizeof(float)) <= tag->size)) {
-            if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+            if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
             uint32_t val;
             /* copy the data into the uint32 value */
@@ -3607,7 +4090,7 @@ LIB_EXPORT int plc_tag_set_string(int32_t tag_id, int string_start_offset, const
         pdebug_dump_bytes(DEBUG_DETAIL, tag->data + string_start_offset, new_string_size_in_buffer);
 
         /* if this is an auto-write tag, set the dirty flag to eventually trigger a write */
-        if(rc == PLCTAG_STATUS_OK && tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+        if(rc == PLCTAG_STATUS_OK && tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
         /* set the return and tag status. */
         rc = PLCTAG_STATUS_OK;
@@ -3809,7 +4292,7 @@ LIB_EXPORT int plc_tag_set_raw_bytes(int32_t id, int offset, uint8_t *buffer, in
     if(!tag->is_bit) {
         critical_block(tag->api_mutex) {
             if((offset >= 0) && ((offset + buffer_size) <= tag->size)) {
-                if(tag->auto_sync_write_ms > 0) { tag->tag_is_dirty = 1; }
+                if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
 
                 int i;
                 for(i = 0; i < buffer_size; i++) { tag->data[offset + i] = buffer[i]; }
@@ -3894,13 +4377,593 @@ LIB_EXPORT int plc_tag_get_raw_bytes(int32_t id, int offset, uint8_t *buffer, in
 }
 
 
-/*****************************************************************************************************
- *****************************  Support routines for extra indirection *******************************
- ****************************************************************************************************/
+/*
+ * Typed array access.
+ *
+ * plc_tag_get_<type>_array() and plc_tag_set_<type>_array() move count packed
+ * elements starting at offset with one lookup and one lock. The tag's byte
+ * order for the type is turned into a permutation of the bytes of one host
+ * element. When it is the identity the elements are copied as they are. When
+ * it is the reverse, the common big endian case, the SIMD byte swap kernel
+ * below runs. Any other order, like the PLC/5 word swapped floats, is permuted
+ * byte by byte.
+ */
 
-int set_tag_byte_order(plc_tag_p tag, attr attribs)
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#    define HOST_IS_BIG_ENDIAN (1)
+#else
+#    define HOST_IS_BIG_ENDIAN (0)
+#endif
 
-{
+typedef enum { ARRAY_ELEM_8, ARRAY_ELEM_INT16, ARRAY_ELEM_INT32, ARRAY_ELEM_INT64, ARRAY_ELEM_FLOAT32, ARRAY_ELEM_FLOAT64 } array_elem_t;
+
+typedef enum { ARRAY_PERM_IDENTITY, ARRAY_PERM_REVERSE, ARRAY_PERM_OTHER } array_perm_t;
+
+
+/* perm[j] is where host byte j of an element lives in the tag data. */
+static array_perm_t array_elem_perm(plc_tag_p tag, array_elem_t elem, int *elem_size, int perm[8]) {
+    const int *order = NULL;
+    int identity = 1;
+    int reverse = 1;
+
+    switch(elem) {
+        case ARRAY_ELEM_INT16: order = tag->byte_order->int16_order; *elem_size = 2; break;
+        case ARRAY_ELEM_INT32: order = tag->byte_order->int32_order; *elem_size = 4; break;
+        case ARRAY_ELEM_INT64: order = tag->byte_order->int64_order; *elem_size = 8; break;
+        case ARRAY_ELEM_FLOAT32: order = tag->byte_order->float32_order; *elem_size = 4; break;
+        case ARRAY_ELEM_FLOAT64: order = tag->byte_order->float64_order; *elem_size = 8; break;
+        default: *elem_size = 1; return ARRAY_PERM_IDENTITY;
+    }
+
+    /* order[k] holds byte k of the value, counting from the least significant one. */
+    for(int k = 0; k < *elem_size; k++) {
+        int host = HOST_IS_BIG_ENDIAN ? (*elem_size - 1 - k) : k;
+
+        perm[host] = order[k];
+    }
+
+    for(int j = 0; j < *elem_size; j++) {
+        if(perm[j] != j) { identity = 0; }
+        if(perm[j] != *elem_size - 1 - j) { reverse = 0; }
+    }
+
+    return identity ? ARRAY_PERM_IDENTITY : (reverse ? ARRAY_PERM_REVERSE : ARRAY_PERM_OTHER);
+}
+
+
+/*
+ * Byte swap kernel for the reversed orders.
+ *
+ * x86 uses PSHUFB when the CPU has SSSE3, checked once at run time so the
+ * default build gets it too, and SSE2 shifts and word shuffles otherwise. ARM
+ * uses the NEON byte reversal. The tail, and other CPUs, use the compiler's
+ * byte swap builtins, which become single bswap/rev instructions.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    include <emmintrin.h>
+#    include <tmmintrin.h>
+#    define ARRAY_SWAP_X86 (1)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    include <arm_neon.h>
+#    define ARRAY_SWAP_NEON (1)
+#endif
+
+#if defined(_MSC_VER)
+#    define ARRAY_BSWAP16(w) _byteswap_ushort(w)
+#    define ARRAY_BSWAP32(w) _byteswap_ulong(w)
+#    define ARRAY_BSWAP64(w) _byteswap_uint64(w)
+#elif defined(__GNUC__)
+#    define ARRAY_BSWAP16(w) __builtin_bswap16(w)
+#    define ARRAY_BSWAP32(w) __builtin_bswap32(w)
+#    define ARRAY_BSWAP64(w) __builtin_bswap64(w)
+#else
+#    define ARRAY_BSWAP16(w) ((uint16_t)(((w) << 8) | ((w) >> 8)))
+#    define ARRAY_BSWAP32(w)                                                                                         \
+        ((((w) & 0x000000FFu) << 24) | (((w) & 0x0000FF00u) << 8) | (((w) & 0x00FF0000u) >> 8) | (((w) >> 24) & 0xFFu))
+#    define ARRAY_BSWAP64(w) (((uint64_t)ARRAY_BSWAP32((uint32_t)(w)) << 32) | (uint64_t)ARRAY_BSWAP32((uint32_t)((w) >> 32)))
+#endif
+
+
+/* whole elements from byte done on, unaligned loads and stores through fixed size copies. */
+static void array_swap_bytes_scalar(uint8_t *restrict dst, const uint8_t *restrict src, int elem_size, int done, int bytes) {
+    switch(elem_size) {
+        case 2:
+            for(int i = done; i < bytes; i += 2) {
+                uint16_t w;
+                memcpy(&w, src + i, sizeof(w));
+                w = ARRAY_BSWAP16(w);
+                memcpy(dst + i, &w, sizeof(w));
+            }
+            break;
+
+        case 4:
+            for(int i = done; i < bytes; i += 4) {
+                uint32_t w;
+                memcpy(&w, src + i, sizeof(w));
+                w = ARRAY_BSWAP32(w);
+                memcpy(dst + i, &w, sizeof(w));
+            }
+            break;
+
+        case 8:
+            for(int i = done; i < bytes; i += 8) {
+                uint64_t w;
+                memcpy(&w, src + i, sizeof(w));
+                w = ARRAY_BSWAP64(w);
+                memcpy(dst + i, &w, sizeof(w));
+            }
+            break;
+
+        default: break;
+    }
+}
+
+
+#if defined(ARRAY_SWAP_X86)
+__attribute__((target("ssse3"))) static int array_swap_bytes_ssse3(uint8_t *restrict dst, const uint8_t *restrict src,
+                                                                    int elem_size, int bytes) {
+    const __m128i mask = elem_size == 2 ? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+                         : elem_size == 4 ? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+                                          : _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    int done = 0;
+
+    for(; done + 16 <= bytes; done += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + done));
+        _mm_storeu_si128((__m128i *)(dst + done), _mm_shuffle_epi8(v, mask));
+    }
+
+    return done;
+}
+
+
+#    if defined(__SSE2__)
+/* no byte shuffle: swap the bytes of each 16 bit word, then reorder the words. */
+static int array_swap_bytes_sse2(uint8_t *restrict dst, const uint8_t *restrict src, int elem_size, int bytes) {
+    int done = 0;
+
+    for(; done + 16 <= bytes; done += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + done));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        if(elem_size == 4) {
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        } else if(elem_size == 8) {
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        _mm_storeu_si128((__m128i *)(dst + done), v);
+    }
+
+    return done;
+}
+#    endif
+#endif
+
+
+/* reverses the bytes of each element, dst and src must not overlap. */
+static void array_swap_bytes(uint8_t *restrict dst, const uint8_t *restrict src, int elem_size, int count) {
+    int bytes = elem_size * count;
+    int done = 0;
+
+#if defined(ARRAY_SWAP_X86)
+    static int have_ssse3 = -1;
+
+    if(have_ssse3 < 0) { have_ssse3 = __builtin_cpu_supports("ssse3") ? 1 : 0; }
+
+#    if defined(__SSE2__)
+    done = have_ssse3 ? array_swap_bytes_ssse3(dst, src, elem_size, bytes) : array_swap_bytes_sse2(dst, src, elem_size, bytes);
+#    else
+    if(have_ssse3) { done = array_swap_bytes_ssse3(dst, src, elem_size, bytes); }
+#    endif
+#elif defined(ARRAY_SWAP_NEON)
+    for(; done + 16 <= bytes; done += 16) {
+        uint8x16_t v = vld1q_u8(src + done);
+        v = elem_size == 2 ? vrev16q_u8(v) : (elem_size == 4 ? vrev32q_u8(v) : vrev64q_u8(v));
+        vst1q_u8(dst + done, v);
+    }
+#endif
+
+    array_swap_bytes_scalar(dst, src, elem_size, done, bytes);
+}
+
+
+static int plc_tag_get_array_impl(int32_t id, int offset, void *values, int count, array_elem_t elem) {
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_p tag = NULL;
+    uint8_t *dst = (uint8_t *)values;
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    if(!values) {
+        pdebug(DEBUG_WARN, "Values pointer is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    if(count <= 0) {
+        pdebug(DEBUG_WARN, "The element count must be positive.");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    tag = lookup_tag(id);
+    if(!tag) {
+        pdebug(DEBUG_WARN, "Tag not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(tag->api_mutex) {
+        int perm[8] = {0};
+        int elem_size = 1;
+        array_perm_t kind = ARRAY_PERM_IDENTITY;
+        const uint8_t *src = NULL;
+
+        if(!tag->data) {
+            pdebug(DEBUG_WARN, "Tag has no data!");
+            tag->status = PLCTAG_ERR_NO_DATA;
+            rc = PLCTAG_ERR_NO_DATA;
+            break;
+        }
+
+        if(tag->is_bit) {
+            pdebug(DEBUG_WARN, "Trying to read an array of values from a tag bit.");
+            tag->status = PLCTAG_ERR_UNSUPPORTED;
+            rc = PLCTAG_ERR_UNSUPPORTED;
+            break;
+        }
+
+        kind = array_elem_perm(tag, elem, &elem_size, perm);
+
+        if(offset < 0 || ((int64_t)offset + ((int64_t)elem_size * (int64_t)count)) > (int64_t)tag->size) {
+            pdebug(DEBUG_WARN, "Data offset out of bounds!");
+            tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
+            rc = PLCTAG_ERR_OUT_OF_BOUNDS;
+            break;
+        }
+
+        src = tag->data + offset;
+
+        if(kind == ARRAY_PERM_IDENTITY) {
+            mem_copy(dst, (void *)src, elem_size * count);
+        } else if(kind == ARRAY_PERM_REVERSE) {
+            array_swap_bytes(dst, src, elem_size, count);
+        } else {
+            for(int i = 0; i < elem_size * count; i += elem_size) {
+                for(int j = 0; j < elem_size; j++) { dst[i + j] = src[i + perm[j]]; }
+            }
+        }
+
+        tag->status = PLCTAG_STATUS_OK;
+    }
+
+    pdebug(DEBUG_DETAIL, "rc_dec: Releasing reference to tag %" PRId32 ".", tag->tag_id);
+    rc_dec(tag);
+
+    return rc;
+}
+
+
+static int plc_tag_set_array_impl(int32_t id, int offset, const void *values, int count, array_elem_t elem) {
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_p tag = NULL;
+    const uint8_t *src = (const uint8_t *)values;
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    if(!values) {
+        pdebug(DEBUG_WARN, "Values pointer is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    if(count <= 0) {
+        pdebug(DEBUG_WARN, "The element count must be positive.");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    tag = lookup_tag(id);
+    if(!tag) {
+        pdebug(DEBUG_WARN, "Tag not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    critical_block(tag->api_mutex) {
+        int perm[8] = {0};
+        int elem_size = 1;
+        array_perm_t kind = ARRAY_PERM_IDENTITY;
+        uint8_t *dst = NULL;
+
+        if(!tag->data) {
+            pdebug(DEBUG_WARN, "Tag has no data!");
+            tag->status = PLCTAG_ERR_NO_DATA;
+            rc = PLCTAG_ERR_NO_DATA;
+            break;
+        }
+
+        if(tag->is_bit) {
+            pdebug(DEBUG_WARN, "Trying to write an array of values to a tag bit.");
+            tag->status = PLCTAG_ERR_UNSUPPORTED;
+            rc = PLCTAG_ERR_UNSUPPORTED;
+            break;
+        }
+
+        kind = array_elem_perm(tag, elem, &elem_size, perm);
+
+        if(offset < 0 || ((int64_t)offset + ((int64_t)elem_size * (int64_t)count)) > (int64_t)tag->size) {
+            pdebug(DEBUG_WARN, "Data offset out of bounds!");
+            tag->status = PLCTAG_ERR_OUT_OF_BOUNDS;
+            rc = PLCTAG_ERR_OUT_OF_BOUNDS;
+            break;
+        }
+
+        if(tag->auto_sync_write_ms > 0) { tag_set_dirty_unsafe(tag); }
+
+        dst = tag->data + offset;
+
+        if(kind == ARRAY_PERM_IDENTITY) {
+            mem_copy(dst, (void *)src, elem_size * count);
+        } else if(kind == ARRAY_PERM_REVERSE) {
+            array_swap_bytes(dst, src, elem_size, count);
+        } else {
+            for(int i = 0; i < elem_size * count; i += elem_size) {
+                for(int j = 0; j < elem_size; j++) { dst[i + perm[j]] = src[i + j]; }
+            }
+        }
+
+        tag->status = PLCTAG_STATUS_OK;
+    }
+
+    pdebug(DEBUG_DETAIL, "rc_dec: Releasing reference to tag %" PRId32 ".", tag->tag_id);
+    rc_dec(tag);
+
+    return rc;
+}
+
+
+LIB_EXPORT int plc_tag_get_uint64_array(int32_t id, int offset, uint64_t *values, int count) {
+    return plc_tag_get_array_impl(id, offset, values, count, ARRAY_ELEM_INT64);
+}
+
+LIB_EXPORT int plc_tag_set_uint64_array(int32_t id, int offset, const uint64_t *values, int count) {
+    return plc_tag_set_array_impl(id, offset, values, count, ARRAY_ELEM_INT64);
+}
+
+LIB_EXPORT int plc_tag_get_int64_array(int32_t id, int offset, int64_t *values, int count) {
+    return plc_tag_get_array_impl(id, offset, values, count, ARRAY_ELEM_INT64);
+}
+
+LIB_EXPORT int plc_tag_set_int64_array(int32_t id, int offset, const int64_t *values, int count) {
+    return plc_tag_set_array_impl(id, offset, values, count, ARRAY_ELEM_INT64);
+}
+
+LIB_EXPORT int plc_tag_get_uint32_array(int32_t id, int offset, uint32_t *values, int count) {
+    return plc_tag_get_array_impl(id, offset, values, count, ARRAY_ELEM_INT32);
+}
+
+LIB_EXPORT int plc_tag_set_uint32_array(int32_t id, int offset, const uint32_t *values, int count) {
+    return plc_tag_set_array_impl(id, offset, values, count, ARRAY_ELEM_INT32);
+}
+
+LIB_EXPORT int plc_tag_get_int32_array(int32_t id, int offset, int32_t *values, int count) {
+    return plc_tag_get_array_impl(id, offset, values, count, ARRAY_ELEM_INT32);
+}
+
+LIB_EXPORT int plc_tag_set_int32_array(int32_t id, int offset, const int32_t *values, int count) {
+    return plc_tag_set_array_impl(id, offset, values, count, ARRAY_ELEM_INT32);
+}
+
+LIB_EXPORT int plc_tag_get_uint16_array(int32_t id, int offset, uint16_t *values, int count) {
+    return plc_tag_get_array_impl(id, offset, values, count, ARRAY_ELEM_INT16);
+}
+
+LIB_EXPORT int plc_tag_set_uint16_array(int32_t id, int offset, const uint16_t *values, int count) {
+    return plc_tag_set_array_impl(id, offset, values, count, ARRAY_ELEM_INT16);
+}
+
+LIB_EXPORT int plc_tag_get_int16_array(int32_t id, int offset, int16_t *values, int count) {
+    return plc_tag_get_array_impl(id, offset, values, count, ARRAY_ELEM_INT16);
+}
+
+LIB_EXPORT int plc_tag_set_int16_array(int32_t id, int offset, const int16_t *values, int count) {
+    return plc_tag_set_array_impl(id, offset, values, count, ARRAY_ELEM_INT16);
+}
+
+LIB_EXPORT int plc_tag_get_uint8_array(int32_t id, int offset, uint8_t *values, int count) {
+    return plc_tag_get_array_impl(id, offset, values, count, ARRAY_ELEM_8);
+}
+
+LIB_EXPORT int plc_tag_set_uint8_array(int32_t id, int offset, const uint8_t *values, int count) {
+    return plc_tag_set_array_impl(id, offset, values, count, ARRAY_ELEM_8);
+}
+
+LIB_EXPORT int plc_tag_get_int8_array(int32_t id, int offset, int8_t *values, int count) {
+    return plc_tag_get_array_impl(id, offset, values, count, ARRAY_ELEM_8);
+}
+
+LIB_EXPORT int plc_tag_set_int8_array(int32_t id, int offset, const int8_t *values, int count) {
+    return plc_tag_set_array_impl(id, offset, values, count, ARRAY_ELEM_8);
+}
+
+LIB_EXPORT int plc_tag_get_float64_array(int32_t id, int offset, double *values, int count) {
+    return plc_tag_get_array_impl(id, offset, values, count, ARRAY_ELEM_FLOAT64);
+}
+
+LIB_EXPORT int plc_tag_set_float64_array(int32_t id, int offset, const double *values, int count) {
+    return plc_tag_set_array_impl(id, offset, values, count, ARRAY_ELEM_FLOAT64);
+}
+
+LIB_EXPORT int plc_tag_get_float32_array(int32_t id, int offset, float *values, int count) {
+    return plc_tag_get_array_impl(id, offset, values, count, ARRAY_ELEM_FLOAT32);
+}
+
+LIB_EXPORT int plc_tag_set_float32_array(int32_t id, int offset, const float *values, int count) {
+    return plc_tag_set_array_impl(id, offset, values, count, ARRAY_ELEM_FLOAT32);
+}
+
+
+/*
+ * Borrowed data.
+ *
+ * plc_tag_borrow_data() hands out the tag's data buffer itself, so a caller
+ * that serializes whole tags does not copy it first. The borrow holds a tag
+ * reference and the tag API mutex until plc_tag_release_data() on the same
+ * thread: the tickler and every other thread leave the tag alone and the data
+ * cannot change under the caller. Reads and writes of the tag from the
+ * borrowing thread fail with PLCTAG_ERR_BUSY until the release.
+ *
+ * The borrows live in a small per-thread list, so a release finds its tag even
+ * after the tag was destroyed and a release from another thread is refused.
+ *
+ * Builds without NDEBUG hand out a copy of the data instead. The release checks
+ * that the copy was not written to, poisons it and frees it, so a use after
+ * release reads garbage or trips a memory checker.
+ */
+
+#define MAX_BORROWED_TAGS (8)
+#define BORROW_POISON_BYTE (0xDD)
+
+struct borrowed_data_t {
+    plc_tag_p tag;
+    uint8_t *shadow;
+};
+
+static THREAD_LOCAL struct borrowed_data_t borrowed_data[MAX_BORROWED_TAGS];
+static THREAD_LOCAL int borrowed_data_count = 0;
+
+
+LIB_EXPORT int plc_tag_borrow_data(int32_t id, const uint8_t **data, int *size) {
+    int rc = PLCTAG_STATUS_OK;
+    plc_tag_p tag = NULL;
+    uint8_t *shadow = NULL;
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    if(!data || !size) {
+        pdebug(DEBUG_WARN, "Data or size pointer is null!");
+        return PLCTAG_ERR_NULL_PTR;
+    }
+
+    *data = NULL;
+    *size = 0;
+
+    if(borrowed_data_count >= MAX_BORROWED_TAGS) {
+        pdebug(DEBUG_WARN, "This thread already borrows the data of %d tags!", MAX_BORROWED_TAGS);
+        return PLCTAG_ERR_NO_RESOURCES;
+    }
+
+    tag = lookup_tag(id);
+    if(!tag) {
+        pdebug(DEBUG_WARN, "Tag not found.");
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    rc = mutex_lock(tag->api_mutex);
+    if(rc != PLCTAG_STATUS_OK) {
+        pdebug(DEBUG_WARN, "Unable to lock the tag API mutex, error %s!", plc_tag_decode_error(rc));
+        rc_dec(tag);
+        return rc;
+    }
+
+    do {
+        /* the mutex is recursive, this thread may already hold the borrow. */
+        if(tag->data_borrowed) {
+            pdebug(DEBUG_WARN, "Tag data is already borrowed!");
+            rc = PLCTAG_ERR_BUSY;
+            break;
+        }
+
+        if(!tag->data || tag->size <= 0) {
+            pdebug(DEBUG_WARN, "Tag has no data!");
+            rc = PLCTAG_ERR_NO_DATA;
+            break;
+        }
+
+#ifndef NDEBUG
+        shadow = (uint8_t *)mem_alloc(tag->size);
+        if(!shadow) {
+            pdebug(DEBUG_WARN, "Unable to allocate the debug copy of the data!");
+            rc = PLCTAG_ERR_NO_MEM;
+            break;
+        }
+
+        mem_copy(shadow, tag->data, tag->size);
+#endif
+
+        tag->data_borrowed = 1;
+
+        borrowed_data[borrowed_data_count].tag = tag;
+        borrowed_data[borrowed_data_count].shadow = shadow;
+        borrowed_data_count++;
+
+        *data = shadow ? shadow : tag->data;
+        *size = tag->size;
+    } while(0);
+
+    tag->status = (int8_t)rc;
+
+    if(rc != PLCTAG_STATUS_OK) {
+        mutex_unlock(tag->api_mutex);
+        pdebug(DEBUG_DETAIL, "rc_dec: Releasing reference to tag %" PRId32 ".", tag->tag_id);
+        rc_dec(tag);
+    }
+
+    pdebug(DEBUG_SPEW, "Done.");
+
+    return rc;
+}
+
+
+LIB_EXPORT int plc_tag_release_data(int32_t id) {
+    plc_tag_p tag = NULL;
+    uint8_t *shadow = NULL;
+    int index = -1;
+
+    pdebug(DEBUG_SPEW, "Starting.");
+
+    for(int i = borrowed_data_count - 1; i >= 0; i--) {
+        if(borrowed_data[i].tag->tag_id == id) {
+            index = i;
+            break;
+        }
+    }
+
+    if(index < 0) {
+        pdebug(DEBUG_WARN, "Tag %" PRId32 " has no data borrowed by this thread!", id);
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    tag = borrowed_data[index].tag;
+    shadow = borrowed_data[index].shadow;
+
+    for(int i = index + 1; i < borrowed_data_count; i++) { borrowed_data[i - 1] = borrowed_data[i]; }
+
+    borrowed_data_count--;
+
+    if(shadow) {
+        if(tag->data && mem_cmp(shadow, tag->size, tag->data, tag->size) != 0) {
+            pdebug(DEBUG_ERROR, "Borrowed data of tag %" PRId32 " was written to, it is read only!", id);
+        }
+
+        mem_set(shadow, BORROW_POISON_BYTE, tag->size);
+        mem_free(shadow);
+    }
+
+    tag->data_borrowed = 0;
+
+    mutex_unlock(tag->api_mutex);
+
+    pdebug(DEBUG_DETAIL, "rc_dec: Releasing reference to tag %" PRId32 ".", tag->tag_id);
+    rc_dec(tag);
+
+    pdebug(DEBUG_SPEW, "Done.");
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+/*****************************************************************************************************
+ *****************************  Support routines for extra indirection *******************************
+ ****************************************************************************************************/
+
+int set_tag_byte_order(plc_tag_p tag, attr attribs)
+
+{
     int use_default = 1;
 
     pdebug(DEBUG_INFO, "Starting.");
@@ -4264,27 +5327,37 @@ int check_byte_order_str(const char *byte_order, int length) {
 
 plc_tag_p lookup_tag(int32_t tag_id) {
     plc_tag_p tag = NULL;
+    tag_lookup_table_p table = NULL;
+    atomic_int32_t *readers = NULL;
 
-    critical_block(tag_lookup_mutex) {
-        tag = hashtable_get(tags, (int64_t)tag_id);
+    readers = &tag_lookup_readers[atomic_get_int32(&tag_lookup_epoch) & 1][(uint32_t)tag_id % TAG_LOOKUP_READER_SHARDS].count;
 
-        if(tag) {
-            debug_set_tag_id(tag->tag_id);
-        } else {
-            /* TODO - remove this. */
-            pdebug(DEBUG_WARN, "Tag with ID %d not found.", tag_id);
-        }
+    /* nothing we load here is freed until we count ourselves out. */
+    atomic_add_int32(readers, 1);
+
+    table = atomic_get_ptr(&tag_lookup_table);
+    if(table) {
+        tag = atomic_get_ptr(&table->slots[(uint32_t)tag_id & (uint32_t)(table->capacity - 1)]);
 
         if(tag && tag->tag_id == tag_id) {
-            pdebug(DEBUG_SPEW, "Found tag %p with id %d.", tag, tag->tag_id);
             pdebug(DEBUG_DETAIL, "rc_inc: Acquiring reference to tag %" PRId32 ".", tag->tag_id);
             tag = rc_inc(tag);
         } else {
-            debug_set_tag_id(0);
             tag = NULL;
         }
     }
 
+    atomic_add_int32(readers, -1);
+
+    if(tag) {
+        debug_set_tag_id(tag->tag_id);
+        pdebug(DEBUG_SPEW, "Found tag %p with id %d.", tag, tag->tag_id);
+    } else {
+        /* TODO - remove this. */
+        pdebug(DEBUG_WARN, "Tag with ID %d not found.", tag_id);
+        debug_set_tag_id(0);
+    }
+
     return tag;
 }
 
@@ -4304,6 +5377,44 @@ int tag_id_inc(int id) {
 }
 
 
+tag_lookup_table_p tag_lookup_table_create(int capacity) {
+    tag_lookup_table_p table = mem_alloc((int)(sizeof(*table) + ((size_t)capacity * sizeof(atomic_ptr_t))));
+
+    if(!table) {
+        pdebug(DEBUG_ERROR, "Unable to allocate tag lookup table of %d entries!", capacity);
+        return NULL;
+    }
+
+    table->capacity = capacity;
+
+    for(int i = 0; i < capacity; i++) { atomic_init_ptr(&table->slots[i], NULL); }
+
+    return table;
+}
+
+
+/* tag_lookup_mutex held: the tag in the slot of this ID, which might be another generation. */
+plc_tag_p tag_lookup_slot_unsafe(int32_t id) {
+    tag_lookup_table_p table = atomic_get_ptr(&tag_lookup_table);
+
+    if(!table) { return NULL; }
+
+    return atomic_get_ptr(&table->slots[(uint32_t)id & (uint32_t)(table->capacity - 1)]);
+}
+
+
+/* tag_lookup_mutex held: returns once no reader can still hold a pointer it loaded before. */
+void wait_for_tag_readers(void) {
+    for(int round = 0; round < 2; round++) {
+        int old_set = atomic_add_int32(&tag_lookup_epoch, 1) & 1;
+
+        for(int shard = 0; shard < TAG_LOOKUP_READER_SHARDS; shard++) {
+            while(atomic_get_int32(&tag_lookup_readers[old_set][shard].count) > 0) { sleep_ms(0); }
+        }
+    }
+}
+
+
 int add_tag_lookup(plc_tag_p tag) {
     int rc = PLCTAG_ERR_NOT_FOUND;
     int new_id = 0;
@@ -4311,8 +5422,34 @@ int add_tag_lookup(plc_tag_p tag) {
     pdebug(DEBUG_DETAIL, "Starting.");
 
     critical_block(tag_lookup_mutex) {
+        tag_lookup_table_p table = atomic_get_ptr(&tag_lookup_table);
         int attempts = 0;
 
+        /* keep the table at most half full so that a free slot is never far away. */
+        if((table->count + 1) * 2 > table->capacity) {
+            tag_lookup_table_p bigger = tag_lookup_table_create(table->capacity * 2);
+
+            if(!bigger) {
+                rc = PLCTAG_ERR_NO_MEM;
+                break;
+            }
+
+            for(int i = 0; i < table->capacity; i++) {
+                plc_tag_p entry = atomic_get_ptr(&table->slots[i]);
+
+                if(entry) { atomic_set_ptr(&bigger->slots[(uint32_t)entry->tag_id & (uint32_t)(bigger->capacity - 1)], entry); }
+            }
+
+            bigger->count = table->count;
+
+            pdebug(DEBUG_DETAIL, "Growing tag lookup table to %d entries.", bigger->capacity);
+
+            atomic_set_ptr(&tag_lookup_table, bigger);
+            wait_for_tag_readers();
+            mem_free(table);
+            table = bigger;
+        }
+
         /* only get this when we hold the mutex. */
         new_id = next_tag_id;
 
@@ -4321,22 +5458,26 @@ int add_tag_lookup(plc_tag_p tag) {
 
             if(new_id <= 0) {
                 pdebug(DEBUG_WARN, "ID %d is illegal!", new_id);
-                attempts = MAX_TAG_MAP_ATTEMPTS;
+                attempts = table->capacity;
                 break;
             }
 
             pdebug(DEBUG_SPEW, "Trying new ID %d.", new_id);
 
-            if(!hashtable_get(tags, (int64_t)new_id)) {
+            if(!atomic_get_ptr(&table->slots[(uint32_t)new_id & (uint32_t)(table->capacity - 1)])) {
                 pdebug(DEBUG_DETAIL, "Found unused ID %d", new_id);
                 break;
             }
 
             attempts++;
-        } while(attempts < MAX_TAG_MAP_ATTEMPTS);
+        } while(attempts < table->capacity);
 
-        if(attempts < MAX_TAG_MAP_ATTEMPTS) {
-            rc = hashtable_put(tags, (int64_t)new_id, tag);
+        if(attempts < table->capacity) {
+            /* readers check the ID, it has to be there before the tag is. */
+            tag->tag_id = new_id;
+            atomic_set_ptr(&table->slots[(uint32_t)new_id & (uint32_t)(table->capacity - 1)], tag);
+            table->count++;
+            rc = PLCTAG_STATUS_OK;
         } else {
             rc = PLCTAG_ERR_NO_RESOURCES;
         }
@@ -4352,6 +5493,51 @@ int add_tag_lookup(plc_tag_p tag) {
 }
 
 
+/* the table's reference to the tag goes to the caller, no reader can find the tag any more. */
+plc_tag_p remove_tag_lookup(int32_t id) {
+    plc_tag_p tag = NULL;
+
+    remove_tag_lookups(&id, 1, &tag);
+
+    return tag;
+}
+
+
+/*
+ * Many at once: one pass under the lookup mutex and one wait for the readers.
+ * tags[i] gets the table's reference for ids[i], or NULL if it was not found.
+ * Returns how many were removed.
+ */
+int remove_tag_lookups(const int32_t *ids, int count, plc_tag_p *tags) {
+    int removed = 0;
+
+    for(int i = 0; i < count; i++) { tags[i] = NULL; }
+
+    critical_block(tag_lookup_mutex) {
+        tag_lookup_table_p table = atomic_get_ptr(&tag_lookup_table);
+
+        if(!table) { break; }
+
+        for(int i = 0; i < count; i++) {
+            int slot = (int)((uint32_t)ids[i] & (uint32_t)(table->capacity - 1));
+            plc_tag_p tag = atomic_get_ptr(&table->slots[slot]);
+
+            if(!tag || tag->tag_id != ids[i]) { continue; }
+
+            atomic_set_ptr(&table->slots[slot], NULL);
+            table->count--;
+
+            tags[i] = tag;
+            removed++;
+        }
+
+        if(removed > 0) { wait_for_tag_readers(); }
+    }
+
+    return removed;
+}
+
+
 /**
  * @brief Get the total length of the string currently in the tag.
  *
@@ -409,6 +409,16 @@ LIB_EXPORT int plc_tag_abort(int32_t tag);
 LIB_EXPORT int plc_tag_destroy(int32_t tag);
 
 
+/*
+ * plc_tag_destroy_many
+ *
+ * plc_tag_destroy() for count tags with one pass over the tag lookup table.
+ * Unknown IDs are skipped and make the call return PLCTAG_ERR_NOT_FOUND, the
+ * other tags are destroyed either way.
+ */
+LIB_EXPORT int plc_tag_destroy_many(const int32_t *tags, int count);
+
+
 
 
 
@@ -515,6 +525,43 @@ LIB_EXPORT int plc_tag_set_float32(int32_t tag, int offset, float val);
 LIB_EXPORT int plc_tag_set_raw_bytes(int32_t id, int offset, uint8_t *buffer, int buffer_length);
 LIB_EXPORT int plc_tag_get_raw_bytes(int32_t id, int offset, uint8_t *buffer, int buffer_length);
 
+/*
+ * typed array bulk access: count packed elements from offset, converted with the
+ * tag's byte order, under one lock. Returns PLCTAG_STATUS_OK or an error.
+ */
+LIB_EXPORT int plc_tag_get_uint64_array(int32_t tag, int offset, uint64_t *values, int count);
+LIB_EXPORT int plc_tag_set_uint64_array(int32_t tag, int offset, const uint64_t *values, int count);
+LIB_EXPORT int plc_tag_get_int64_array(int32_t tag, int offset, int64_t *values, int count);
+LIB_EXPORT int plc_tag_set_int64_array(int32_t tag, int offset, const int64_t *values, int count);
+
+LIB_EXPORT int plc_tag_get_uint32_array(int32_t tag, int offset, uint32_t *values, int count);
+LIB_EXPORT int plc_tag_set_uint32_array(int32_t tag, int offset, const uint32_t *values, int count);
+LIB_EXPORT int plc_tag_get_int32_array(int32_t tag, int offset, int32_t *values, int count);
+LIB_EXPORT int plc_tag_set_int32_array(int32_t tag, int offset, const int32_t *values, int count);
+
+LIB_EXPORT int plc_tag_get_uint16_array(int32_t tag, int offset, uint16_t *values, int count);
+LIB_EXPORT int plc_tag_set_uint16_array(int32_t tag, int offset, const uint16_t *values, int count);
+LIB_EXPORT int plc_tag_get_int16_array(int32_t tag, int offset, int16_t *values, int count);
+LIB_EXPORT int plc_tag_set_int16_array(int32_t tag, int offset, const int16_t *values, int count);
+
+LIB_EXPORT int plc_tag_get_uint8_array(int32_t tag, int offset, uint8_t *values, int count);
+LIB_EXPORT int plc_tag_set_uint8_array(int32_t tag, int offset, const uint8_t *values, int count);
+LIB_EXPORT int plc_tag_get_int8_array(int32_t tag, int offset, int8_t *values, int count);
+LIB_EXPORT int plc_tag_set_int8_array(int32_t tag, int offset, const int8_t *values, int count);
+
+LIB_EXPORT int plc_tag_get_float64_array(int32_t tag, int offset, double *values, int count);
+LIB_EXPORT int plc_tag_set_float64_array(int32_t tag, int offset, const double *values, int count);
+LIB_EXPORT int plc_tag_get_float32_array(int32_t tag, int offset, float *values, int count);
+LIB_EXPORT int plc_tag_set_float32_array(int32_t tag, int offset, const float *values, int count);
+
+/*
+ * borrowed data: read only access to the whole tag buffer without a copy. The
+ * tag is locked until plc_tag_release_data() is called from the same thread;
+ * keep the borrow short and do not read or write the tag meanwhile.
+ */
+LIB_EXPORT int plc_tag_borrow_data(int32_t tag, const uint8_t **data, int *size);
+LIB_EXPORT int plc_tag_release_data(int32_t tag);
+
 /* string accessors */
 
 LIB_EXPORT int plc_tag_get_string(int32_t tag_id, int string_start_offset, char *buffer, int buffer_length);
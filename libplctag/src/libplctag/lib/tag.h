@@ -115,11 +115,14 @@ typedef void (*tag_extended_callback_func)(int32_t tag_id, int event, int status
     int64_t auto_sync_next_write;            \
     int64_t read_cache_expire;               \
     int64_t read_cache_ms;                   \
+    int64_t tickle_due;                      \
     uint8_t *data;                           \
     tag_byte_order_t *byte_order;            \
     cond_p tag_cond_wait;                    \
     mutex_p api_mutex;                       \
     mutex_p ext_mutex;                       \
+    struct plc_tag_t *tickle_next;           \
+    struct plc_tag_t *tickle_prev;           \
     tag_extended_callback_func callback;     \
     tag_vtable_p vtable;                     \
     void *userdata;                          \
@@ -128,6 +131,7 @@ typedef void (*tag_extended_callback_func)(int32_t tag_id, int event, int status
     int32_t size;                            \
     int32_t tag_id;                          \
     int connection_group_id;                 \
+    int tickle_wheel_slot;                   \
     int bit;                                 \
     atomic_bool abort_requested;             \
     int8_t event_creation_complete_status;   \
@@ -138,7 +142,10 @@ typedef void (*tag_extended_callback_func)(int32_t tag_id, int event, int status
     int8_t event_write_complete_status;      \
     int8_t event_write_started_status;       \
     int8_t status;                           \
+    uint8_t tickle_queued;                   \
     uint8_t allow_field_resize : 1;          \
+    uint8_t auto_sync_read_spread : 1;       \
+    uint8_t data_borrowed : 1;               \
     uint8_t event_creation_complete : 1;     \
     uint8_t event_deletion_started : 1;      \
     uint8_t event_operation_aborted : 1;     \
@@ -177,6 +184,7 @@ extern int plc_tag_generic_raise_event_impl(const char *func, int line_num, plc_
 extern void plc_tag_generic_handle_event_callbacks(plc_tag_p tag);
 #define plc_tag_tickler_wake() plc_tag_tickler_wake_impl(__func__, __LINE__)
 extern int plc_tag_tickler_wake_impl(const char *func, int line_num);
+extern void plc_tag_tickler_ready(plc_tag_p tag);
 #define plc_tag_generic_wake_tag(tag) plc_tag_generic_wake_tag_impl(__func__, __LINE__, tag)
 extern int plc_tag_generic_wake_tag_impl(const char *func, int line_num, plc_tag_p tag);
 extern int plc_tag_generic_init_tag(plc_tag_p tag, attr attributes,
@@ -269,4 +277,7 @@ static inline void tag_raise_event(plc_tag_p tag, int event, int8_t status) {
 
         default: pdebug(DEBUG_WARN, "Unsupported event %d!"); break;
     }
+
+    /* the tickler delivers the callbacks. */
+    plc_tag_tickler_ready(tag);
 }
@@ -126,6 +126,18 @@ int64_t atomic_compare_and_set_int64(atomic_int64_t *a, int64_t old_val, int64_t
 #    endif
 }
 
+void atomic_init_ptr(atomic_ptr_t *a, void *new_val) { *a = new_val; }
+
+void *atomic_get_ptr(atomic_ptr_t *a) { return *a; }
+
+void *atomic_set_ptr(atomic_ptr_t *a, void *new_val) {
+#    ifdef _WIN32
+    return InterlockedExchangePointer((PVOID volatile *)a, new_val);
+#    else
+    return __atomic_exchange_n(a, new_val, __ATOMIC_SEQ_CST);
+#    endif
+}
+
 #else
 
 #    include <stdatomic.h>
@@ -164,4 +176,10 @@ int64_t atomic_compare_and_set_int64(atomic_int64_t *a, int64_t old_val, int64_t
     return atomic_compare_exchange_strong(a, &old_val, new_val);
 }
 
+void atomic_init_ptr(atomic_ptr_t *a, void *new_val) { atomic_init(a, new_val); }
+
+void *atomic_get_ptr(atomic_ptr_t *a) { return atomic_load(a); }
+
+void *atomic_set_ptr(atomic_ptr_t *a, void *new_val) { return atomic_exchange(a, new_val); }
+
 #endif
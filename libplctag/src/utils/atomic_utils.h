@@ -50,6 +50,7 @@ typedef volatile bool atomic_bool;
 #endif
 typedef volatile int32_t atomic_int32_t;
 typedef volatile int64_t atomic_int64_t;
+typedef void *volatile atomic_ptr_t;
 
 
 #else /* C11 atomics are supported. */
@@ -59,6 +60,7 @@ typedef volatile int64_t atomic_int64_t;
 typedef _Atomic(bool) atomic_bool;
 typedef _Atomic(int32_t) atomic_int32_t;
 typedef _Atomic(int64_t) atomic_int64_t;
+typedef _Atomic(void *) atomic_ptr_t;
 
 #endif
 
@@ -78,3 +80,7 @@ extern int64_t atomic_get_int64(atomic_int64_t *a);
 extern int64_t atomic_set_int64(atomic_int64_t *a, int64_t new_val);
 extern int64_t atomic_add_int64(atomic_int64_t *a, int64_t other);
 extern int64_t atomic_compare_and_set_int64(atomic_int64_t *a, int64_t old_val, int64_t new_val);
+
+extern void atomic_init_ptr(atomic_ptr_t *a, void *new_val);
+extern void *atomic_get_ptr(atomic_ptr_t *a);
+extern void *atomic_set_ptr(atomic_ptr_t *a, void *new_val);
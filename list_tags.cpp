@@ -40,10 +40,15 @@
 #include <stdlib.h>
 #include <string.h>
 
-//#include <string>
+#include <string>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 #include "list_tags.h"
+#include "tag_catalog.h"
+#include "tag_table.h"
 
 
 #define REQUIRED_VERSION 2, 4, 0
@@ -104,10 +109,14 @@ static void usage(void);
 static char *setup_tag_string(int argc, const char **argv);
 static int open_tag(char *base, char *tag_name);
 static int get_tag_list(int32_t tag_id, struct tag_entry_s **tag_list, struct tag_entry_s *parent);
+static int process_tag_list(int32_t tag_id, struct tag_entry_s **tag_list, struct tag_entry_s *parent);
+static void read_tags_concurrently(char *base, const std::vector<std::string> &tag_names, std::vector<int32_t> &handles,
+                                   int max_in_flight);
 static void print_element_type(uint16_t element_type);
 static int process_tag_entry(int32_t tag, int *offset, uint16_t *last_tag_id, struct tag_entry_s **tag_list,
                              struct tag_entry_s *parent);
-static int get_udt_definition(char *base, uint16_t udt_id);
+static int process_udt_definition(int32_t udt_info_tag, uint16_t udt_id);
+static void free_listing(struct tag_entry_s *tag_list, char *tag_string_base, int32_t controller_listing_tag);
 
 
 /* a local cache of all found UDT definitions. */
@@ -121,12 +130,29 @@ static int debug_level = PLCTAG_DEBUG_NONE;
 
 
 int list_tags(int argc, const char **argv, std::vector<TagEntry> &tagentries) {
+    std::vector<UdtEntry> udtentries;
+    return list_tags(argc, argv, tagentries, udtentries);
+}
+
+
+int list_tags(int argc, const char **argv, std::vector<TagEntry> &tagentries, std::vector<UdtEntry> &udtentries,
+              bool use_catalog, int max_in_flight) {
+    TagTable tags;
+    int rc = list_tags(argc, argv, tags, udtentries, use_catalog, max_in_flight);
+
+    tags.toEntries(tagentries);
+
+    return rc;
+}
+
+
+int list_tags(int argc, const char **argv, TagTable &tags, std::vector<UdtEntry> &udtentries,
+              bool use_catalog, int max_in_flight) {
     int rc = PLCTAG_STATUS_OK;
     // const char *host = NULL;
     // const char *path = NULL;
     char *tag_string_base = NULL;
     int32_t controller_listing_tag = 0;
-    int32_t program_listing_tag = 0;
     struct tag_entry_s *tag_list = NULL;
     int version_major = plc_tag_get_int_attribute(0, "version_major", 0);
     int version_minor = plc_tag_get_int_attribute(0, "version_minor", 0);
@@ -147,6 +173,8 @@ int list_tags(int argc, const char **argv, std::vector<TagEntry> &tagentries) {
 
     /* clear the UDTs. */
     for(int index = 0; index < MAX_UDTS; index++) { udts[index] = NULL; }
+    last_udt = 0;
+    current_udt = 0;
 
     debug_level = plc_tag_get_int_attribute(0, "debug", PLCTAG_DEBUG_NONE);
 
@@ -184,49 +212,98 @@ int list_tags(int argc, const char **argv, std::vector<TagEntry> &tagentries) {
     }
 
     /*
-     * now loop through the tags and get the list for the program tags.
+     * the controller listing is the cheap part. If it (size and content hash) and the programs
+     * in it are unchanged since the catalog was written, skip the program listings and UDT reads.
+     */
+    uint32_t listing_size = (uint32_t)plc_tag_get_size(controller_listing_tag);
+    uint64_t listing_hash = 0;
+    const uint8_t *listing_data = NULL;
+    int listing_bytes = 0;
+    if(use_catalog && plc_tag_borrow_data(controller_listing_tag, &listing_data, &listing_bytes) == PLCTAG_STATUS_OK) {
+        listing_hash = tagCatalogHash(listing_data, (size_t)listing_bytes);
+        plc_tag_release_data(controller_listing_tag);
+    } else {
+        /* without the hash a catalog cannot be checked */
+        use_catalog = false;
+    }
+    std::vector<std::string> programs;
+    for(struct tag_entry_s *entry = tag_list; entry; entry = entry->next) {
+        if(strncmp(entry->name, "Program:", strlen("Program:")) == 0) { programs.push_back(entry->name); }
+    }
+    std::sort(programs.begin(), programs.end());
+
+    std::string catalog_file = use_catalog ? tagCatalogPath(argv[1], argv[2]) : "";
+    if(use_catalog) {
+        rc = loadTagCatalog(catalog_file, listing_size, listing_hash, programs, tags, udtentries);
+        if(rc == PLCTAG_STATUS_OK) {
+            if(debug_level >= PLCTAG_DEBUG_INFO) {
+                // NOLINTNEXTLINE
+                fprintf(stderr, "Using tag catalog \"%s\".\n", catalog_file.c_str());
+            }
+
+            free_listing(tag_list, tag_string_base, controller_listing_tag);
+            return 0;
+        }
+
+        if(debug_level >= PLCTAG_DEBUG_INFO) {
+            // NOLINTNEXTLINE
+            fprintf(stderr, "Tag catalog \"%s\" not usable, %s. Listing everything.\n", catalog_file.c_str(),
+                    plc_tag_decode_error(rc));
+        }
+    }
+
+    /*
+     * now get the list for the program tags. The listings are read concurrently and then
+     * processed in list order so the result is the same as reading them one at a time.
      *
      * This is safe because we push the new tags on the front of the list and
      * so do not change any existing tag in the list.
      */
+    std::vector<struct tag_entry_s *> program_entries;
+    std::vector<std::string> program_listings;
     for(struct tag_entry_s *entry = tag_list; entry; entry = entry->next) {
         if(strncmp(entry->name, "Program:", strlen("Program:")) == 0) {
-            char buf[256] = {0};
-
             /* this is a program tag, check for its tags. */
             if(debug_level >= PLCTAG_DEBUG_INFO) {
                 // NOLINTNEXTLINE
                 fprintf(stderr, "Getting tags for program \"%s\".\n", entry->name);
             }
 
-            // NOLINTNEXTLINE
-            snprintf(buf, sizeof(buf), "%s.@tags", entry->name);
+            program_entries.push_back(entry);
+            program_listings.push_back(std::string(entry->name) + ".@tags");
+        }
+    }
 
-            program_listing_tag = open_tag(tag_string_base, buf);
-            if(program_listing_tag <= 0) {
-                // NOLINTNEXTLINE
-                fprintf(stderr, "Unable to create listing tag, error %s!\n", plc_tag_decode_error(program_listing_tag));
-                usage();
-            }
+    std::vector<int32_t> program_listing_tags;
+    read_tags_concurrently(tag_string_base, program_listings, program_listing_tags, max_in_flight);
 
-            if(debug_level >= PLCTAG_DEBUG_INFO) {
-                // NOLINTNEXTLINE
-                fprintf(stderr, "Program tag listing tag ID: %d\n", program_listing_tag);
-            }
+    for(size_t index = 0; index < program_entries.size(); index++) {
+        int32_t program_listing_tag = program_listing_tags[index];
 
-            rc = get_tag_list(program_listing_tag, &tag_list, entry);
-            if(rc != PLCTAG_STATUS_OK) {
-                // NOLINTNEXTLINE
-                fprintf(stderr, "Unable to get program tag list or no tags visible in the target PLC, error %s!\n",
-                        plc_tag_decode_error(rc));
-                usage();
-            }
+        if(program_listing_tag < 0) {
+            // NOLINTNEXTLINE
+            fprintf(stderr, "Unable to get program tag list for \"%s\", error %s!\n", program_entries[index]->name,
+                    plc_tag_decode_error(program_listing_tag));
+            usage();
+        }
 
-            plc_tag_destroy(program_listing_tag);
-            if(debug_level >= PLCTAG_DEBUG_INFO) {
-                // NOLINTNEXTLINE
-                fprintf(stderr, "Destroying program tag listing tag ID: %d\n", program_listing_tag);
-            }
+        if(debug_level >= PLCTAG_DEBUG_INFO) {
+            // NOLINTNEXTLINE
+            fprintf(stderr, "Program tag listing tag ID: %d\n", program_listing_tag);
+        }
+
+        rc = process_tag_list(program_listing_tag, &tag_list, program_entries[index]);
+        if(rc != PLCTAG_STATUS_OK) {
+            // NOLINTNEXTLINE
+            fprintf(stderr, "Unable to get program tag list or no tags visible in the target PLC, error %s!\n",
+                    plc_tag_decode_error(rc));
+            usage();
+        }
+
+        plc_tag_destroy(program_listing_tag);
+        if(debug_level >= PLCTAG_DEBUG_INFO) {
+            // NOLINTNEXTLINE
+            fprintf(stderr, "Destroying program tag listing tag ID: %d\n", program_listing_tag);
         }
     }
 
@@ -251,62 +328,96 @@ int list_tags(int argc, const char **argv, std::vector<TagEntry> &tagentries) {
         }
     }
 
-    /* get all the UDTs that we have touched. Note that this can add UDTs to the stack to process! */
-    while(current_udt < last_udt) {
-        uint16_t udt_id = udts_to_process[current_udt];
-
-        /* see if we already have it. */
-        if(udts[udt_id] == NULL) {
+    /*
+     * get all the UDTs that we have touched. Note that this can add UDTs to the stack to process!
+     * Everything queued so far is read as one concurrent wave, then the nested UDTs that wave
+     * found make up the next one.
+     */
+    bool udts_supported = true;
+    while(udts_supported && current_udt < last_udt) {
+        std::vector<uint16_t> wave;
+        std::vector<std::string> wave_names;
+        std::vector<bool> queued(MAX_UDTS, false);
+
+        for(; current_udt < last_udt; current_udt++) {
+            uint16_t udt_id = udts_to_process[current_udt];
+
+            /* see if we already have it. */
+            if(udts[udt_id] != NULL) {
+                if(debug_level >= PLCTAG_DEBUG_INFO) {
+                    // NOLINTNEXTLINE
+                    fprintf(stderr, "Already have UDT (%04x) %s.\n", (unsigned int)udt_id, udts[udt_id]->name);
+                }
+            } else if(!queued[udt_id]) {
+                queued[udt_id] = true;
+                wave.push_back(udt_id);
+                wave_names.push_back("@udt/" + std::to_string(udt_id));
+            }
+        }
 
-            rc = get_udt_definition(tag_string_base, udt_id);
-            if(rc == PLCTAG_ERR_UNSUPPORTED) {
-                // NOLINTNEXTLINE
-                fprintf(stderr, "This kind of PLC does not support UDT introspection.\n");
-                break;
-            } else if(rc != PLCTAG_STATUS_OK) {
-                plc_tag_destroy(controller_listing_tag);
-                // NOLINTNEXTLINE
-                fprintf(stderr, "Unable to get UDT template ID %u, error %s!\n", (unsigned int)(udt_id),
-                        plc_tag_decode_error(rc));
-                usage();
+        std::vector<int32_t> udt_info_tags;
+        read_tags_concurrently(tag_string_base, wave_names, udt_info_tags, max_in_flight);
+
+        for(size_t index = 0; index < wave.size(); index++) {
+            uint16_t udt_id = wave[index];
+            int32_t udt_info_tag = udt_info_tags[index];
+
+            if(udts_supported) {
+                rc = udt_info_tag < 0 ? udt_info_tag : process_udt_definition(udt_info_tag, udt_id);
+                if(rc == PLCTAG_ERR_UNSUPPORTED) {
+                    // NOLINTNEXTLINE
+                    fprintf(stderr, "This kind of PLC does not support UDT introspection.\n");
+                    udts_supported = false;
+                } else if(rc != PLCTAG_STATUS_OK) {
+                    plc_tag_destroy(controller_listing_tag);
+                    // NOLINTNEXTLINE
+                    fprintf(stderr, "Unable to get UDT template ID %u, error %s!\n", (unsigned int)(udt_id),
+                            plc_tag_decode_error(rc));
+                    usage();
+                }
             }
-        } else {
-            if(debug_level >= PLCTAG_DEBUG_INFO) {
-                // NOLINTNEXTLINE
-                fprintf(stderr, "Already have UDT (%04x) %s.\n", (unsigned int)udt_id, udts[udt_id]->name);
+
+            if(udt_info_tag >= 0) {
+                if(debug_level >= PLCTAG_DEBUG_INFO) {
+                    // NOLINTNEXTLINE
+                    fprintf(stderr, "Destroying UDT info tag: %d\n", udt_info_tag);
+                }
+                plc_tag_destroy(udt_info_tag);
             }
         }
-
-        current_udt++;
     }
 
-    //
+    /* straight into the table, the program names are interned there */
+    TagTable listed;
     for(struct tag_entry_s *tag = tag_list; tag; tag = tag->next) {
-        tagentries.push_back( {
-            tag->next ? tag->next->name : "",
-            tag->name,
-            tag->parent ? tag->parent->name : "",
-            tag->instance_id,
-            tag->type,
-            tag->elem_size,
-            tag->elem_count,
-            tag->num_dimensions,
-            tag->dimensions[3],
-        } );
-
-        if(tag->num_dimensions > 3) {
-            int i = 0;
-        }
+        listed.add(tag->name, tag->parent ? tag->parent->name : "", tag->instance_id, tag->type, tag->elem_size,
+                   tag->elem_count, tag->num_dimensions, tag->dimensions);
     }
 
-    // do the same or UDTs?
-    std::vector<udt_entry_s> vudts;
+    // do the same for UDTs
+    size_t first_udt = udtentries.size();
     for(udt_entry_s *udt: udts) {
         if(udt) {
-            vudts.push_back(*udt);
+            UdtEntry u = { udt->name ? udt->name : "", udt->id, udt->struct_handle, udt->instance_size, {} };
+            for(int field_index = 0; field_index < udt->num_fields; field_index++) {
+                struct udt_field_entry_s *field = &(udt->fields[field_index]);
+                u.fields.push_back({ field->name ? field->name : "", field->type, field->metadata, field->offset });
+            }
+            udtentries.push_back(u);
+        }
+    }
+
+    if(use_catalog) {
+        std::vector<UdtEntry> listed_udts(udtentries.begin() + (long)first_udt, udtentries.end());
+
+        rc = saveTagCatalog(catalog_file, listing_size, listing_hash, programs, listed, listed_udts);
+        if(rc != PLCTAG_STATUS_OK && debug_level >= PLCTAG_DEBUG_WARN) {
+            // NOLINTNEXTLINE
+            fprintf(stderr, "Unable to write tag catalog \"%s\", error %s!\n", catalog_file.c_str(), plc_tag_decode_error(rc));
         }
     }
-    int i = 0;
+
+    tags.append(listed);
 
 
     // /* output all the tags. */
@@ -385,6 +496,15 @@ int list_tags(int argc, const char **argv, std::vector<TagEntry> &tagentries) {
     //     }
     // }
 
+    free_listing(tag_list, tag_string_base, controller_listing_tag);
+
+    //printf("SUCCESS!\n");
+
+    return 0;
+}
+
+
+void free_listing(struct tag_entry_s *tag_list, char *tag_string_base, int32_t controller_listing_tag) {
     /* clean up memory */
     while(tag_list) {
         struct tag_entry_s *tag = tag_list;
@@ -422,10 +542,6 @@ int list_tags(int argc, const char **argv, std::vector<TagEntry> &tagentries) {
 
     /* Destroy this at the end to keep the session open. */
     plc_tag_destroy(controller_listing_tag);
-
-    //printf("SUCCESS!\n");
-
-    return 0;
 }
 
 
@@ -501,11 +617,88 @@ int open_tag(char *base, char *tag_name) {
 }
 
 
+/*
+ * Creates and reads base + tag_names[i] for every name, keeping at most max_in_flight tags
+ * outstanding so they share the session and get packed without flooding small controllers.
+ * handles[i] is the read tag (the caller destroys it) or the error that stopped it.
+ */
+void read_tags_concurrently(char *base, const std::vector<std::string> &tag_names, std::vector<int32_t> &handles,
+                            int max_in_flight) {
+    using namespace std::chrono;
+    struct pending_s {
+        size_t index;
+        bool reading;
+        steady_clock::time_point deadline;
+    };
+    std::vector<pending_s> pending;
+    size_t next = 0;
+
+    handles.assign(tag_names.size(), PLCTAG_ERR_NO_DATA);
+    if(max_in_flight < 1) { max_in_flight = 1; }
+
+    while(next < tag_names.size() || !pending.empty()) {
+        bool progress = false;
+
+        /* top up the window */
+        while(next < tag_names.size() && (int)pending.size() < max_in_flight) {
+            std::string tag_string = std::string(base) + tag_names[next];
+
+            if(debug_level >= PLCTAG_DEBUG_INFO) {
+                // NOLINTNEXTLINE
+                fprintf(stderr, "Using tag string \"%s\".\n", tag_string.c_str());
+            }
+
+            handles[next] = plc_tag_create(tag_string.c_str(), 0);
+            if(handles[next] >= 0) { pending.push_back({next, false, steady_clock::now() + milliseconds(TIMEOUT_MS)}); }
+
+            next++;
+            progress = true;
+        }
+
+        for(size_t i = 0; i < pending.size();) {
+            pending_s &p = pending[i];
+            int32_t tag = handles[p.index];
+            int rc = plc_tag_status(tag);
+
+            if(rc == PLCTAG_STATUS_PENDING) {
+                if(steady_clock::now() < p.deadline) {
+                    i++;
+                    continue;
+                }
+
+                plc_tag_abort(tag);
+                rc = PLCTAG_ERR_TIMEOUT;
+            }
+
+            /* created, start the read */
+            if(rc == PLCTAG_STATUS_OK && !p.reading) {
+                rc = plc_tag_read(tag, 0);
+                if(rc == PLCTAG_STATUS_PENDING) {
+                    p.reading = true;
+                    p.deadline = steady_clock::now() + milliseconds(TIMEOUT_MS);
+                    progress = true;
+                    i++;
+                    continue;
+                }
+            }
+
+            if(rc != PLCTAG_STATUS_OK) {
+                plc_tag_destroy(tag);
+                handles[p.index] = rc;
+            }
+
+            pending[i] = pending.back();
+            pending.pop_back();
+            progress = true;
+        }
+
+        if(!progress) { std::this_thread::sleep_for(milliseconds(1)); }
+    }
+}
+
+
 int get_tag_list(int32_t tag, struct tag_entry_s **tag_list, struct tag_entry_s *parent) {
     int rc = PLCTAG_STATUS_OK;
-    uint16_t last_tag_entry_id = 0;
-    int payload_size = 0;
-    int offset = 0;
 
     /* go get it. */
     rc = plc_tag_read(tag, TIMEOUT_MS);
@@ -515,6 +708,17 @@ int get_tag_list(int32_t tag, struct tag_entry_s **tag_list, struct tag_entry_s
         usage();
     }
 
+    return process_tag_list(tag, tag_list, parent);
+}
+
+
+/* walks the entries of a listing tag that has already been read. */
+int process_tag_list(int32_t tag, struct tag_entry_s **tag_list, struct tag_entry_s *parent) {
+    int rc = PLCTAG_STATUS_OK;
+    uint16_t last_tag_entry_id = 0;
+    int payload_size = 0;
+    int offset = 0;
+
     /* process the raw data. */
     payload_size = plc_tag_get_size(tag);
     if(payload_size < 0) {
@@ -736,17 +940,16 @@ int encode_request_prefix(const char *name, uint8_t *buffer, int *encoded_size)
 }
 
 
-int get_udt_definition(char *tag_string_base, uint16_t udt_id) {
-    int rc = PLCTAG_STATUS_OK;
-    int32_t udt_info_tag = 0;
+/* decodes a @udt/<id> tag that has already been read. The caller destroys the tag. */
+int process_udt_definition(int32_t udt_info_tag, uint16_t udt_id) {
     int tag_size = 0;
-    char buf[32] = {0};
     int offset = 0;
     uint16_t template_id = 0;
     uint16_t num_members = 0;
     uint16_t struct_handle = 0;
     uint32_t udt_instance_size = 0;
     // uint32_t member_desc_size = 0;
+    int rc = PLCTAG_STATUS_OK;
     int name_len = 0;
     char *name_str = NULL;
     int name_index = 0;
@@ -755,39 +958,11 @@ int get_udt_definition(char *tag_string_base, uint16_t udt_id) {
     /* memoize, check to see if we have this type already. */
     if(udts[udt_id]) { return PLCTAG_STATUS_OK; }
 
-    // NOLINTNEXTLINE
-    snprintf(buf, sizeof(buf), "@udt/%u", (unsigned int)udt_id);
-
-    udt_info_tag = open_tag(tag_string_base, buf);
-    if(udt_info_tag < 0) {
-        if(udt_info_tag == PLCTAG_ERR_UNSUPPORTED) {
-            // NOLINTNEXTLINE
-            fprintf(stderr, "This PLC type does not support listing UDT definitions.\n");
-            return PLCTAG_ERR_UNSUPPORTED;
-        }
-
-        // NOLINTNEXTLINE
-        fprintf(stderr, "Unable to open UDT info tag, error %s!\n", plc_tag_decode_error(udt_info_tag));
-        usage();
-    }
-
     if(debug_level >= PLCTAG_DEBUG_INFO) {
         // NOLINTNEXTLINE
         fprintf(stderr, "UDT info tag ID: %d\n", udt_info_tag);
     }
 
-    rc = plc_tag_read(udt_info_tag, TIMEOUT_MS);
-    if(rc == PLCTAG_ERR_UNSUPPORTED) {
-        plc_tag_destroy(udt_info_tag);
-        // NOLINTNEXTLINE
-        fprintf(stderr, "UDT tag introspection is not supported on this PLC.\n");
-        return rc;
-    } else if(rc != PLCTAG_STATUS_OK) {
-        // NOLINTNEXTLINE
-        fprintf(stderr, "Error %s while trying to read UDT info!\n", plc_tag_decode_error(rc));
-        usage();
-    }
-
     tag_size = plc_tag_get_size(udt_info_tag);
 
     /* the format in the tag buffer is:
@@ -870,6 +1045,12 @@ int get_udt_definition(char *tag_string_base, uint16_t udt_id) {
             uint16_t child_udt = (field_element_type & TYPE_UDT_ID_MASK);
 
             if(!udts[child_udt]) {
+                if(last_udt >= MAX_UDTS) {
+                    // NOLINTNEXTLINE
+                    fprintf(stderr, "More than %d UDTs are requested!\n", MAX_UDTS);
+                    usage();
+                }
+
                 udts_to_process[last_udt] = child_udt;
                 last_udt++;
             }
@@ -1041,11 +1222,5 @@ int get_udt_definition(char *tag_string_base, uint16_t udt_id) {
         }
     }
 
-    if(debug_level >= PLCTAG_DEBUG_INFO) {
-        // NOLINTNEXTLINE
-        fprintf(stderr, "Destroying UDT info tag: %d\n", udt_info_tag);
-    }
-    plc_tag_destroy(udt_info_tag);
-
     return PLCTAG_STATUS_OK;
 }
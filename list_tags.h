@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 
+#define LIST_TAGS_MAX_IN_FLIGHT 8      /* program listings / UDT templates read at once */
+
 
 struct TagEntry {
     std::string nextName;
@@ -17,6 +19,21 @@ struct TagEntry {
     uint16_t dimensions[3];
 };
 
+struct UdtField {
+    std::string name;
+    uint16_t type;
+    uint16_t metadata;      /* array element count, or bit number for BOOL fields */
+    uint32_t offset;
+};
+
+struct UdtEntry {
+    std::string name;
+    uint16_t id;
+    uint16_t struct_handle;
+    uint32_t instance_size;
+    std::vector<UdtField> fields;
+};
+
 // struct program_entry_s {
 //     struct program_entry_s *next;
 //     char *program_name;
@@ -53,7 +70,13 @@ struct TagEntry {
 //     struct udt_field_entry_s fields[];
 // };
 
+class TagTable;
+
 int list_tags(int argc, const char **argv, std::vector<TagEntry> &tagentries);
+int list_tags(int argc, const char **argv, std::vector<TagEntry> &tagentries, std::vector<UdtEntry> &udtentries,
+              bool use_catalog = true, int max_in_flight = LIST_TAGS_MAX_IN_FLIGHT);
+int list_tags(int argc, const char **argv, TagTable &tags, std::vector<UdtEntry> &udtentries,
+              bool use_catalog = true, int max_in_flight = LIST_TAGS_MAX_IN_FLIGHT);
 
 
 #endif // LIST_TAGS_H
@@ -1,9 +1,23 @@
+#include <string>
 
 int gui();
 void exercise();
+int bench(int argc, char **argv);
+int sweep(int argc, char **argv);
+int runDaemon(int argc, char **argv);
 
 
-int main() {
+int main(int argc, char **argv) {
+    if(argc > 1 && std::string(argv[1]) == "bench") {
+        return bench(argc - 1, argv + 1);
+    }
+    if(argc > 1 && std::string(argv[1]) == "sweep") {
+        return sweep(argc - 1, argv + 1);
+    }
+    if(argc > 1 && std::string(argv[1]) == "daemon") {
+        return runDaemon(argc - 1, argv + 1);
+    }
+
     //gui();
     exercise();
 
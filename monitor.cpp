@@ -0,0 +1,195 @@
+#include <libplctag.h>
+#include <string>
+#include <vector>
+
+#include "monitor.h"
+#include "plctags.h"
+#include "utility.h"
+
+
+//===============================================================================================================
+// MonitorQueue
+
+void MonitorQueue::reset(size_t min_capacity) {
+    size_t capacity = 2;
+    while(capacity < min_capacity) capacity <<= 1;
+
+    cells.reset(new Cell[capacity]);
+    mask = capacity - 1;
+    for(size_t i = 0; i < capacity; i++) cells[i].seq.store(i, std::memory_order_relaxed);
+
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+}
+
+bool MonitorQueue::push(uint32_t value) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+
+    for(;;) {
+        Cell &cell = cells[pos & mask];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if(diff == 0) {
+            if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.value = value;
+                cell.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if(diff < 0) {
+            return false;   /* full */
+        } else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool MonitorQueue::pop(uint32_t &value) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    Cell &cell = cells[pos & mask];
+
+    if((intptr_t)cell.seq.load(std::memory_order_acquire) - (intptr_t)(pos + 1) < 0) return false;
+
+    value = cell.value;
+    cell.seq.store(pos + mask + 1, std::memory_order_release);
+    head.store(pos + 1, std::memory_order_relaxed);
+
+    return true;
+}
+
+
+
+//===============================================================================================================
+// TagMonitor
+
+/* runs on a library thread with the tag API mutex held: only flag the item and queue it. */
+void TagMonitor::readCallback(int32_t tag, int event, int status, void *userdata) {
+    (void)tag;
+
+    Slot *slot = static_cast<Slot *>(userdata);
+
+    if(event == PLCTAG_EVENT_READ_STARTED) {
+        slot->started_ns.store(latencyNowNs(), std::memory_order_relaxed);
+    } else if(event == PLCTAG_EVENT_READ_COMPLETED) {
+        uint64_t started = slot->started_ns.exchange(0, std::memory_order_relaxed);
+        if(started && status == PLCTAG_STATUS_OK) recordLatency(TagOp::READ, slot->item.codec->type, latencyNowNs() - started);
+
+        /* one queue entry per item at most, so the queue (sized to the item count) cannot overflow */
+        if(slot->pending.exchange(1, std::memory_order_acq_rel) == 0) {
+            slot->owner->queue.push(slot->index);
+        }
+    }
+}
+
+int32_t TagMonitor::start(string &error_string, const vector<MonitorItem> &items, int period_ms, const ProgressFn &on_progress) {
+    stop();
+    rows.clear();
+
+    if(items.empty()) {
+        error_string = "Nothing to monitor.\n";
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    slots_storage.reset(new Slot[items.size()]);
+    queue.reset(items.size());
+
+    /* spread: the library staggers the reads over the period instead of bursting them */
+    string attr = ssprintf("&auto_sync_read_ms=%d&auto_sync_read_spread=1", period_ms);
+    bool single = items.size() == 1;
+
+    for(size_t i = 0; i < items.size(); i++) {
+        Slot *slot = &slots_storage[i];
+        string es;
+
+        slot->owner = this;
+        slot->index = (uint32_t)slots.size();
+        slot->item = items[i];
+        slot->handle = createTag(es, items[i].tagstring + attr, DATA_TIMEOUT, items[i].codec->type);
+
+        if(on_progress) on_progress(i + 1);
+
+        if(slot->handle < 0) {
+            /* keep going, one bad name should not stop the others; the row shows why */
+            rows.push_back(ssprintf("%s: %s", items[i].name.c_str(), plc_tag_decode_error(slot->handle)));
+            continue;
+        }
+
+        /* a single tag shows one row per element, several tags one row each */
+        int elem_count = plc_tag_get_int_attribute(slot->handle, "elem_count", 1);
+        slot->first_row = rows.size();
+        slot->row_count = single && items[i].codec->elem_size > 0 ? (size_t)max(1, elem_count) : 1;
+        rows.resize(rows.size() + slot->row_count);
+
+        slots.push_back(slot);
+
+        int32_t rc = plc_tag_register_callback_ex(slot->handle, readCallback, slot);
+        if(rc != PLCTAG_STATUS_OK) {
+            rows[slot->first_row] = ssprintf("%s: %s", items[i].name.c_str(), plc_tag_decode_error(rc));
+            continue;
+        }
+
+        /* the create already read it once, show that without waiting for the first period */
+        if(slot->pending.exchange(1) == 0) queue.push(slot->index);
+    }
+
+    if(slots.empty()) {
+        error_string = ssprintf("None of the %zu tags could be created.\n", items.size());
+        stop();
+        return PLCTAG_ERR_CREATE;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+void TagMonitor::stop() {
+    for(Slot *slot : slots) {
+        /* after this returns the library will not call back into the slot again */
+        plc_tag_unregister_callback(slot->handle);
+        destroyTag(slot->handle);
+    }
+
+    /* the rows stay: the UI keeps showing the last values after monitoring stops */
+    slots.clear();
+    slots_storage.reset();
+    update_count = 0;
+}
+
+size_t TagMonitor::poll(vector<size_t> &changed_rows) {
+    size_t before = changed_rows.size();
+    vector<string> values;
+    uint32_t index;
+
+    while(queue.pop(index)) {
+        Slot *slot = slots[index];
+        string es;
+
+        /* clear first: a read that completes while we decode queues the item again */
+        slot->pending.store(0, std::memory_order_release);
+
+        values.clear();
+        int32_t rc = plc_tag_status(slot->handle);
+        if(rc == PLCTAG_STATUS_OK || rc == PLCTAG_STATUS_PENDING) {
+            /* PENDING is the next auto sync read in flight, the buffer still holds the last one */
+            rc = slot->item.codec->decode(es, slot->handle, &values);
+        }
+
+        update_count++;
+
+        for(size_t r = 0; r < slot->row_count; r++) {
+            string text;
+            if(rc != PLCTAG_STATUS_OK) {
+                text = r == 0 ? ssprintf("%s%s%s", slot->item.name.c_str(), slot->item.name.empty() ? "" : ": ", plc_tag_decode_error(rc)) : "";
+            } else if(r < values.size()) {
+                text = slot->item.name.empty() ? values[r] : slot->item.name + " = " + values[r];
+            }
+
+            string &current = rows[slot->first_row + r];
+            if(current != text) {
+                current.swap(text);
+                changed_rows.push_back(slot->first_row + r);
+            }
+        }
+    }
+
+    return changed_rows.size() - before;
+}
@@ -0,0 +1,95 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <stdint.h>
+
+#include "tag_codec.h"
+
+using namespace std;
+
+#define MONITOR_PERIOD_MS 100       /* default auto_sync_read_ms */
+#define MONITOR_UI_POLL_MS 20       /* how often the UI drains completions while monitoring */
+
+/*
+ * Bounded lock-free queue of item indexes: any number of producers (library
+ * callback threads), one consumer (the UI thread). Sequence numbered cells,
+ * so a producer never waits on the consumer.
+ */
+class MonitorQueue {
+public:
+    void reset(size_t min_capacity);
+    bool push(uint32_t value);
+    bool pop(uint32_t &value);
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        uint32_t value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+};
+
+struct MonitorItem {
+    string name;            /* shown in front of the value when monitoring several tags, empty for one */
+    string tagstring;
+    const TagCodec *codec;
+};
+
+/*
+ * Live monitor: every item gets a handle with auto_sync_read_ms and
+ * auto_sync_read_spread set, the library reads them in the background,
+ * staggered over the period, and READ_COMPLETED callbacks only push the
+ * item index onto a MonitorQueue (at most once until the UI has taken it).
+ * poll() runs on the UI thread, decodes just those tags and returns the
+ * section 3 rows whose text actually changed.
+ */
+class TagMonitor {
+public:
+    using ProgressFn = std::function<void(size_t created)>;
+
+    ~TagMonitor() { stop(); }
+
+    int32_t start(string &error_string, const vector<MonitorItem> &items, int period_ms = MONITOR_PERIOD_MS,
+                  const ProgressFn &on_progress = nullptr);
+    void stop();
+
+    bool active() const { return !slots.empty(); }
+    size_t rowCount() const { return rows.size(); }
+    const string &row(size_t index) const { return rows[index]; }
+
+    /* decode what completed since the last call, appends the indexes of rows that changed */
+    size_t poll(vector<size_t> &changed_rows);
+
+    uint64_t updates() const { return update_count; }
+
+private:
+    struct Slot {
+        TagMonitor *owner;
+        uint32_t index;
+        MonitorItem item;
+        int32_t handle;
+        size_t first_row;
+        size_t row_count;
+        std::atomic<uint8_t> pending{0};
+        std::atomic<uint64_t> started_ns{0};
+    };
+
+    static void readCallback(int32_t tag, int event, int status, void *userdata);
+
+    std::unique_ptr<Slot[]> slots_storage;
+    vector<Slot *> slots;
+    vector<string> rows;
+    MonitorQueue queue;
+    uint64_t update_count = 0;
+};
+
+#endif // MONITOR_H
@@ -0,0 +1,298 @@
+#include <libplctag.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "plant_scan.h"
+#include "plctags.h"
+#include "utility.h"
+
+using namespace std::chrono;
+
+#define PLANT_POLL_MS 50            /* wait for a completion before checking timeouts */
+#define PLANT_CREATE_POLL_MS 1      /* the same while handles are still being created */
+
+
+//===============================================================================================================
+// PlantResultStore
+
+void PlantResultStore::put(const string &controller, const string &tag, PlantValue &&value) {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    values[{ controller, tag }] = std::move(value);
+}
+
+bool PlantResultStore::get(const string &controller, const string &tag, PlantValue &value) const {
+    std::lock_guard<std::mutex> lock(store_mutex);
+
+    auto it = values.find({ controller, tag });
+    if(it == values.end()) return false;
+
+    value = it->second;
+    return true;
+}
+
+void PlantResultStore::forEach(const std::function<void(const string &, const string &, const PlantValue &)> &fn) const {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    for(const auto &[key, value] : values) fn(key.first, key.second, value);
+}
+
+size_t PlantResultStore::size() const {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    return values.size();
+}
+
+void PlantResultStore::clear() {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    values.clear();
+}
+
+
+
+//===============================================================================================================
+// PlantScanner
+
+static int64_t plantNowMs() {
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t plantNowUs() {
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/* runs on the library tickler thread with the tag API mutex held: only queue the result here. */
+void PlantScanner::readCallback(int32_t tag, int event, int status, void *userdata) {
+    (void)tag;
+
+    if(event != PLCTAG_EVENT_READ_COMPLETED) return;
+
+    Item *item = static_cast<Item *>(userdata);
+    PlantScanner *self = item->owner;
+    {
+        std::lock_guard<std::mutex> lock(self->completed_mutex);
+        self->completed.emplace_back(item, status);
+    }
+    self->completed_cv.notify_one();
+}
+
+void PlantScanner::open(const vector<PlantController> &new_controllers) {
+    close();
+
+    controllers = new_controllers;
+    by_controller.assign(controllers.size(), {});
+
+    for(size_t c = 0; c < controllers.size(); c++) {
+        const PlantController &pc = controllers[c];
+
+        for(size_t t = 0; t < pc.tags.size(); t++) {
+            const PlantTag &pt = pc.tags[t];
+            string tagstring = buildTagstring(pc.gateway, pt.name, pt.count, pc.path, pc.cpu, pc.protocol);
+            if(!pc.attrs.empty()) tagstring += "&" + pc.attrs;
+
+            by_controller[c].push_back(items.size());
+            items.push_back({ this, c, t, tagCodec(pt.cip_type), tagstring, -1, Stage::IDLE, 0 });
+        }
+    }
+}
+
+void PlantScanner::close() {
+    for(Item &item : items) {
+        if(item.handle >= 0) destroyTag(item.handle);
+    }
+
+    items.clear();
+    by_controller.clear();
+    controllers.clear();
+}
+
+void PlantScanner::issue(Item &item) {
+    string es;
+
+    in_flight++;
+    controller_in_flight[item.controller]++;
+    if(controller_start_us[item.controller] == 0) controller_start_us[item.controller] = plantNowUs();
+
+    item.deadline_ms = plantNowMs() + time_out_ms;
+
+    if(item.handle >= 0) {
+        startRead(item);
+        return;
+    }
+
+    /* timeout 0: the create goes out with everything else, sweep() polls its status */
+    item.handle = createTag(es, item.tagstring, 0, item.codec->type);
+    if(item.handle < 0) {
+        int32_t rc = item.handle;
+        item.handle = -1;
+        item.stage = Stage::CREATING;
+
+        std::lock_guard<std::mutex> lock(completed_mutex);
+        completed.emplace_back(&item, rc);
+        return;
+    }
+
+    item.stage = Stage::CREATING;
+    creating.push_back(&item);
+}
+
+void PlantScanner::startRead(Item &item) {
+    item.stage = Stage::READING;
+    reading.push_back(&item);
+
+    int32_t rc = plc_tag_register_callback_ex(item.handle, readCallback, &item);
+    if(rc == PLCTAG_STATUS_OK) {
+        rc = plc_tag_read(item.handle, 0);
+        if(rc == PLCTAG_STATUS_PENDING) return;
+    }
+
+    /* immediate failure, nothing will be queued for it */
+    std::lock_guard<std::mutex> lock(completed_mutex);
+    completed.emplace_back(&item, rc);
+}
+
+void PlantScanner::finish(Item &item, int32_t status, PlantResultStore &store) {
+    const PlantController &pc = controllers[item.controller];
+    PlantControllerStats &stats = controller_stats[item.controller];
+    PlantValue value;
+
+    if(item.stage == Stage::READING) {
+        /* after this returns the library will not call back into this item again */
+        plc_tag_unregister_callback(item.handle);
+    }
+
+    if(status == PLCTAG_STATUS_OK) {
+        string es;
+        status = item.codec->decode(es, item.handle, &value.values);
+    } else if(item.handle >= 0 && (item.stage == Stage::CREATING || status == PLCTAG_ERR_TIMEOUT)) {
+        /* start over with a fresh handle next sweep */
+        destroyTag(item.handle);
+        item.handle = -1;
+    }
+
+    value.status = status;
+    value.updated_ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    store.put(pc.name, pc.tags[item.tag].name, std::move(value));
+
+    item.stage = Stage::DONE;
+    in_flight--;
+    controller_in_flight[item.controller]--;
+    done++;
+
+    stats.reads++;
+    if(status != PLCTAG_STATUS_OK) stats.errors++;
+    stats.duration_us = plantNowUs() - controller_start_us[item.controller];
+}
+
+int32_t PlantScanner::sweep(string &error_string, PlantResultStore &store, const ProgressFn &on_progress) {
+    if(max_in_flight < 1 || window < 1) {
+        error_string = ssprintf("ERROR: in flight limit %d and controller window %d must be at least 1.\n", max_in_flight, window);
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    size_t controller_count = controllers.size();
+    vector<size_t> next(controller_count, 0);
+
+    controller_stats.assign(controller_count, PlantControllerStats());
+    controller_in_flight.assign(controller_count, 0);
+    controller_start_us.assign(controller_count, 0);
+    in_flight = 0;
+    done = 0;
+    creating.clear();
+    reading.clear();
+    sweep_start_us = plantNowUs();
+    {
+        std::lock_guard<std::mutex> lock(completed_mutex);
+        completed.clear();
+    }
+
+    for(Item &item : items) item.stage = Stage::IDLE;
+
+    /* tags without a codec are answered right away, there is nothing to decode them with */
+    for(Item &item : items) {
+        if(item.codec) continue;
+
+        const PlantController &pc = controllers[item.controller];
+        PlantValue value;
+        value.status = PLCTAG_ERR_UNSUPPORTED;
+        store.put(pc.name, pc.tags[item.tag].name, std::move(value));
+
+        item.stage = Stage::DONE;
+        controller_stats[item.controller].reads++;
+        controller_stats[item.controller].errors++;
+        done++;
+    }
+
+    while(done < items.size()) {
+        /* top up round robin: every controller gets one slot per pass while there is room */
+        for(bool issued = true; issued && in_flight < max_in_flight; ) {
+            issued = false;
+
+            for(size_t c = 0; c < controller_count && in_flight < max_in_flight; c++) {
+                vector<size_t> &mine = by_controller[c];
+
+                while(next[c] < mine.size() && items[mine[next[c]]].stage == Stage::DONE) next[c]++;
+                if(next[c] >= mine.size() || controller_in_flight[c] >= window) continue;
+
+                issue(items[mine[next[c]++]]);
+                issued = true;
+            }
+        }
+
+        /* handles created this sweep: start their read as soon as the create finishes */
+        int64_t now = plantNowMs();
+        size_t still_creating = 0;
+
+        for(Item *item : creating) {
+            if(item->stage != Stage::CREATING) continue;
+
+            int32_t rc = plc_tag_status(item->handle);
+            if(rc == PLCTAG_STATUS_OK) {
+                startRead(*item);
+            } else if(rc == PLCTAG_STATUS_PENDING && item->deadline_ms > now) {
+                creating[still_creating++] = item;
+            } else {
+                finish(*item, rc == PLCTAG_STATUS_PENDING ? PLCTAG_ERR_TIMEOUT : rc, store);
+            }
+        }
+        creating.resize(still_creating);
+
+        /* wait for completions */
+        std::deque<std::pair<Item *, int32_t>> batch;
+        {
+            std::unique_lock<std::mutex> lock(completed_mutex);
+            completed_cv.wait_for(lock, milliseconds(!creating.empty() ? PLANT_CREATE_POLL_MS : PLANT_POLL_MS),
+                                  [this] { return !completed.empty(); });
+            batch.swap(completed);
+        }
+
+        for(auto &[item, status] : batch) {
+            if(item->stage == Stage::READING || item->stage == Stage::CREATING) finish(*item, status, store);
+        }
+
+        /* expire reads that have been in flight too long, oldest first */
+        now = plantNowMs();
+        while(!reading.empty()) {
+            Item *item = reading.front();
+            if(item->stage != Stage::READING) {
+                reading.pop_front();
+            } else if(item->deadline_ms <= now) {
+                reading.pop_front();
+                plc_tag_abort(item->handle);
+                finish(*item, PLCTAG_ERR_TIMEOUT, store);
+            } else {
+                break;
+            }
+        }
+
+        if(on_progress) on_progress(done, items.size());
+    }
+
+    duration_us = plantNowUs() - sweep_start_us;
+
+    int32_t errors = 0;
+    for(const auto &stats : controller_stats) errors += stats.errors;
+    if(errors > 0) {
+        error_string = ssprintf("%d of %zu reads failed.\n", errors, items.size());
+    }
+
+    return PLCTAG_STATUS_OK;
+}
@@ -0,0 +1,147 @@
+#ifndef PLANT_SCAN_H
+#define PLANT_SCAN_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+#include "plctags.h"
+#include "tag_codec.h"
+
+using namespace std;
+
+#define PLANT_MAX_IN_FLIGHT 256         /* creates + reads outstanding over all controllers */
+#define PLANT_CONTROLLER_WINDOW 32      /* outstanding per controller, one slow PLC cannot take the whole pool */
+
+struct PlantTag {
+    string name;
+    uint16_t cip_type;
+    int count;
+};
+
+struct PlantController {
+    string name;            /* key in the result store */
+    string gateway;
+    string path = DEFAULT_PATH;
+    string cpu = DEFAULT_CPU;
+    string protocol = DEFAULT_PROTOCOL;
+    string attrs;           /* extra tag attributes, e.g. allow_packing=0 */
+    vector<PlantTag> tags;
+};
+
+struct PlantValue {
+    int32_t status = PLCTAG_ERR_NOT_FOUND;
+    int64_t updated_ms = 0;     /* wall clock of the read */
+    vector<string> values;
+};
+
+/*
+ * Latest value of every (controller, tag), written by the sweep and safe to
+ * read from other threads at the same time.
+ */
+class PlantResultStore {
+public:
+    void put(const string &controller, const string &tag, PlantValue &&value);
+    bool get(const string &controller, const string &tag, PlantValue &value) const;
+    void forEach(const std::function<void(const string &controller, const string &tag, const PlantValue &value)> &fn) const;
+    size_t size() const;
+    void clear();
+
+private:
+    struct KeyHash {
+        size_t operator()(const pair<string, string> &k) const {
+            return std::hash<string>()(k.first) * 31 + std::hash<string>()(k.second);
+        }
+    };
+
+    mutable std::mutex store_mutex;
+    unordered_map<pair<string, string>, PlantValue, KeyHash> values;
+};
+
+struct PlantControllerStats {
+    int32_t reads = 0;
+    int32_t errors = 0;
+    int64_t duration_us = 0;    /* first request to last completion of this controller */
+};
+
+/*
+ * Sweeps many controllers at once from one thread.
+ *
+ * Every controller is its own pipeline (create the handle if there is none
+ * yet, read, decode, store), and all pipelines share one budget of
+ * max_in_flight outstanding requests. Requests are handed out round robin
+ * with at most `window` per controller, so the sweep takes about as long as
+ * the slowest controller instead of the sum of all of them. The library does
+ * the network I/O on its own threads; this loop only issues requests and
+ * decodes completions.
+ *
+ * Handles are kept between sweeps, close() destroys them.
+ */
+class PlantScanner {
+public:
+    using ProgressFn = std::function<void(size_t done, size_t total)>;
+
+    explicit PlantScanner(int max_in_flight = PLANT_MAX_IN_FLIGHT, int window = PLANT_CONTROLLER_WINDOW,
+                          int time_out_ms = DATA_TIMEOUT)
+        : max_in_flight(max_in_flight), window(window), time_out_ms(time_out_ms) {}
+    ~PlantScanner() { close(); }
+
+    /* replaces the controller list, existing handles are destroyed */
+    void open(const vector<PlantController> &controllers);
+    void close();
+
+    int32_t sweep(string &error_string, PlantResultStore &store, const ProgressFn &on_progress = nullptr);
+
+    const vector<PlantControllerStats> &controllerStats() const { return controller_stats; }
+    int64_t durationUs() const { return duration_us; }
+
+private:
+    enum class Stage : uint8_t { IDLE, CREATING, READING, DONE };
+
+    struct Item {
+        PlantScanner *owner;
+        size_t controller;
+        size_t tag;
+        const TagCodec *codec;
+        string tagstring;
+        int32_t handle;
+        Stage stage;
+        int64_t deadline_ms;
+    };
+
+    static void readCallback(int32_t tag, int event, int status, void *userdata);
+
+    void issue(Item &item);
+    void startRead(Item &item);
+    void finish(Item &item, int32_t status, PlantResultStore &store);
+
+    int max_in_flight;
+    int window;
+    int time_out_ms;
+
+    vector<PlantController> controllers;
+    vector<Item> items;
+    vector<vector<size_t>> by_controller;   /* item indexes per controller, in tag order */
+
+    /* per sweep state */
+    vector<PlantControllerStats> controller_stats;
+    vector<int> controller_in_flight;
+    vector<int64_t> controller_start_us;
+    vector<Item *> creating;            /* create issued, status not OK yet */
+    std::deque<Item *> reading;         /* read issued, in issue order for the timeout check */
+    int in_flight = 0;
+    size_t done = 0;
+    int64_t sweep_start_us = 0;
+    int64_t duration_us = 0;
+
+    std::mutex completed_mutex;
+    std::condition_variable completed_cv;
+    std::deque<std::pair<Item *, int32_t>> completed;
+};
+
+#endif // PLANT_SCAN_H
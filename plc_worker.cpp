@@ -0,0 +1,125 @@
+#include <libplctag.h>
+#include <string>
+#include <chrono>
+
+#include "plc_worker.h"
+#include "plctags.h"
+
+
+//===============================================================================================================
+// PlcJob
+
+const std::atomic<bool> &PlcJob::cancelFlag() const {
+    return worker.cancel_flag;
+}
+
+void PlcJob::progress(const string &text) {
+    worker.setProgress(text);
+}
+
+
+
+//===============================================================================================================
+// PlcWorker
+
+PlcWorker::~PlcWorker() {
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex);
+        stopping = true;
+    }
+    cancel();
+    worker_cv.notify_all();
+
+    if(thread.joinable()) thread.join();
+}
+
+uint64_t PlcWorker::submit(const string &title, JobFn fn) {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+
+    uint64_t id = next_id++;
+    queue.push_back({ id, title, std::move(fn) });
+    if(!thread.joinable()) thread = std::thread(&PlcWorker::run, this);
+    worker_cv.notify_one();
+
+    return id;
+}
+
+void PlcWorker::cancel() {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+
+    if(running) cancel_flag = true;
+
+    for(const Queued &q : queue) {
+        PlcJobResult result;
+        result.id = q.id;
+        result.title = q.title;
+        result.status = PLCTAG_ERR_ABORT;
+        result.error_string = q.title + " cancelled before it started";
+        results.push_back(std::move(result));
+    }
+    queue.clear();
+}
+
+bool PlcWorker::busy() const {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    return running || !queue.empty();
+}
+
+bool PlcWorker::poll(PlcJobResult &result) {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    if(results.empty()) return false;
+
+    result = std::move(results.front());
+    results.pop_front();
+    return true;
+}
+
+bool PlcWorker::progress(string &text) {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    if(!progress_new) return false;
+
+    text = progress_text;
+    progress_new = false;
+    return true;
+}
+
+void PlcWorker::setProgress(const string &text) {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    progress_text = text;
+    progress_new = true;
+}
+
+void PlcWorker::run() {
+    std::unique_lock<std::mutex> lock(worker_mutex);
+
+    while(true) {
+        bool woken = worker_cv.wait_for(lock, std::chrono::milliseconds(PLC_WORKER_IDLE_TICK_MS),
+                                        [this] { return stopping || !queue.empty(); });
+        if(stopping) break;
+        if(!woken) {
+            /* the cache takes its own lock and may destroy handles, not under ours */
+            lock.unlock();
+            tagHandleCache().evictIdle();
+            lock.lock();
+            continue;
+        }
+
+        Queued q = std::move(queue.front());
+        queue.pop_front();
+        running = true;
+        cancel_flag = false;
+        lock.unlock();
+
+        PlcJob job(*this);
+        PlcJobResult result;
+        result.id = q.id;
+        result.title = q.title;
+        result.status = q.fn(job);
+        result.error_string = std::move(job.error_string);
+
+        lock.lock();
+        running = false;
+        cancel_flag = false;
+        results.push_back(std::move(result));
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef PLC_WORKER_H
+#define PLC_WORKER_H
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include <libplctag.h>
+
+using namespace std;
+
+#define PLC_WORKER_UI_POLL_MS 50        /* how often the UI looks at progress and keys while a job runs */
+#define PLC_WORKER_IDLE_TICK_MS 1000    /* how often an idle worker evicts idle handles from tagHandleCache() */
+
+class PlcWorker;
+
+/* what a job gets on the worker thread */
+class PlcJob {
+public:
+    explicit PlcJob(PlcWorker &worker) : worker(worker) {}
+
+    /* set by PlcWorker::cancel(); long loops check it, scanners and reads abort their handles on it */
+    const std::atomic<bool> &cancelFlag() const;
+    bool cancelled() const { return cancelFlag().load(); }
+
+    /* newest text wins, the UI shows it the next time it polls */
+    void progress(const string &text);
+
+    string error_string;        /* handed back in the result */
+
+private:
+    PlcWorker &worker;
+};
+
+struct PlcJobResult {
+    uint64_t id = 0;
+    string title;
+    int32_t status = PLCTAG_STATUS_OK;
+    string error_string;
+};
+
+/*
+ * One background thread for blocking PLC work, so the UI thread never waits
+ * on the network. Jobs run one at a time in submit order; every job ends as
+ * a PlcJobResult the UI picks up with poll(). cancel() flags the running job
+ * and drops the queued ones, which end with PLCTAG_ERR_ABORT. A job only
+ * stops where it checks the flag, so work that cannot be interrupted (a
+ * blocking create, a listing) runs to its end and its result is dropped.
+ *
+ * The thread starts with the first job and is joined by the destructor.
+ * Between jobs it wakes every PLC_WORKER_IDLE_TICK_MS to let the shared tag
+ * handle cache destroy the handles nobody has used for a while.
+ */
+class PlcWorker {
+public:
+    using JobFn = std::function<int32_t(PlcJob &job)>;
+
+    ~PlcWorker();
+
+    uint64_t submit(const string &title, JobFn fn);
+    void cancel();
+    bool busy() const;
+
+    /* UI side, neither call blocks */
+    bool poll(PlcJobResult &result);
+    bool progress(string &text);
+
+private:
+    friend class PlcJob;
+
+    struct Queued {
+        uint64_t id;
+        string title;
+        JobFn fn;
+    };
+
+    void run();
+    void setProgress(const string &text);
+
+    std::thread thread;
+    mutable std::mutex worker_mutex;
+    std::condition_variable worker_cv;
+    std::deque<Queued> queue;
+    std::deque<PlcJobResult> results;
+    std::atomic<bool> cancel_flag{false};
+    uint64_t next_id = 1;
+    bool running = false;       /* a job is executing */
+    bool stopping = false;
+
+    string progress_text;
+    bool progress_new = false;
+};
+
+#endif // PLC_WORKER_H
@@ -6,6 +6,10 @@
 #include <string>
 #include <cstdarg>
 #include <unordered_map>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <thread>
 
 #include "plctags.h"
 #include "utility.h"
@@ -128,7 +132,41 @@ uint16_t getTagTypeCode(string type) {
     return mapFindKey(cip_data_map, type);
 }
 
-int32_t createTag(string &error_string, string tagstring, int time_out_ms) {
+bool parseTagSpec(const string &spec, string &name, string &type, int &count) {
+    string s = spec;
+    count = 1;
+    type = "?";
+
+    size_t bracket = s.find('[');
+    if(bracket != string::npos) {
+        size_t close = s.find(']', bracket);
+        if(close == string::npos) return false;
+        count = atoi(s.substr(bracket + 1, close - bracket - 1).c_str());
+        s = s.substr(0, bracket);
+    }
+
+    /* program scoped names have colons of their own, only a known type name after the last one is a type */
+    size_t colon = s.rfind(':');
+    if(colon != string::npos && colon > 0 && getTagTypeCode(s.substr(colon + 1)) != 0) {
+        type = s.substr(colon + 1);
+        s = s.substr(0, colon);
+    }
+
+    name = s;
+
+    return !name.empty() && count > 0;
+}
+
+/* byte order of the handles made by createTag(), see rawByteOrderFor() */
+static std::mutex raw_order_mutex;
+static std::unordered_map<int32_t, RawByteOrder> raw_orders;
+
+int32_t createTag(string &error_string, string tagstring, int time_out_ms, uint16_t cip_type) {
+    return createTagWithCallback(error_string, tagstring, nullptr, nullptr, time_out_ms, cip_type);
+}
+
+int32_t createTagWithCallback(string &error_string, string tagstring, void (*callback)(int32_t tag, int event, int status, void *userdata),
+                              void *userdata, int time_out_ms, uint16_t cip_type) {
     int32_t tag;
 
     /* check the library version. */
@@ -137,8 +175,9 @@ int32_t createTag(string &error_string, string tagstring, int time_out_ms) {
         return -1001;
     }
 
-    /* create the tag */
-    tag = plc_tag_create(tagstring.c_str(), time_out_ms);
+    /* create the tag, with time_out_ms 0 this only starts the creation (plc_tag_status() is PENDING until done) */
+    uint64_t start_ns = latencyNowNs();
+    tag = plc_tag_create_ex(tagstring.c_str(), callback, userdata, time_out_ms);
 
     /* everything OK? */
     if(tag < 0) {
@@ -146,91 +185,455 @@ int32_t createTag(string &error_string, string tagstring, int time_out_ms) {
         return tag;
     }
 
+    if(time_out_ms > 0) recordLatency(TagOp::CREATE, cip_type, latencyNowNs() - start_ns);
+
+    RawByteOrder order = rawByteOrderFor(tagstring);
+    if(order != RawByteOrder::UNKNOWN) {
+        std::lock_guard<std::mutex> lock(raw_order_mutex);
+        raw_orders[tag] = order;
+    }
+
     return tag;
 }
 
+void destroyTag(int32_t tag) {
+    {
+        std::lock_guard<std::mutex> lock(raw_order_mutex);
+        raw_orders.erase(tag);
+    }
+    plc_tag_destroy(tag);
+}
 
-int32_t readStringTag(string &error_string, int32_t tag, vector<string> &values, int time_out_ms) {
-    int str_num = 1;
-    int offset = 0;
+void destroyTags(const vector<int32_t> &tags) {
+    vector<int32_t> valid;
+    valid.reserve(tags.size());
+    {
+        std::lock_guard<std::mutex> lock(raw_order_mutex);
+        for(int32_t tag : tags) {
+            if(tag < 0) continue;
+            raw_orders.erase(tag);
+            valid.push_back(tag);
+        }
+    }
+
+    /* one library call: the lookup table is cleared in one pass, whatever is in flight is aborted, sessions close with their last tag */
+    if(!valid.empty()) plc_tag_destroy_many(valid.data(), (int)valid.size());
+}
+
+
+
+//============================================================================
+// Raw snapshot codec.
+
+/* mirrors the protocol/plc tables in libplctag (init.c, ab_common.c get_plc_type) */
+RawByteOrder rawByteOrderFor(const string &tagstring) {
+    string protocol;
+    string plc;
+
+    std::istringstream attrs(tagstring);
+    string attr;
+    while(std::getline(attrs, attr, '&')) {
+        size_t eq = attr.find('=');
+        if(eq == string::npos) continue;
+
+        string key = attr.substr(0, eq);
+        string value = attr.substr(eq + 1);
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+
+        if(key.find("_byte_order") != string::npos) return RawByteOrder::UNKNOWN;
+        if(key.compare(0, 4, "str_") == 0) return RawByteOrder::UNKNOWN;     /* custom string layout */
+        if(key == "protocol") protocol = value;
+        else if(key == "plc" || (key == "cpu" && plc.empty())) plc = value;
+    }
+
+    if(protocol == "modbus-tcp" || protocol == "modbus_tcp") {
+        return RawByteOrder::BIG;
+    }
+
+    if(protocol == "ab-eip" || protocol == "ab_eip") {
+        /* PLC/5 stores REALs word swapped */
+        if(plc == "plc" || plc == "plc5") return RawByteOrder::UNKNOWN;
+        return RawByteOrder::LITTLE;
+    }
+
+    return RawByteOrder::UNKNOWN;
+}
+
+RawByteOrder tagRawByteOrder(int32_t tag) {
+    std::lock_guard<std::mutex> lock(raw_order_mutex);
+    auto it = raw_orders.find(tag);
+    return it == raw_orders.end() ? RawByteOrder::UNKNOWN : it->second;
+}
+
+vector<uint8_t> &rawScratchBuffer() {
+    static thread_local vector<uint8_t> buffer;
+    return buffer;
+}
+
+//============================================================================
+// STRING_LGX snapshot codec.
+
+int stringLgxCount(int32_t tag) {
+    if(tagRawByteOrder(tag) != RawByteOrder::LITTLE) return 0;
+    if(plc_tag_get_int_attribute(tag, "elem_size", 0) != STRING_LGX_ELEM_SIZE) return 0;
+
+    int elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
+    if(elem_count < 1 || plc_tag_get_size(tag) < elem_count * STRING_LGX_ELEM_SIZE) return 0;
+
+    return elem_count;
+}
+
+/* one snapshot of the whole tag, reused per thread so the string views of it stay valid until the next decode */
+static int32_t stringLgxSnapshot(string &error_string, int32_t tag, int elem_count, const uint8_t **data) {
+    static thread_local vector<uint8_t> snapshot;
+    size_t len = (size_t)elem_count * STRING_LGX_ELEM_SIZE;
+
+    if(snapshot.size() < len) snapshot.resize(len);
+
+    int rc = plc_tag_get_raw_bytes(tag, 0, snapshot.data(), (int)len);
+    if(rc != PLCTAG_STATUS_OK) {
+        error_string = ssprintf("ERROR: Unable to get the raw string data! Error code %d: %s\n", rc, plc_tag_decode_error(rc));
+        return rc;
+    }
+
+    *data = snapshot.data();
+    return PLCTAG_STATUS_OK;
+}
+
+static inline int stringLgxLength(const uint8_t *elem) {
+    int32_t len = (int32_t)((uint32_t)elem[0] | (uint32_t)elem[1] << 8 | (uint32_t)elem[2] << 16 | (uint32_t)elem[3] << 24);
+    return len < 0 ? 0 : min(len, STRING_LGX_DATA_SIZE);
+}
+
+template <typename S>
+static int32_t decodeStringLgxAs(string &error_string, int32_t tag, vector<S> &values, int elem_count) {
+    const uint8_t *data = nullptr;
+
+    int32_t rc = stringLgxSnapshot(error_string, tag, elem_count, &data);
+    if(rc != PLCTAG_STATUS_OK) return rc;
+
+    values.reserve(values.size() + (size_t)elem_count);
+    for(int i = 0; i < elem_count; i++) {
+        const uint8_t *elem = data + (size_t)i * STRING_LGX_ELEM_SIZE;
+        values.emplace_back(reinterpret_cast<const char *>(elem + 4), (size_t)stringLgxLength(elem));
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+int32_t decodeStringLgx(string &error_string, int32_t tag, vector<string> &values, int elem_count) {
+    return decodeStringLgxAs(error_string, tag, values, elem_count);
+}
+
+static int32_t decodeStringLgxViews(string &error_string, int32_t tag, vector<string_view> &values, int elem_count) {
+    return decodeStringLgxAs(error_string, tag, values, elem_count);
+}
+
+/* only the first values.size() elements are written when there are fewer values than elements */
+int32_t encodeStringLgx(string &error_string, int32_t tag, const vector<string> &values, int elem_count) {
+    int count = min(elem_count, (int)values.size());
+    size_t len = (size_t)count * STRING_LGX_ELEM_SIZE;
+    vector<uint8_t> &buf = rawScratchBuffer();
+
+    if(count == 0) return PLCTAG_STATUS_OK;
+    if(buf.size() < len) buf.resize(len);
+
+    for(int i = 0; i < count; i++) {
+        const string &s = values[i];
+        uint8_t *elem = buf.data() + (size_t)i * STRING_LGX_ELEM_SIZE;
+
+        if(s.size() > STRING_LGX_DATA_SIZE) {
+            error_string = ssprintf("Error setting string %d, error %s!\n", i, plc_tag_decode_error(PLCTAG_ERR_TOO_LARGE));
+            return PLCTAG_ERR_TOO_LARGE;
+        }
+
+        uint32_t n = (uint32_t)s.size();
+        elem[0] = (uint8_t)n;
+        elem[1] = (uint8_t)(n >> 8);
+        elem[2] = 0;
+        elem[3] = 0;
+        memcpy(elem + 4, s.data(), n);
+        memset(elem + 4 + n, 0, STRING_LGX_ELEM_SIZE - 4 - n);
+    }
+
+    int rc = plc_tag_set_raw_bytes(tag, 0, buf.data(), (int)len);
+    if(rc != PLCTAG_STATUS_OK) {
+        error_string = ssprintf("ERROR: Unable to set the raw string data! Error code %d: %s\n", rc, plc_tag_decode_error(rc));
+        return rc;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+//============================================================================
+// Latency histograms.
+
+static const char *tag_op_names[TAG_OP_COUNT] = { "CREATE", "READ", "DECODE", "ENCODE", "WRITE" };
+
+/* allocated on first record and never freed, so readers can hold on to them */
+static std::atomic<LatencyHistogram *> latency_table[TAG_OP_COUNT][LAT_TYPE_SLOTS];
+
+static int latencySlot(uint16_t cip_type) {
+    if(cip_type == 0x8fce) return LAT_SLOT_STRING;
+    if(cip_type & 0x8000) return LAT_SLOT_STRUCT;
+    return cip_type & 0xff;     /* drops the array dimension bits */
+}
+
+static string latencySlotName(int slot) {
+    if(slot == 0) return "*";
+    if(slot == LAT_SLOT_STRING) return "STRING_LGX";
+    if(slot == LAT_SLOT_STRUCT) return "UDT";
+    return getTagType((uint16_t)slot, ssprintf("0x%02X", slot));
+}
+
+int LatencyHistogram::bucketFor(uint64_t ns) {
+    if(ns < LAT_SUB_BUCKETS) return (int)ns;
+
+    int exponent = 63 - __builtin_clzll(ns);
+    if(exponent > LAT_MAX_EXPONENT) return LAT_BUCKETS - 1;
+
+    int sub = (int)(ns >> (exponent - LAT_SUB_BITS)) & (LAT_SUB_BUCKETS - 1);
+    return (exponent - LAT_SUB_BITS + 1) * LAT_SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperNs(int bucket) {
+    if(bucket < LAT_SUB_BUCKETS) return (uint64_t)bucket;
+
+    int exponent = bucket / LAT_SUB_BUCKETS + LAT_SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(bucket % LAT_SUB_BUCKETS);
+    uint64_t step = (uint64_t)1 << (exponent - LAT_SUB_BITS);
+
+    return ((LAT_SUB_BUCKETS + sub) << (exponent - LAT_SUB_BITS)) + step - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    buckets[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+    total_count.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t seen = max_ns.load(std::memory_order_relaxed);
+    while(ns > seen && !max_ns.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::reset() {
+    for(auto &b : buckets) b.store(0, std::memory_order_relaxed);
+    total_count.store(0, std::memory_order_relaxed);
+    total_ns.store(0, std::memory_order_relaxed);
+    max_ns.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::percentileNs(double p) const {
+    /* count from the buckets themselves, total_count may be a record() ahead of them */
+    uint64_t n = 0;
+    for(const auto &b : buckets) n += b.load(std::memory_order_relaxed);
+    if(n == 0) return 0;
+
+    uint64_t target = (uint64_t)std::ceil(p / 100.0 * (double)n);
+    if(target < 1) target = 1;
+
+    uint64_t seen = 0;
+    for(int i = 0; i < LAT_BUCKETS; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if(seen >= target) return std::min(bucketUpperNs(i), maxNs());
+    }
+
+    return maxNs();
+}
+
+void recordLatency(TagOp op, uint16_t cip_type, uint64_t ns) {
+    std::atomic<LatencyHistogram *> &cell = latency_table[(int)op][latencySlot(cip_type)];
+
+    LatencyHistogram *h = cell.load(std::memory_order_acquire);
+    if(!h) {
+        LatencyHistogram *fresh = new LatencyHistogram();
+        if(cell.compare_exchange_strong(h, fresh, std::memory_order_acq_rel)) {
+            h = fresh;
+        } else {
+            delete fresh;   /* another thread got there first, h now holds its histogram */
+        }
+    }
+
+    h->record(ns);
+}
+
+const LatencyHistogram *latencyHistogram(TagOp op, uint16_t cip_type) {
+    return latency_table[(int)op][latencySlot(cip_type)].load(std::memory_order_acquire);
+}
+
+void resetLatencies() {
+    for(auto &row : latency_table) {
+        for(auto &cell : row) {
+            LatencyHistogram *h = cell.load(std::memory_order_acquire);
+            if(h) h->reset();
+        }
+    }
+}
+
+vector<string> latencyReport() {
+    vector<string> lines;
+    lines.push_back(ssprintf("%-7s %-12s %9s %10s %10s %10s %10s %10s %10s", "OP", "TYPE", "COUNT",
+                             "MEAN(us)", "P50(us)", "P90(us)", "P99(us)", "P99.9(us)", "MAX(us)"));
+
+    for(int op = 0; op < TAG_OP_COUNT; op++) {
+        for(int slot = 0; slot < LAT_TYPE_SLOTS; slot++) {
+            const LatencyHistogram *h = latency_table[op][slot].load(std::memory_order_acquire);
+            uint64_t n = h ? h->count() : 0;
+            if(n == 0) continue;
+
+            lines.push_back(ssprintf("%-7s %-12s %9llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f", tag_op_names[op],
+                                     latencySlotName(slot).c_str(), (unsigned long long)n, h->sumNs() / 1000.0 / (double)n,
+                                     h->percentileNs(50) / 1000.0, h->percentileNs(90) / 1000.0, h->percentileNs(99) / 1000.0,
+                                     h->percentileNs(99.9) / 1000.0, h->maxNs() / 1000.0));
+        }
+    }
+
+    return lines;
+}
 
+string latencyReportJson() {
+    string out = "[";
+    bool first = true;
+
+    for(int op = 0; op < TAG_OP_COUNT; op++) {
+        for(int slot = 0; slot < LAT_TYPE_SLOTS; slot++) {
+            const LatencyHistogram *h = latency_table[op][slot].load(std::memory_order_acquire);
+            uint64_t n = h ? h->count() : 0;
+            if(n == 0) continue;
+
+            out += ssprintf("%s{\"op\": \"%s\", \"type\": \"%s\", \"count\": %llu, \"mean_ns\": %llu, \"p50_ns\": %llu, "
+                            "\"p90_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+                            first ? "" : ", ", tag_op_names[op], latencySlotName(slot).c_str(), (unsigned long long)n,
+                            (unsigned long long)(h->sumNs() / n), (unsigned long long)h->percentileNs(50),
+                            (unsigned long long)h->percentileNs(90), (unsigned long long)h->percentileNs(99),
+                            (unsigned long long)h->percentileNs(99.9), (unsigned long long)h->maxNs());
+            first = false;
+        }
+    }
+
+    return out + "]";
+}
+
+
+int32_t readStringTag(string &error_string, int32_t tag, vector<string> &values, int time_out_ms) {
     /* get the data */
-    int32_t rc2 = plc_tag_read(tag, time_out_ms);
+    int32_t rc2 = timedTagRead(tag, time_out_ms, 0x8fce);
     if(rc2 != PLCTAG_STATUS_OK) {
         // fprintf(stderr, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc2, plc_tag_decode_error(rc2));
         return rc2;
     }
 
-    auto [rc, elem_size, elem_count] = tagGetSizes(error_string, tag);
-    if(rc != PLCTAG_STATUS_OK) {
-        return rc;
-    }
+    return decodeStringTag(error_string, tag, values);
+}
 
-    /* load the return vector*/
-    offset = 0;
-    str_num = 1;
-    while(offset < plc_tag_get_size(tag)) {
-        char *str = NULL;
-        int str_cap = plc_tag_get_string_length(tag, offset) + 1; /* +1 for the zero termination. */
+/* per element path for string layouts the snapshot codec does not know (PCCC, Omron, str_* overrides) */
+static int32_t decodeStringElements(string &error_string, int32_t tag, vector<string> &values) {
+    static thread_local string str;
+    int str_num = 1;
+    int offset = 0;
+    int size = plc_tag_get_size(tag);
 
-        str = (char*)malloc((size_t)(unsigned int)str_cap);
-        if(!str) {
-            // NOLINTNEXTLINE
-            //fprintf(stderr, "Unable to allocate memory for the string %d of tag!\n", str_num);
-            error_string = ssprintf("Unable to allocate memory for the string %d of tag!", str_num);
-            plc_tag_destroy(tag);
-            return PLCTAG_ERR_NO_MEM;
+    while(offset < size) {
+        int str_cap = plc_tag_get_string_length(tag, offset) + 1; /* +1 for the zero termination. */
+        if(str_cap < 1) {
+            error_string = ssprintf("Unable to get the length of string %d of tag, got error %s!", str_num, plc_tag_decode_error(str_cap - 1));
+            return str_cap - 1;
         }
 
-        rc = plc_tag_get_string(tag, offset, str, str_cap);
-        //rc = plc_tag_set_string(tag, offset, str);
+        str.resize((size_t)str_cap);
+        int32_t rc = plc_tag_get_string(tag, offset, &str[0], str_cap);
         if(rc != PLCTAG_STATUS_OK) {
-            // NOLINTNEXTLINE
-            //fprintf(stderr, "Unable to get string %d of tag, got error %s!\n", str_num, plc_tag_decode_error(rc));
             error_string = ssprintf("Unable to get string %d of tag, got error %s!", str_num, plc_tag_decode_error(rc));
-            free(str);
-            plc_tag_destroy(tag);
             return rc;
         }
 
-        // NOLINTNEXTLINE
-        //fprintf(stderr, "tag string %d (%u chars) = '%s'\n", str_num, (unsigned int)strlen(str), str);
-        values.push_back(str);
-
-        free(str);
+        values.emplace_back(str.data(), (size_t)(str_cap - 1));
 
         str_num++;
 
         offset += plc_tag_get_string_total_length(tag, offset);
     }
 
+    return PLCTAG_STATUS_OK;
+}
+
+int32_t decodeStringTag(string &error_string, int32_t tag, vector<string> &values) {
+    uint64_t start_ns = latencyNowNs();
+    int32_t rc;
+
+    int lgx_count = stringLgxCount(tag);
+    if(lgx_count > 0) {
+        rc = decodeStringLgx(error_string, tag, values, lgx_count);
+    } else {
+        auto [size_rc, elem_size, elem_count] = tagGetSizes(error_string, tag);
+        rc = size_rc == PLCTAG_STATUS_OK ? decodeStringElements(error_string, tag, values) : size_rc;
+    }
+    if(rc != PLCTAG_STATUS_OK) return rc;
+
+    recordLatency(TagOp::DECODE, 0x8fce, latencyNowNs() - start_ns);
+
     return 0;
 }
 
-int32_t writeStringTag(string &error_string, int32_t tag, vector<string> &values, int time_out_ms) {
-    int str_num = 1;
-    int offset = 0;
+int32_t decodeStringTagViews(string &error_string, int32_t tag, vector<string_view> &values) {
+    static thread_local vector<string> strings;
+    uint64_t start_ns = latencyNowNs();
+    int32_t rc;
 
-    auto [rc, elem_size, elem_count] = tagGetSizes(error_string, tag);
+    int lgx_count = stringLgxCount(tag);
+    if(lgx_count > 0) {
+        rc = decodeStringLgxViews(error_string, tag, values, lgx_count);
+    } else {
+        strings.clear();
+        rc = decodeStringElements(error_string, tag, strings);
+        for(const auto &s : strings) values.emplace_back(s);
+    }
+    if(rc != PLCTAG_STATUS_OK) return rc;
 
-    /* update the string. */
-    for(int i = 0; i < elem_count; i++) {
-        // NOLINTNEXTLINE
-        //compat_snprintf(str, sizeof(str), "string value for element %d is %d.", i, (int)(rand() % 1000));
-        int str_total_length = plc_tag_get_string_total_length(tag, 0); /* assume all are the same size */
+    recordLatency(TagOp::DECODE, 0x8fce, latencyNowNs() - start_ns);
+
+    return 0;
+}
+
+/* fills the tag buffer from values: one raw write for STRING_LGX, plc_tag_set_string per element otherwise */
+static int32_t encodeStringTag(string &error_string, int32_t tag, const vector<string> &values, int elem_count) {
+    int lgx_count = stringLgxCount(tag);
+    if(lgx_count > 0) return encodeStringLgx(error_string, tag, values, min(lgx_count, elem_count));
+
+    int str_total_length = plc_tag_get_string_total_length(tag, 0); /* assume all are the same size */
+    int count = min(elem_count, (int)values.size());
 
-        rc = plc_tag_set_string(tag, str_total_length * i, values[i].c_str());
+    for(int i = 0; i < count; i++) {
+        int32_t rc = plc_tag_set_string(tag, str_total_length * i, values[i].c_str());
         if(rc != PLCTAG_STATUS_OK) {
-            // NOLINTNEXTLINE
-            //fprintf(stderr, "Error setting string %d, error %s!\n", i, plc_tag_decode_error(rc));
             error_string = ssprintf("Error setting string %d, error %s!\n", i, plc_tag_decode_error(rc));
             return rc;
         }
     }
 
+    return PLCTAG_STATUS_OK;
+}
+
+int32_t writeStringTag(string &error_string, int32_t tag, const vector<string> &values, int time_out_ms) {
+    uint64_t start_ns = latencyNowNs();
+
+    auto [rc, elem_size, elem_count] = tagGetSizes(error_string, tag);
+    if(rc != PLCTAG_STATUS_OK) {
+        return rc;
+    }
+
+    rc = encodeStringTag(error_string, tag, values, elem_count);
+    if(rc != PLCTAG_STATUS_OK) {
+        return rc;
+    }
+
+    recordLatency(TagOp::ENCODE, 0x8fce, latencyNowNs() - start_ns);
+
     /* write the data */
-    rc = plc_tag_write(tag, time_out_ms);
+    rc = timedTagWrite(tag, time_out_ms, 0x8fce);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stdout, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
@@ -243,6 +646,618 @@ int32_t writeStringTag(string &error_string, int32_t tag, vector<string> &values
 
 
 
+//===============================================================================================================
+// Cancellable read
+
+#define CANCEL_POLL_MAX_MS 16    /* cancellableTagRead checks after 1ms, then backs off to this */
+
+int32_t cancellableTagRead(int32_t tag, int time_out_ms, uint16_t cip_type, const std::atomic<bool> &cancel) {
+    using namespace std::chrono;
+
+    uint64_t start_ns = latencyNowNs();
+    auto deadline = steady_clock::now() + milliseconds(time_out_ms);
+
+    int poll_ms = 1;
+    int32_t rc = plc_tag_read(tag, 0);
+    while(rc == PLCTAG_STATUS_PENDING) {
+        if(cancel.load()) {
+            plc_tag_abort(tag);
+            return PLCTAG_ERR_ABORT;
+        }
+        if(steady_clock::now() >= deadline) {
+            plc_tag_abort(tag);
+            return PLCTAG_ERR_TIMEOUT;
+        }
+
+        std::this_thread::sleep_for(milliseconds(poll_ms));
+        poll_ms = min(poll_ms * 2, CANCEL_POLL_MAX_MS);
+        rc = plc_tag_status(tag);
+    }
+
+    if(rc == PLCTAG_STATUS_OK) recordLatency(TagOp::READ, cip_type, latencyNowNs() - start_ns);
+    return rc;
+}
+
+
+
+//===============================================================================================================
+// AsyncTagScanner
+
+#define SCAN_POLL_MS 50     /* how long scan() sleeps waiting for a completion before checking timeouts */
+
+/* set by scan() around plc_tag_read(), which delivers the events still pending on the handle itself */
+static thread_local bool scanner_issuing = false;
+
+/*
+ * Runs with the tag API mutex held: only queue the status here.
+ *
+ * A handle that timed out in an earlier scan can still have the READ_COMPLETED of the aborted read pending.
+ * The library delivers it before this read's READ_STARTED, or inside the plc_tag_read() that starts this
+ * read; a real completion only ever comes later from the tickler. Both kinds of leftover are dropped.
+ */
+void AsyncTagScanner::readCallback(int32_t tag, int event, int status, void *userdata) {
+    (void)tag;
+
+    Slot *slot = static_cast<Slot*>(userdata);
+
+    if(event == PLCTAG_EVENT_READ_STARTED) {
+        slot->started_seq = slot->seq;
+        return;
+    }
+
+    if(event != PLCTAG_EVENT_READ_COMPLETED || scanner_issuing || slot->started_seq != slot->seq) return;
+
+    AsyncTagScanner *self = slot->owner;
+    {
+        std::lock_guard<std::mutex> lock(self->completed_mutex);
+        self->completed.emplace_back(slot->index, status);
+    }
+    self->completed_cv.notify_one();
+}
+
+int32_t AsyncTagScanner::scan(string &error_string, const vector<int32_t> &tags,
+                              const CompletionFn &on_complete, const ProgressFn &on_progress,
+                              const vector<uint16_t> &cip_types) {
+    using namespace std::chrono;
+
+    if(window < 1) {
+        error_string = ssprintf("ERROR: scan window must be at least 1, got %d.\n", window);
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    vector<Slot> slots(tags.size());
+    std::deque<size_t> issue_order;   /* in-flight slots, oldest (earliest deadline) first */
+    size_t next = 0;
+    size_t done = 0;
+    int in_flight = 0;
+
+    last_stats = ScanStats();
+    {
+        std::lock_guard<std::mutex> lock(completed_mutex);
+        completed.clear();
+    }
+
+    auto now_ms = [] { return (int64_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count(); };
+    auto start = steady_clock::now();
+
+    auto finish = [&](size_t index, int32_t status) {
+        Slot &slot = slots[index];
+        if(slot.in_flight) {
+            /* after this returns the library will not call back into this slot again */
+            plc_tag_unregister_callback(tags[index]);
+            slot.in_flight = false;
+            in_flight--;
+        }
+
+        last_stats.reads++;
+        if(status != PLCTAG_STATUS_OK) {
+            last_stats.errors++;
+        } else {
+            recordLatency(TagOp::READ, index < cip_types.size() ? cip_types[index] : 0, latencyNowNs() - slot.issued_ns);
+        }
+        last_stats.duration_us = duration_cast<microseconds>(steady_clock::now() - start).count();
+        done++;
+
+        on_complete(index, status);
+        if(on_progress) on_progress(done, last_stats.readRate());
+    };
+
+    while(done < tags.size()) {
+        /* cancelled: abort what is in flight, the rest is never issued */
+        if(cancel_flag && cancel_flag->load()) {
+            for(size_t index : issue_order) {
+                if(!slots[index].in_flight) continue;
+                plc_tag_abort(tags[index]);
+                finish(index, PLCTAG_ERR_ABORT);
+            }
+
+            error_string = ssprintf("Scan cancelled after %zu of %zu reads.\n", done, tags.size());
+            return PLCTAG_ERR_ABORT;
+        }
+
+        /* top up the window */
+        while(next < tags.size() && in_flight < window) {
+            size_t index = next++;
+            Slot &slot = slots[index];
+            /* sequence 0 is never issued, a slot starts out with no read started */
+            if(++next_seq == 0) next_seq = 1;
+            slot = { this, index, now_ms() + time_out_ms, latencyNowNs(), false, next_seq, 0 };
+
+            int32_t rc = plc_tag_register_callback_ex(tags[index], readCallback, &slot);
+            if(rc != PLCTAG_STATUS_OK) {
+                finish(index, rc);
+                continue;
+            }
+            slot.in_flight = true;
+            in_flight++;
+            issue_order.push_back(index);
+
+            scanner_issuing = true;
+            rc = plc_tag_read(tags[index], 0);
+            scanner_issuing = false;
+            if(rc != PLCTAG_STATUS_PENDING) {
+                /* cache hit or immediate failure, nothing will be queued for it */
+                finish(index, rc);
+            }
+        }
+
+        if(in_flight == 0) continue;
+
+        /* wait for completions */
+        std::deque<std::pair<size_t, int32_t>> batch;
+        {
+            std::unique_lock<std::mutex> lock(completed_mutex);
+            completed_cv.wait_for(lock, milliseconds(SCAN_POLL_MS), [this] { return !completed.empty(); });
+            batch.swap(completed);
+        }
+
+        for(auto &[index, status] : batch) {
+            if(slots[index].in_flight) finish(index, status);
+        }
+
+        /* expire anything that has been in flight too long */
+        int64_t now = now_ms();
+        while(!issue_order.empty()) {
+            size_t index = issue_order.front();
+            if(!slots[index].in_flight) {
+                issue_order.pop_front();
+            } else if(slots[index].deadline_ms <= now) {
+                issue_order.pop_front();
+                plc_tag_abort(tags[index]);
+                finish(index, PLCTAG_ERR_TIMEOUT);
+            } else {
+                break;
+            }
+        }
+    }
+
+    if(last_stats.errors > 0) {
+        error_string = ssprintf("%d of %d reads failed.\n", last_stats.errors, last_stats.reads);
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+//===============================================================================================================
+// AsyncTagCreator
+
+/* runs on the library tickler thread with the tag API mutex held: only queue the status here. */
+void AsyncTagCreator::createCallback(int32_t tag, int event, int status, void *userdata) {
+    (void)tag;
+
+    if(event != PLCTAG_EVENT_CREATED) return;
+
+    Slot *slot = static_cast<Slot*>(userdata);
+    AsyncTagCreator *self = slot->owner;
+    {
+        std::lock_guard<std::mutex> lock(self->completed_mutex);
+        self->completed.emplace_back(slot->index, status);
+    }
+    self->completed_cv.notify_one();
+}
+
+int32_t AsyncTagCreator::create(string &error_string, const vector<string> &tagstrings, const vector<uint16_t> &cip_types,
+                                vector<int32_t> &handles, const ProgressFn &on_progress) {
+    using namespace std::chrono;
+
+    if(window < 1) {
+        error_string = ssprintf("ERROR: create window must be at least 1, got %d.\n", window);
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    vector<Slot> slots(tagstrings.size());
+    std::deque<size_t> issue_order;   /* pending slots, oldest (earliest deadline) first */
+    size_t next = 0;
+    size_t done = 0;
+    int in_flight = 0;
+
+    handles.assign(tagstrings.size(), PLCTAG_ERR_ABORT);
+    last_stats = CreateStats();
+    {
+        std::lock_guard<std::mutex> lock(completed_mutex);
+        completed.clear();
+    }
+
+    auto now_ms = [] { return (int64_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count(); };
+    auto start = steady_clock::now();
+
+    auto finish = [&](size_t index, int32_t status) {
+        Slot &slot = slots[index];
+        if(slot.in_flight) {
+            /* after this returns the library will not call back into this slot again */
+            plc_tag_unregister_callback(slot.handle);
+            slot.in_flight = false;
+            in_flight--;
+        }
+
+        last_stats.creates++;
+        if(status == PLCTAG_STATUS_OK) {
+            handles[index] = slot.handle;
+            recordLatency(TagOp::CREATE, index < cip_types.size() ? cip_types[index] : 0, latencyNowNs() - slot.issued_ns);
+        } else {
+            if(slot.handle >= 0) destroyTag(slot.handle);
+            handles[index] = status;
+            last_stats.errors++;
+        }
+        last_stats.duration_us = duration_cast<microseconds>(steady_clock::now() - start).count();
+        done++;
+
+        if(on_progress) on_progress(done, last_stats.createRate());
+    };
+
+    while(done < tagstrings.size()) {
+        /* cancelled: drop what is pending, the rest is never created */
+        if(cancel_flag && cancel_flag->load()) {
+            for(size_t index : issue_order) {
+                if(slots[index].in_flight) finish(index, PLCTAG_ERR_ABORT);
+            }
+
+            error_string = ssprintf("Create cancelled after %zu of %zu tags.\n", done, tagstrings.size());
+            return PLCTAG_ERR_ABORT;
+        }
+
+        /* top up the window */
+        while(next < tagstrings.size() && in_flight < window) {
+            size_t index = next++;
+            Slot &slot = slots[index];
+            string es;
+            slot = { this, index, -1, now_ms() + time_out_ms, latencyNowNs(), false };
+
+            /* the callback may run before this returns, it only queues the index */
+            int32_t tag = createTagWithCallback(es, tagstrings[index], createCallback, &slot, 0,
+                                                index < cip_types.size() ? cip_types[index] : 0);
+            if(tag < 0) {
+                finish(index, tag);
+                continue;
+            }
+            slot.handle = tag;
+            slot.in_flight = true;
+            in_flight++;
+            issue_order.push_back(index);
+        }
+
+        if(in_flight == 0) continue;
+
+        /* wait for completions */
+        std::deque<std::pair<size_t, int32_t>> batch;
+        {
+            std::unique_lock<std::mutex> lock(completed_mutex);
+            completed_cv.wait_for(lock, milliseconds(SCAN_POLL_MS), [this] { return !completed.empty(); });
+            batch.swap(completed);
+        }
+
+        for(auto &[index, status] : batch) {
+            if(slots[index].in_flight) finish(index, status);
+        }
+
+        /* expire anything that has been pending too long */
+        int64_t now = now_ms();
+        while(!issue_order.empty()) {
+            size_t index = issue_order.front();
+            if(!slots[index].in_flight) {
+                issue_order.pop_front();
+            } else if(slots[index].deadline_ms <= now) {
+                issue_order.pop_front();
+                finish(index, PLCTAG_ERR_TIMEOUT);
+            } else {
+                break;
+            }
+        }
+    }
+
+    if(last_stats.errors > 0) {
+        error_string = ssprintf("%d of %d creates failed.\n", last_stats.errors, last_stats.creates);
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+//===============================================================================================================
+// ShardedTag
+
+int32_t ShardedTag::open(string &error_string, const string &gateway, const string &tagname, int count, int elem_size,
+                         const ShardOptions &options, string path, string cpu, string protocol, const string &extra_attrs) {
+    using namespace std::chrono;
+
+    close();
+
+    if(count < 1 || elem_size < 1) {
+        error_string = ssprintf("ERROR: bad element count %d or size %d for %s.\n", count, elem_size, tagname.c_str());
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    elem_count = count;
+    time_out_ms = options.time_out_ms;
+
+    /* "Name" or "Name[first]"; multi dimensional subscripts are not split */
+    string base = tagname;
+    int first = 0;
+    size_t bracket = tagname.rfind('[');
+    bool splittable = protocol == "ab-eip" && tagname.find(',') == string::npos;
+    if(splittable && bracket != string::npos && tagname.back() == ']') {
+        base = tagname.substr(0, bracket);
+        first = atoi(tagname.c_str() + bracket + 1);
+    }
+
+    int shard_elems = options.shard_elems > 0 ? options.shard_elems : max(1, SHARD_DEFAULT_BYTES / elem_size);
+    int connections = max(1, options.connections);
+    if(!splittable) shard_elems = count;
+
+    for(int start = 0; start < count; start += shard_elems) {
+        int n = min(shard_elems, count - start);
+        string name = splittable ? ssprintf("%s[%d]", base.c_str(), first + start) : tagname;
+        string tagstring = buildTagstring(gateway, name, n, path, cpu, protocol);
+
+        if(splittable) tagstring += ssprintf("&connection_group_id=%d", (int)shards.size() % connections);
+        if(!extra_attrs.empty()) tagstring += "&" + extra_attrs;
+
+        /* timeout 0: all shards are created in parallel, waited for below */
+        int32_t tag = createTag(error_string, tagstring, 0);
+        if(tag < 0) {
+            close();
+            return tag;
+        }
+
+        shards.push_back({ tag, start, n });
+        handles.push_back(tag);
+    }
+
+    auto deadline = steady_clock::now() + milliseconds(time_out_ms);
+    for(;;) {
+        bool pending = false;
+
+        for(const auto &shard : shards) {
+            int32_t rc = plc_tag_status(shard.handle);
+            if(rc == PLCTAG_STATUS_PENDING) {
+                pending = true;
+            } else if(rc != PLCTAG_STATUS_OK) {
+                error_string = ssprintf("ERROR %s: Could not create %s shard at %d!\n", plc_tag_decode_error(rc), tagname.c_str(), shard.start);
+                close();
+                return rc;
+            }
+        }
+
+        if(!pending) break;
+
+        if(steady_clock::now() > deadline) {
+            error_string = ssprintf("ERROR: timed out creating the %zu shards of %s!\n", shards.size(), tagname.c_str());
+            close();
+            return PLCTAG_ERR_TIMEOUT;
+        }
+
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+int32_t ShardedTag::read(string &error_string) {
+    int32_t result = PLCTAG_STATUS_OK;
+    string shard_error;
+
+    if(shards.empty()) {
+        error_string = "ERROR: sharded tag is not open.\n";
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    /* every shard in flight at once, the sessions take care of packing/queueing per connection */
+    AsyncTagScanner scanner((int)shards.size(), time_out_ms);
+
+    /* scan() sums up the failures in error_string when it returns, the first failed shard replaces that */
+    int32_t rc = scanner.scan(error_string, handles,
+        [&](size_t index, int32_t status) {
+            if(status != PLCTAG_STATUS_OK && result == PLCTAG_STATUS_OK) {
+                result = status;
+                shard_error = ssprintf("ERROR: Unable to read the shard at element %d! Got error code %d: %s\n",
+                                       shards[index].start, status, plc_tag_decode_error(status));
+            }
+        });
+    last_stats = scanner.stats();
+
+    if(!shard_error.empty()) error_string = shard_error;
+
+    return rc != PLCTAG_STATUS_OK ? rc : result;
+}
+
+void ShardedTag::close() {
+    for(const auto &shard : shards) destroyTag(shard.handle);
+
+    shards.clear();
+    handles.clear();
+    elem_count = 0;
+}
+
+
+
+//===============================================================================================================
+// TagHandleCache
+
+static int64_t cacheNowMs() {
+    using namespace std::chrono;
+    return (int64_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+TagHandleCache &tagHandleCache() {
+    /* never destroyed: plc_tag_shutdown() reclaims the handles at exit and may run before static destructors */
+    static TagHandleCache *cache = new TagHandleCache();
+    return *cache;
+}
+
+/* cache_mutex must be held */
+void TagHandleCache::touch(EntryIt e) {
+    e->last_used_ms = cacheNowMs();
+    lru.splice(lru.begin(), lru, e);
+}
+
+/* cache_mutex must be held. lru is ordered by last use so we can stop at the first young, in-capacity entry. */
+void TagHandleCache::collectEvictable(vector<int32_t> &doomed) {
+    int64_t now = cacheNowMs();
+
+    for(auto it = lru.end(); it != lru.begin();) {
+        --it;
+        bool over = by_key.size() > capacity;
+        bool idle = now - it->last_used_ms >= idle_ms;
+
+        if(!over && !idle) break;
+        if(it->refs > 0) continue;
+
+        doomed.push_back(it->tag);
+        if(!it->stale) by_key.erase(it->key);
+        by_tag.erase(it->tag);
+        it = lru.erase(it);
+    }
+}
+
+int32_t TagHandleCache::acquire(string &error_string, const string &tagstring, int time_out_ms, uint16_t cip_type) {
+    int32_t tag = PLCTAG_ERR_NOT_FOUND;
+    vector<int32_t> doomed;
+
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = by_key.find(tagstring);
+        if(it != by_key.end()) {
+            it->second->refs++;
+            touch(it->second);
+            tag = it->second->tag;
+        }
+    }
+
+    if(tag >= 0) {
+        hit_count++;
+    } else {
+        miss_count++;
+
+        /* create outside the lock, this can take up to time_out_ms */
+        int32_t created = createTag(error_string, tagstring, time_out_ms, cip_type);
+        if(created < 0) return created;
+
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = by_key.find(tagstring);
+        if(it != by_key.end()) {
+            /* somebody else created it while we were waiting */
+            doomed.push_back(created);
+            it->second->refs++;
+            touch(it->second);
+            tag = it->second->tag;
+        } else {
+            lru.push_front({ created, tagstring, 1, false, cacheNowMs() });
+            by_key[tagstring] = lru.begin();
+            by_tag[created] = lru.begin();
+            tag = created;
+        }
+        collectEvictable(doomed);
+    }
+
+    for(int32_t d : doomed) destroyTag(d);
+
+    int32_t rc = plc_tag_lock(tag);
+    if(rc != PLCTAG_STATUS_OK) {
+        /* not locked, so nothing to unlock; a handle that cannot be locked is not handed out again */
+        error_string = ssprintf("ERROR %s: Unable to lock the tag!\n", plc_tag_decode_error(rc));
+        drop(tag, true);
+        return rc;
+    }
+
+    return tag;
+}
+
+void TagHandleCache::release(int32_t tag, bool discard) {
+    plc_tag_unlock(tag);
+    drop(tag, discard);
+}
+
+/* the reference acquire() took, without the unlock */
+void TagHandleCache::drop(int32_t tag, bool discard) {
+    vector<int32_t> doomed;
+
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = by_tag.find(tag);
+        if(it == by_tag.end()) return;
+
+        EntryIt e = it->second;
+        e->refs--;
+        touch(e);
+
+        if(discard && !e->stale) {
+            by_key.erase(e->key);
+            e->stale = true;
+        }
+
+        if(e->stale && e->refs <= 0) {
+            doomed.push_back(e->tag);
+            by_tag.erase(it);
+            lru.erase(e);
+        }
+
+        collectEvictable(doomed);
+    }
+
+    for(int32_t d : doomed) destroyTag(d);
+}
+
+void TagHandleCache::evictIdle() {
+    vector<int32_t> doomed;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        collectEvictable(doomed);
+    }
+    for(int32_t d : doomed) destroyTag(d);
+}
+
+/* drops every handle that is not in use. Handles still referenced are destroyed on release. */
+void TagHandleCache::clear() {
+    vector<int32_t> doomed;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        for(auto it = lru.begin(); it != lru.end();) {
+            if(!it->stale) {
+                by_key.erase(it->key);
+                it->stale = true;
+            }
+            if(it->refs <= 0) {
+                doomed.push_back(it->tag);
+                by_tag.erase(it->tag);
+                it = lru.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for(int32_t d : doomed) destroyTag(d);
+}
+
+size_t TagHandleCache::size() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return by_key.size();
+}
+
+
+
 
 //===============================================================================================================
 
@@ -270,7 +1285,7 @@ PLCTAGT_RESULT readReal32s(string &error_string, string gateway, string tagname,
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xCA);
 
     /* everything OK? */
     if(tag < 0) {
@@ -281,12 +1296,12 @@ PLCTAGT_RESULT readReal32s(string &error_string, string gateway, string tagname,
     }
 
     /* get the data */
-    rc = plc_tag_read(tag, DATA_TIMEOUT);
+    rc = timedTagRead(tag, DATA_TIMEOUT, 0xCA);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         // fprintf(stderr, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
 
@@ -295,7 +1310,7 @@ PLCTAGT_RESULT readReal32s(string &error_string, string gateway, string tagname,
     if(elem_size == 0) {
         //fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
@@ -312,14 +1327,14 @@ PLCTAGT_RESULT readReal32s(string &error_string, string gateway, string tagname,
         if(val == error_sentinal) {
             //fprintf(stderr, "ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
             error_string = ssprintf("ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
-            plc_tag_destroy(tag);
+            tagHandleCache().release(tag);
             return PLCTAGT_RESULT::ERR_TAG_READ;
         }
         values.push_back(val);
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -347,7 +1362,7 @@ PLCTAGT_RESULT writeReal32s(string &error_string, string gateway, string tagname
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xCA);
 
     /* everything OK? */
     if(tag < 0) {
@@ -362,7 +1377,7 @@ PLCTAGT_RESULT writeReal32s(string &error_string, string gateway, string tagname
     if(elem_size == 0) {
         // fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
@@ -375,17 +1390,17 @@ PLCTAGT_RESULT writeReal32s(string &error_string, string gateway, string tagname
         plc_tag_set_float32(tag, (i * elem_size), values[i]);
     }
 
-    rc = plc_tag_write(tag, DATA_TIMEOUT);
+    rc = timedTagWrite(tag, DATA_TIMEOUT, 0xCA);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stderr, "ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -414,7 +1429,7 @@ PLCTAGT_RESULT readReal64s(string &error_string, string gateway, string tagname,
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xCB);
 
     /* everything OK? */
     if(tag < 0) {
@@ -425,12 +1440,12 @@ PLCTAGT_RESULT readReal64s(string &error_string, string gateway, string tagname,
     }
 
     /* get the data */
-    rc = plc_tag_read(tag, DATA_TIMEOUT);
+    rc = timedTagRead(tag, DATA_TIMEOUT, 0xCB);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         // fprintf(stderr, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
 
@@ -439,7 +1454,7 @@ PLCTAGT_RESULT readReal64s(string &error_string, string gateway, string tagname,
     if(elem_size == 0) {
         //fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
@@ -456,14 +1471,14 @@ PLCTAGT_RESULT readReal64s(string &error_string, string gateway, string tagname,
         if(val == error_sentinal) {
             //fprintf(stderr, "ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
             error_string = ssprintf("ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
-            plc_tag_destroy(tag);
+            tagHandleCache().release(tag);
             return PLCTAGT_RESULT::ERR_TAG_READ;
         }
         values.push_back(val);
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -491,7 +1506,7 @@ PLCTAGT_RESULT writeReal64s(string &error_string, string gateway, string tagname
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xCB);
 
     /* everything OK? */
     if(tag < 0) {
@@ -506,7 +1521,7 @@ PLCTAGT_RESULT writeReal64s(string &error_string, string gateway, string tagname
     if(elem_size == 0) {
         // fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
@@ -519,17 +1534,17 @@ PLCTAGT_RESULT writeReal64s(string &error_string, string gateway, string tagname
         plc_tag_set_float64(tag, (i * elem_size), values[i]);
     }
 
-    rc = plc_tag_write(tag, DATA_TIMEOUT);
+    rc = timedTagWrite(tag, DATA_TIMEOUT, 0xCB);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stderr, "ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -558,7 +1573,7 @@ PLCTAGT_RESULT readInt16s(string &error_string, string gateway, string tagname,
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* int rcreate the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xC3);
 
     /* everything OK? */
     if(tag < 0) {
@@ -569,12 +1584,12 @@ PLCTAGT_RESULT readInt16s(string &error_string, string gateway, string tagname,
     }
 
     /* get the data */
-    rc = plc_tag_read(tag, DATA_TIMEOUT);
+    rc = timedTagRead(tag, DATA_TIMEOUT, 0xC3);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         // fprintf(stderr, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
 
@@ -583,7 +1598,7 @@ PLCTAGT_RESULT readInt16s(string &error_string, string gateway, string tagname,
     if(elem_size == 0) {
         //fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
@@ -600,14 +1615,14 @@ PLCTAGT_RESULT readInt16s(string &error_string, string gateway, string tagname,
         if(val == error_sentinal) {
             //fprintf(stderr, "ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
             error_string = ssprintf("ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
-            plc_tag_destroy(tag);
+            tagHandleCache().release(tag);
             return PLCTAGT_RESULT::ERR_TAG_READ;
         }
         values.push_back(val);
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -635,7 +1650,7 @@ PLCTAGT_RESULT writeInt16s(string &error_string, string gateway, string tagname,
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xC3);
 
     /* everything OK? */
     if(tag < 0) {
@@ -650,7 +1665,7 @@ PLCTAGT_RESULT writeInt16s(string &error_string, string gateway, string tagname,
     if(elem_size == 0) {
         // fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
@@ -665,17 +1680,17 @@ PLCTAGT_RESULT writeInt16s(string &error_string, string gateway, string tagname,
         plc_tag_set_int16(tag, (i * elem_size), v);
     }
 
-    rc = plc_tag_write(tag, DATA_TIMEOUT);
+    rc = timedTagWrite(tag, DATA_TIMEOUT, 0xC3);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stderr, "ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -705,7 +1720,7 @@ PLCTAGT_RESULT readInt32s(string &error_string, string gateway, string tagname,
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xC4);
 
     /* everything OK? */
     if(tag < 0) {
@@ -716,12 +1731,12 @@ PLCTAGT_RESULT readInt32s(string &error_string, string gateway, string tagname,
     }
 
     /* get the data */
-    rc = plc_tag_read(tag, DATA_TIMEOUT);
+    rc = timedTagRead(tag, DATA_TIMEOUT, 0xC4);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         // fprintf(stderr, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
 
@@ -730,7 +1745,7 @@ PLCTAGT_RESULT readInt32s(string &error_string, string gateway, string tagname,
     if(elem_size == 0) {
         //fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
@@ -747,14 +1762,14 @@ PLCTAGT_RESULT readInt32s(string &error_string, string gateway, string tagname,
         if(val == error_sentinal) {
             //fprintf(stderr, "ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
             error_string = ssprintf("ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
-            plc_tag_destroy(tag);
+            tagHandleCache().release(tag);
             return PLCTAGT_RESULT::ERR_TAG_READ;
         }
         values.push_back(val);
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -782,7 +1797,7 @@ PLCTAGT_RESULT writeInt32s(string &error_string, string gateway, string tagname,
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xC4);
 
     /* everything OK? */
     if(tag < 0) {
@@ -797,7 +1812,7 @@ PLCTAGT_RESULT writeInt32s(string &error_string, string gateway, string tagname,
     if(elem_size == 0) {
         // fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
@@ -812,17 +1827,17 @@ PLCTAGT_RESULT writeInt32s(string &error_string, string gateway, string tagname,
         plc_tag_set_int32(tag, (i * elem_size), v);
     }
 
-    rc = plc_tag_write(tag, DATA_TIMEOUT);
+    rc = timedTagWrite(tag, DATA_TIMEOUT, 0xC4);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stderr, "ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -851,7 +1866,7 @@ PLCTAGT_RESULT readInt64s(string &error_string, string gateway, string tagname,
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xC5);
 
     /* everything OK? */
     if(tag < 0) {
@@ -862,12 +1877,12 @@ PLCTAGT_RESULT readInt64s(string &error_string, string gateway, string tagname,
     }
 
     /* get the data */
-    rc = plc_tag_read(tag, DATA_TIMEOUT);
+    rc = timedTagRead(tag, DATA_TIMEOUT, 0xC5);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         // fprintf(stderr, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
 
@@ -876,7 +1891,7 @@ PLCTAGT_RESULT readInt64s(string &error_string, string gateway, string tagname,
     if(elem_size == 0) {
         //fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
@@ -893,14 +1908,14 @@ PLCTAGT_RESULT readInt64s(string &error_string, string gateway, string tagname,
         if(val == error_sentinal) {
             //fprintf(stderr, "ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
             error_string = ssprintf("ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
-            plc_tag_destroy(tag);
+            tagHandleCache().release(tag);
             return PLCTAGT_RESULT::ERR_TAG_READ;
         }
         values.push_back(val);
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -928,7 +1943,7 @@ PLCTAGT_RESULT writeInt64s(string &error_string, string gateway, string tagname,
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xC5);
 
     /* everything OK? */
     if(tag < 0) {
@@ -943,7 +1958,7 @@ PLCTAGT_RESULT writeInt64s(string &error_string, string gateway, string tagname,
     if(elem_size == 0) {
         // fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
@@ -958,17 +1973,17 @@ PLCTAGT_RESULT writeInt64s(string &error_string, string gateway, string tagname,
         plc_tag_set_int64(tag, (i * elem_size), v);
     }
 
-    rc = plc_tag_write(tag, DATA_TIMEOUT);
+    rc = timedTagWrite(tag, DATA_TIMEOUT, 0xC5);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stderr, "ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -998,7 +2013,7 @@ PLCTAGT_RESULT readBits(string &error_string, string gateway, string tagname, ve
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xC1);
 
     /* everything OK? */
     if(tag < 0) {
@@ -1009,12 +2024,12 @@ PLCTAGT_RESULT readBits(string &error_string, string gateway, string tagname, ve
     }
 
     /* get the data */
-    rc = plc_tag_read(tag, DATA_TIMEOUT);
+    rc = timedTagRead(tag, DATA_TIMEOUT, 0xC1);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         // fprintf(stderr, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
 
@@ -1023,7 +2038,7 @@ PLCTAGT_RESULT readBits(string &error_string, string gateway, string tagname, ve
     if(elem_size == 0) {
         //fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
@@ -1040,14 +2055,14 @@ PLCTAGT_RESULT readBits(string &error_string, string gateway, string tagname, ve
         if(val == error_sentinal) {
             //fprintf(stderr, "ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
             error_string = ssprintf("ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
-            plc_tag_destroy(tag);
+            tagHandleCache().release(tag);
             return PLCTAGT_RESULT::ERR_TAG_READ;
         }
         values.push_back(val);
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -1075,7 +2090,7 @@ PLCTAGT_RESULT writeBits(string &error_string, string gateway, string tagname, v
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xC1);
 
     /* everything OK? */
     if(tag < 0) {
@@ -1090,7 +2105,7 @@ PLCTAGT_RESULT writeBits(string &error_string, string gateway, string tagname, v
     if(elem_size == 0) {
         // fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
@@ -1104,17 +2119,17 @@ PLCTAGT_RESULT writeBits(string &error_string, string gateway, string tagname, v
         plc_tag_set_bit(tag, (i * elem_size), v);
     }
 
-    rc = plc_tag_write(tag, DATA_TIMEOUT);
+    rc = timedTagWrite(tag, DATA_TIMEOUT, 0xC1);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stderr, "ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -1144,7 +2159,7 @@ PLCTAGT_RESULT readInt8s(string &error_string, string gateway, string tagname, v
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xC2);
 
     /* everything OK? */
     if(tag < 0) {
@@ -1155,12 +2170,12 @@ PLCTAGT_RESULT readInt8s(string &error_string, string gateway, string tagname, v
     }
 
     /* get the data */
-    rc = plc_tag_read(tag, DATA_TIMEOUT);
+    rc = timedTagRead(tag, DATA_TIMEOUT, 0xC2);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         // fprintf(stderr, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
 
@@ -1169,7 +2184,7 @@ PLCTAGT_RESULT readInt8s(string &error_string, string gateway, string tagname, v
     if(elem_size == 0) {
         //fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_READ;
     }
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
@@ -1186,14 +2201,14 @@ PLCTAGT_RESULT readInt8s(string &error_string, string gateway, string tagname, v
         if(val == error_sentinal) {
             //fprintf(stderr, "ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
             error_string = ssprintf("ERROR: Read sentinal value (1.17549e-38) [%s].\n", tagname.c_str());
-            plc_tag_destroy(tag);
+            tagHandleCache().release(tag);
             return PLCTAGT_RESULT::ERR_TAG_READ;
         }
         values.push_back(val);
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -1221,7 +2236,7 @@ PLCTAGT_RESULT writeInt8s(string &error_string, string gateway, string tagname,
     //plc_tag_set_debug_level(PLCTAG_DEBUG_DETAIL);
 
     /* create the tag */
-    tag = plc_tag_create(location.c_str(), DATA_TIMEOUT);
+    tag = tagHandleCache().acquire(error_string, location, DATA_TIMEOUT, 0xC2);
 
     /* everything OK? */
     if(tag < 0) {
@@ -1236,7 +2251,7 @@ PLCTAGT_RESULT writeInt8s(string &error_string, string gateway, string tagname,
     if(elem_size == 0) {
         // fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname [%s].\n", tagname.c_str());
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
@@ -1251,17 +2266,17 @@ PLCTAGT_RESULT writeInt8s(string &error_string, string gateway, string tagname,
         plc_tag_set_int8(tag, (i * elem_size), v);
     }
 
-    rc = plc_tag_write(tag, DATA_TIMEOUT);
+    rc = timedTagWrite(tag, DATA_TIMEOUT, 0xC2);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stderr, "ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        tagHandleCache().release(tag, true);
         return PLCTAGT_RESULT::ERR_TAG_WRITE;
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    tagHandleCache().release(tag);
 
     return PLCTAGT_RESULT::SUCCESS;
 }
@@ -1274,8 +2289,6 @@ PLCTAGT_RESULT writeInt8s(string &error_string, string gateway, string tagname,
 int testStringRead(string &error_string, const char *tag_string, vector<string> &values) {
     int32_t tag = 0;
     int rc;
-    int str_num = 1;
-    int offset = 0;
     int elem_size = 0;
     int elem_count = 0;
 
@@ -1298,14 +2311,14 @@ int testStringRead(string &error_string, const char *tag_string, vector<string>
     plc_tag_set_debug_level(PLCTAG_DEBUG_NONE);
 
     /* loop over the tag strings. */
-    tag = plc_tag_create(tag_string, DATA_TIMEOUT);
+    tag = createTag(error_string, tag_string, DATA_TIMEOUT, 0x8fce);
 
     /* everything OK? */
     if((rc = plc_tag_status(tag)) != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //printf(stderr, "Error creating tag! Error %s\n", plc_tag_decode_error(rc));
         error_string = ssprintf("Error creating tag! Error %s", plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        destroyTag(tag);
         return rc;
     }
 
@@ -1314,62 +2327,31 @@ int testStringRead(string &error_string, const char *tag_string, vector<string>
     if(elem_size == 0) {
         //fprintf(stderr, "ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname.\n");
         error_string = ssprintf("ERROR: elem_size is 0. Can also signify invalid/nonexistent tagname.");
-        plc_tag_destroy(tag);
+        destroyTag(tag);
         return rc;
     }
 
     elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
 
     /* get the data */
-    rc = plc_tag_read(tag, DATA_TIMEOUT);
+    rc = timedTagRead(tag, DATA_TIMEOUT, 0x8fce);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stderr, "ERROR: Unable to read the data for tag! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data for tag! Got error code %d: %s", rc, plc_tag_decode_error(rc));
-        plc_tag_destroy(tag);
+        destroyTag(tag);
         return rc;
     }
 
     /* print out the data */
-    offset = 0;
-    str_num = 1;
-    while(offset < plc_tag_get_size(tag)) {
-        char *str = NULL;
-        int str_cap = plc_tag_get_string_length(tag, offset) + 1; /* +1 for the zero termination. */
-
-        str = (char*)malloc((size_t)(unsigned int)str_cap);
-        if(!str) {
-            // NOLINTNEXTLINE
-            //fprintf(stderr, "Unable to allocate memory for the string %d of tag!\n", str_num);
-            error_string = ssprintf("Unable to allocate memory for the string %d of tag!", str_num);
-            plc_tag_destroy(tag);
-            return PLCTAG_ERR_NO_MEM;
-        }
-
-        rc = plc_tag_get_string(tag, offset, str, str_cap);
-        //rc = plc_tag_set_string(tag, offset, str);
-        if(rc != PLCTAG_STATUS_OK) {
-            // NOLINTNEXTLINE
-            //fprintf(stderr, "Unable to get string %d of tag, got error %s!\n", str_num, plc_tag_decode_error(rc));
-            error_string = ssprintf("Unable to get string %d of tag, got error %s!", str_num, plc_tag_decode_error(rc));
-            free(str);
-            plc_tag_destroy(tag);
-            return rc;
-        }
-
-        // NOLINTNEXTLINE
-        //fprintf(stderr, "tag string %d (%u chars) = '%s'\n", str_num, (unsigned int)strlen(str), str);
-        values.push_back(str);
-
-        free(str);
-
-        str_num++;
-
-        offset += plc_tag_get_string_total_length(tag, offset);
+    rc = decodeStringTag(error_string, tag, values);
+    if(rc != PLCTAG_STATUS_OK) {
+        destroyTag(tag);
+        return rc;
     }
 
     /* we are done */
-    plc_tag_destroy(tag);
+    destroyTag(tag);
 
     return 0;
 }
@@ -1415,15 +2397,12 @@ int writeStringsHack(string &error_string, const string &tag_string, vector<stri
     //srand((unsigned int)(uint64_t)compat_time_ms());
 
     /* create the tag. */
-    if((tag = plc_tag_create(tag_string.c_str(), DATA_TIMEOUT)) < 0) {
-        // NOLINTNEXTLINE
-        //fprintf(stderr, "ERROR %s: Could not create tag!\n", plc_tag_decode_error(tag));
-        error_string = ssprintf("ERROR %s: Could not create tag!\n", plc_tag_decode_error(tag));
-        return rc;
+    if((tag = createTag(error_string, tag_string, DATA_TIMEOUT, 0x8fce)) < 0) {
+        return tag;
     }
 
     // /* get the data */
-    // rc = plc_tag_read(tag, DATA_TIMEOUT);
+    // rc = timedTagRead(tag, DATA_TIMEOUT, 0xC2);
     // if(rc != PLCTAG_STATUS_OK) {
     //     // NOLINTNEXTLINE
     //     //fprintf(stdout, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
@@ -1438,24 +2417,25 @@ int writeStringsHack(string &error_string, const string &tag_string, vector<stri
     /* how many strings do we have? */
     string_count = plc_tag_get_int_attribute(tag, "elem_count", 1);
 
-    /* update the string. */
-    for(int i = 0; i < string_count; i++) {
-        // NOLINTNEXTLINE
-        //compat_snprintf(str, sizeof(str), "string value for element %d is %d.", i, (int)(rand() % 1000));
-        update_string(tag, i, values[i].c_str());
+    /* update the strings, one pass over the buffer */
+    rc = encodeStringTag(error_string, tag, values, string_count);
+    if(rc != PLCTAG_STATUS_OK) {
+        destroyTag(tag);
+        return rc;
     }
 
     /* write the data */
-    rc = plc_tag_write(tag, DATA_TIMEOUT);
+    rc = timedTagWrite(tag, DATA_TIMEOUT, 0x8fce);
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stdout, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
+        destroyTag(tag);
         return rc;
     }
 
     // /* get the data again */
-    // rc = plc_tag_read(tag, DATA_TIMEOUT);
+    // rc = timedTagRead(tag, DATA_TIMEOUT, 0xC2);
     // if(rc != PLCTAG_STATUS_OK) {
     //     // NOLINTNEXTLINE
     //     //fprintf(stdout, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
@@ -1467,7 +2447,7 @@ int writeStringsHack(string &error_string, const string &tag_string, vector<stri
     // printf("\nStrings after update:\n");
     // dump_strings(tag);
 
-    plc_tag_destroy(tag);
+    destroyTag(tag);
 
     return rc;
 }
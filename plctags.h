@@ -2,11 +2,20 @@
 #define PLCTAGS_H
 
 #include <string>
+#include <string_view>
 #include <stdlib.h>
 #include <cmath>
 #include <unordered_map>
 #include <vector>
 #include <array>
+#include <deque>
+#include <list>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <chrono>
 
 #include "utility.h"
 
@@ -17,6 +26,12 @@ using namespace std;
 
 #define REQUIRED_VERSION 2, 4, 0
 #define DATA_TIMEOUT 5000
+#define SCAN_WINDOW 64      /* max async reads in flight per scan */
+#define CREATE_WINDOW 64    /* max async creates in flight, see AsyncTagCreator */
+#define TAG_CACHE_CAPACITY 256      /* handles kept open by the readXxxs/writeXxxs helpers */
+#define TAG_CACHE_IDLE_MS 60000     /* unused handles older than this are destroyed */
+#define SHARD_DEFAULT_BYTES 4000    /* shard size when none is given, about one large connected packet */
+#define SHARD_DEFAULT_CONNECTIONS 4 /* connection_group_id sessions the shards are spread over */
 
 #define DEFAULT_PROTOCOL "ab-eip"
 #define DEFAULT_PATH "1,0"
@@ -38,6 +53,9 @@ using namespace std;
 extern const std::unordered_map<uint16_t, std::string> cip_data_map;
 string getTagType(uint16_t type, string defaultValue = "");
 uint16_t getTagTypeCode(string type);
+/* "Name:TYPE[count]" as given on the command line, TYPE ("?" if missing) and count (1) are optional,
+   Name may be program scoped ("Program:Main.X:DINT") */
+bool parseTagSpec(const string &spec, string &name, string &type, int &count);
 
 string buildTagstring(
     string gateway,
@@ -47,13 +65,19 @@ string buildTagstring(
     string cpu = DEFAULT_CPU,
     string protocol = DEFAULT_PROTOCOL
     );
-int32_t createTag(string &error_string, string tagstring, int time_out_ms = DATA_TIMEOUT);
+int32_t createTag(string &error_string, string tagstring, int time_out_ms = DATA_TIMEOUT, uint16_t cip_type = 0);
+/* the same through plc_tag_create_ex(), callback gets every event from creation on */
+int32_t createTagWithCallback(string &error_string, string tagstring, void (*callback)(int32_t tag, int event, int status, void *userdata),
+                              void *userdata, int time_out_ms = DATA_TIMEOUT, uint16_t cip_type = 0);
 // template <typename T>
 // int32_t readNumericTag(string &error_string, int32_t tag, vector<T> &values, int time_out_ms = DATA_TIMEOUT);
 // template <typename T>
 // int32_t writeNumericTag(string &error_string, int32_t tag, vector<T> &values, int time_out_ms = DATA_TIMEOUT);
 int32_t readStringTag(string &error_string, int32_t tag, vector<string> &values, int time_out_ms = DATA_TIMEOUT);
-int32_t writeStringTag(string &error_string, int32_t tag, vector<string> &values, int time_out_ms = DATA_TIMEOUT);
+int32_t decodeStringTag(string &error_string, int32_t tag, vector<string> &values);
+/* like decodeStringTag, the views stay valid until the next string decode on this thread */
+int32_t decodeStringTagViews(string &error_string, int32_t tag, vector<string_view> &values);
+int32_t writeStringTag(string &error_string, int32_t tag, const vector<string> &values, int time_out_ms = DATA_TIMEOUT);
 
 //maybe move to cpp
 inline array<int32_t, 3> tagGetSizes(string &error_string, int32_t tag) {
@@ -77,6 +101,224 @@ inline array<int32_t, 3> tagGetSizes(string &error_string, int32_t tag) {
     return {0, elem_size, elem_count};
 }
 
+//============================================================================
+// Latency histograms.
+//
+// Log-linear buckets in nanoseconds: below LAT_SUB_BUCKETS every value has its
+// own bucket, above that each power of two is split into LAT_SUB_BUCKETS
+// linear steps (12.5% resolution). record() is a few relaxed atomic adds, so it
+// is safe from any thread, library callbacks included. There is one histogram
+// per operation and CIP type slot, allocated the first time it is recorded to.
+//
+// CREATE is plc_tag_create (which includes the first read on most PLCs), READ
+// is the round trip of a later read, DECODE/ENCODE is the buffer <-> values
+// conversion and WRITE is the plc_tag_write round trip.
+#define LAT_SUB_BITS 3
+#define LAT_SUB_BUCKETS (1 << LAT_SUB_BITS)
+#define LAT_MAX_EXPONENT 40         /* 2^40ns is ~18 minutes, anything longer lands in the last bucket */
+#define LAT_BUCKETS ((LAT_MAX_EXPONENT - LAT_SUB_BITS + 2) * LAT_SUB_BUCKETS)
+#define LAT_TYPE_SLOTS 258          /* atomic CIP types by code, then STRING_LGX, then any other struct */
+#define LAT_SLOT_STRING 256
+#define LAT_SLOT_STRUCT 257
+
+enum class TagOp : uint8_t { CREATE = 0, READ, DECODE, ENCODE, WRITE };
+#define TAG_OP_COUNT 5
+
+class LatencyHistogram {
+public:
+    void record(uint64_t ns);
+    void reset();
+
+    uint64_t count() const { return total_count.load(std::memory_order_relaxed); }
+    uint64_t sumNs() const { return total_ns.load(std::memory_order_relaxed); }
+    uint64_t maxNs() const { return max_ns.load(std::memory_order_relaxed); }
+    uint64_t percentileNs(double p) const;   /* upper edge of the bucket holding the p'th percentile */
+
+    static int bucketFor(uint64_t ns);
+    static uint64_t bucketUpperNs(int bucket);
+
+private:
+    std::atomic<uint64_t> buckets[LAT_BUCKETS]{};
+    std::atomic<uint64_t> total_count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+};
+
+inline uint64_t latencyNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void recordLatency(TagOp op, uint16_t cip_type, uint64_t ns);
+const LatencyHistogram *latencyHistogram(TagOp op, uint16_t cip_type);   /* nullptr until something is recorded */
+void resetLatencies();
+vector<string> latencyReport();     /* header line, then one line per histogram that has samples */
+string latencyReportJson();
+
+// CIP type the numeric codecs use for a value type, for attributing latencies
+template <typename T>
+constexpr uint16_t cipTypeOf() {
+    if        constexpr (std::is_same_v<T, bool>) {
+        return 0xC1;
+    } else if constexpr (std::is_same_v<T, int8_t>) {
+        return 0xC2;
+    } else if constexpr (std::is_same_v<T, int16_t>) {
+        return 0xC3;
+    } else if constexpr (std::is_same_v<T, int32_t>) {
+        return 0xC4;
+    } else if constexpr (std::is_same_v<T, int64_t>) {
+        return 0xC5;
+    } else if constexpr (std::is_same_v<T, uint8_t>) {
+        return 0xC6;
+    } else if constexpr (std::is_same_v<T, uint16_t>) {
+        return 0xC7;
+    } else if constexpr (std::is_same_v<T, uint32_t>) {
+        return 0xC8;
+    } else if constexpr (std::is_same_v<T, uint64_t>) {
+        return 0xC9;
+    } else if constexpr (std::is_same_v<T, float_t>) {
+        return 0xCA;
+    } else if constexpr (std::is_same_v<T, double_t>) {
+        return 0xCB;
+    } else if constexpr (std::is_same_v<T, string>) {
+        return 0x8fce;
+    } else {
+        return 0;
+    }
+}
+
+// plc_tag_read/plc_tag_write that record successful round trips
+inline int32_t timedTagRead(int32_t tag, int time_out_ms, uint16_t cip_type) {
+    uint64_t start_ns = latencyNowNs();
+    int32_t rc = plc_tag_read(tag, time_out_ms);
+    if(rc == PLCTAG_STATUS_OK) recordLatency(TagOp::READ, cip_type, latencyNowNs() - start_ns);
+    return rc;
+}
+
+/* timedTagRead that gives up with PLCTAG_ERR_ABORT, and aborts the read, as soon as cancel is set */
+int32_t cancellableTagRead(int32_t tag, int time_out_ms, uint16_t cip_type, const std::atomic<bool> &cancel);
+
+inline int32_t timedTagWrite(int32_t tag, int time_out_ms, uint16_t cip_type) {
+    uint64_t start_ns = latencyNowNs();
+    int32_t rc = plc_tag_write(tag, time_out_ms);
+    if(rc == PLCTAG_STATUS_OK) recordLatency(TagOp::WRITE, cip_type, latencyNowNs() - start_ns);
+    return rc;
+}
+
+//============================================================================
+// Array codec.
+//
+// plc_tag_get_<type>_array/plc_tag_set_<type>_array move a whole array in one
+// api_mutex round trip instead of one per element, and apply the tag's own
+// byte order in the library, so PLC/5 floats and *_byte_order overrides take
+// the same path. Types without a matching accessor (bool, long double) and
+// tags that refuse it (bit tags) stay on the per-element path.
+//
+// RawByteOrder is still what createTag() records from the tag string, for the
+// STRING_LGX codec below.
+enum class RawByteOrder : uint8_t { UNKNOWN = 0, LITTLE, BIG };
+
+RawByteOrder rawByteOrderFor(const string &tagstring);
+RawByteOrder tagRawByteOrder(int32_t tag);
+void destroyTag(int32_t tag);
+void destroyTags(const vector<int32_t> &tags);     /* one pass over many handles, negative entries are skipped */
+vector<uint8_t> &rawScratchBuffer();
+
+template <typename T>
+inline constexpr bool rawCodecType = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+// the library array accessor for T by size and signedness, PLCTAG_ERR_UNSUPPORTED when there is none
+template <typename T>
+int plcTagGetArray(int32_t tag, T *values, int count) {
+    if constexpr (std::is_floating_point_v<T> && sizeof(T) == 4) {
+        return plc_tag_get_float32_array(tag, 0, reinterpret_cast<float *>(values), count);
+    } else if constexpr (std::is_floating_point_v<T> && sizeof(T) == 8) {
+        return plc_tag_get_float64_array(tag, 0, reinterpret_cast<double *>(values), count);
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 1) {
+        return std::is_signed_v<T> ? plc_tag_get_int8_array(tag, 0, reinterpret_cast<int8_t *>(values), count)
+                                   : plc_tag_get_uint8_array(tag, 0, reinterpret_cast<uint8_t *>(values), count);
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 2) {
+        return std::is_signed_v<T> ? plc_tag_get_int16_array(tag, 0, reinterpret_cast<int16_t *>(values), count)
+                                   : plc_tag_get_uint16_array(tag, 0, reinterpret_cast<uint16_t *>(values), count);
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 4) {
+        return std::is_signed_v<T> ? plc_tag_get_int32_array(tag, 0, reinterpret_cast<int32_t *>(values), count)
+                                   : plc_tag_get_uint32_array(tag, 0, reinterpret_cast<uint32_t *>(values), count);
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 8) {
+        return std::is_signed_v<T> ? plc_tag_get_int64_array(tag, 0, reinterpret_cast<int64_t *>(values), count)
+                                   : plc_tag_get_uint64_array(tag, 0, reinterpret_cast<uint64_t *>(values), count);
+    } else {
+        return PLCTAG_ERR_UNSUPPORTED;
+    }
+}
+
+template <typename T>
+int plcTagSetArray(int32_t tag, const T *values, int count) {
+    if constexpr (std::is_floating_point_v<T> && sizeof(T) == 4) {
+        return plc_tag_set_float32_array(tag, 0, reinterpret_cast<const float *>(values), count);
+    } else if constexpr (std::is_floating_point_v<T> && sizeof(T) == 8) {
+        return plc_tag_set_float64_array(tag, 0, reinterpret_cast<const double *>(values), count);
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 1) {
+        return std::is_signed_v<T> ? plc_tag_set_int8_array(tag, 0, reinterpret_cast<const int8_t *>(values), count)
+                                   : plc_tag_set_uint8_array(tag, 0, reinterpret_cast<const uint8_t *>(values), count);
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 2) {
+        return std::is_signed_v<T> ? plc_tag_set_int16_array(tag, 0, reinterpret_cast<const int16_t *>(values), count)
+                                   : plc_tag_set_uint16_array(tag, 0, reinterpret_cast<const uint16_t *>(values), count);
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 4) {
+        return std::is_signed_v<T> ? plc_tag_set_int32_array(tag, 0, reinterpret_cast<const int32_t *>(values), count)
+                                   : plc_tag_set_uint32_array(tag, 0, reinterpret_cast<const uint32_t *>(values), count);
+    } else if constexpr (std::is_integral_v<T> && sizeof(T) == 8) {
+        return std::is_signed_v<T> ? plc_tag_set_int64_array(tag, 0, reinterpret_cast<const int64_t *>(values), count)
+                                   : plc_tag_set_uint64_array(tag, 0, reinterpret_cast<const uint64_t *>(values), count);
+    } else {
+        return PLCTAG_ERR_UNSUPPORTED;
+    }
+}
+
+// one array call straight into the tail of values
+template <typename T>
+int32_t decodeNumericArray(string &error_string, int32_t tag, vector<T> &values, int elem_count) {
+    size_t first = values.size();
+    values.resize(first + (size_t)elem_count);
+
+    int rc = plcTagGetArray(tag, values.data() + first, elem_count);
+    if(rc != PLCTAG_STATUS_OK) {
+        values.resize(first);
+        error_string = ssprintf("ERROR: Unable to get the array data! Error code %d: %s\n", rc, plc_tag_decode_error(rc));
+        return rc;
+    }
+
+    return 0;
+}
+
+template <typename T>
+int32_t encodeNumericArray(string &error_string, int32_t tag, const vector<T> &values, int elem_count) {
+    int rc = plcTagSetArray(tag, values.data(), elem_count);
+    if(rc != PLCTAG_STATUS_OK) {
+        error_string = ssprintf("ERROR: Unable to set the array data! Error code %d: %s\n", rc, plc_tag_decode_error(rc));
+        return rc;
+    }
+
+    return 0;
+}
+
+//============================================================================
+// STRING_LGX snapshot codec.
+//
+// A Logix STRING element is a 4 byte little endian LEN, 82 data bytes and 2
+// pad bytes. Tags with exactly that layout are decoded from one raw snapshot
+// and encoded into one buffer for a single plc_tag_set_raw_bytes, instead of
+// a string length/get/total length call (and a malloc) per element.
+#define STRING_LGX_DATA_SIZE 82
+#define STRING_LGX_ELEM_SIZE 88
+
+int stringLgxCount(int32_t tag);   /* elem_count when the tag has the layout above, 0 otherwise */
+int32_t decodeStringLgx(string &error_string, int32_t tag, vector<string> &values, int elem_count);
+int32_t encodeStringLgx(string &error_string, int32_t tag, const vector<string> &values, int elem_count);
+
+template <typename T>
+int32_t decodeNumericTag(string &error_string, int32_t tag, vector<T> &values);
+template <typename T>
+int32_t decodeNumericElements(int32_t tag, vector<T> &values, int elem_size, int elem_count);
+
 template <typename T>
 int32_t readNumericTag(string &error_string, int32_t tag, vector<T> &values, int time_out_ms = DATA_TIMEOUT) {
     // int elem_size = 0;
@@ -104,19 +346,48 @@ int32_t readNumericTag(string &error_string, int32_t tag, vector<T> &values, int
     // elem_count = plc_tag_get_int_attribute(tag, "elem_count", 0);
 
     /* get the data */
-    int32_t rc2 = plc_tag_read(tag, time_out_ms);
+    int32_t rc2 = timedTagRead(tag, time_out_ms, cipTypeOf<T>());
     if(rc2 != PLCTAG_STATUS_OK) {
         // fprintf(stderr, "ERROR: Unable to read the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
         error_string = ssprintf("ERROR: Unable to read the data! Got error code %d: %s\n", rc2, plc_tag_decode_error(rc2));
         return rc2;
     }
 
+    return decodeNumericTag(error_string, tag, values);
+}
+
+// pull the values out of a tag whose read has already completed (blocking or async)
+template <typename T>
+int32_t decodeNumericTag(string &error_string, int32_t tag, vector<T> &values) {
+    uint64_t start_ns = latencyNowNs();
     auto [rc, elem_size, elem_count] = tagGetSizes(error_string, tag);
     if(rc != PLCTAG_STATUS_OK) {
         error_string = ssprintf("ERROR: Unable get tag information! Error code %d: %s\n", rc, plc_tag_decode_error(rc));
         return rc;
     }
 
+    if constexpr (rawCodecType<T>) {
+        /* bit tags and the like refuse array access, those fall through to the per-element getters, whose result is the one reported */
+        string array_error;
+        if(elem_size == (int)sizeof(T) && decodeNumericArray(array_error, tag, values, elem_count) == PLCTAG_STATUS_OK) {
+            recordLatency(TagOp::DECODE, cipTypeOf<T>(), latencyNowNs() - start_ns);
+            return 0;
+        }
+    }
+
+    rc = decodeNumericElements(tag, values, elem_size, elem_count);
+    if(rc != PLCTAG_STATUS_OK) {
+        error_string = ssprintf("ERROR: Unable to get the data! Error code %d: %s\n", rc, plc_tag_decode_error(rc));
+        return rc;
+    }
+    recordLatency(TagOp::DECODE, cipTypeOf<T>(), latencyNowNs() - start_ns);
+
+    return rc;
+}
+
+// one plc_tag_get_* call per element, honours whatever byte order the library has for the tag
+template <typename T>
+int32_t decodeNumericElements(int32_t tag, vector<T> &values, int elem_size, int elem_count) {
     /* retrieve the data */
     for(int i = 0; i < elem_count; i++) {
         // NOLINTNEXTLINE
@@ -166,6 +437,7 @@ int32_t readNumericTag(string &error_string, int32_t tag, vector<T> &values, int
 
 template <typename T>
 int32_t writeNumericTag(string &error_string, int32_t tag, vector<T> &values, int time_out_ms = DATA_TIMEOUT) {
+    uint64_t start_ns = latencyNowNs();
 
     auto [rc, elem_size, elem_count] = tagGetSizes(error_string, tag);
     if(rc != PLCTAG_STATUS_OK) {
@@ -181,8 +453,16 @@ int32_t writeNumericTag(string &error_string, int32_t tag, vector<T> &values, in
     //     plc_tag_set_float32(tag, (i * elem_size), values[i]);
     // }
 
+    /* as in decodeNumericTag(), a refused array access falls back to the per-element setters, which report their own errors */
+    bool encoded = false;
+    if constexpr (rawCodecType<T>) {
+        string array_error;
+        encoded = elem_size == (int)sizeof(T) && values.size() >= (size_t)elem_count
+                  && encodeNumericArray(array_error, tag, values, elem_count) == PLCTAG_STATUS_OK;
+    }
+
     /* write the data to the PLC */
-    for(int i = 0; i < elem_count; i++) {
+    for(int i = 0; !encoded && i < elem_count; i++) {
         //T val;
 
         if        constexpr (std::is_same_v<T, int8_t>) {
@@ -226,7 +506,9 @@ int32_t writeNumericTag(string &error_string, int32_t tag, vector<T> &values, in
         }
     }
 
-    rc = plc_tag_write(tag, time_out_ms);
+    recordLatency(TagOp::ENCODE, cipTypeOf<T>(), latencyNowNs() - start_ns);
+
+    rc = timedTagWrite(tag, time_out_ms, cipTypeOf<T>());
     if(rc != PLCTAG_STATUS_OK) {
         // NOLINTNEXTLINE
         //fprintf(stderr, "ERROR: Unable to write the data! Got error code %d: %s\n", rc, plc_tag_decode_error(rc));
@@ -239,6 +521,263 @@ int32_t writeNumericTag(string &error_string, int32_t tag, vector<T> &values, in
 
 
 
+//============================================================================
+// Async scan engine.
+//
+// Keeps up to `window` plc_tag_read(tag, 0) requests in flight so the session
+// can pack them into multi-service requests. Completions arrive on the library
+// callback thread and are queued; on_complete/on_progress always run on the
+// thread that called scan(), so it is safe to decode and touch the UI there.
+struct ScanStats {
+    int32_t reads = 0;
+    int32_t errors = 0;
+    int64_t duration_us = 0;
+
+    double readRate() const {
+        return duration_us > 0 ? reads / (duration_us / 1000000.0) : 0.0;
+    }
+};
+
+class AsyncTagScanner {
+public:
+    using CompletionFn = std::function<void(size_t index, int32_t status)>;
+    using ProgressFn = std::function<void(size_t done, double read_rate)>;
+
+    explicit AsyncTagScanner(int window = SCAN_WINDOW, int time_out_ms = DATA_TIMEOUT)
+        : window(window), time_out_ms(time_out_ms) {}
+
+    /* cip_types, if given, is parallel to tags and only used to file the read latencies */
+    int32_t scan(string &error_string, const vector<int32_t> &tags,
+                 const CompletionFn &on_complete, const ProgressFn &on_progress = nullptr,
+                 const vector<uint16_t> &cip_types = {});
+
+    const ScanStats &stats() const { return last_stats; }
+
+    /* scan() aborts what is in flight and returns PLCTAG_ERR_ABORT once *flag is set */
+    void setCancel(const std::atomic<bool> *flag) { cancel_flag = flag; }
+
+private:
+    struct Slot {
+        AsyncTagScanner *owner;
+        size_t index;
+        int64_t deadline_ms;
+        uint64_t issued_ns;
+        bool in_flight;
+        uint32_t seq;           /* this read, set before the callback is registered */
+        uint32_t started_seq;   /* set by the callback on READ_STARTED */
+    };
+
+    static void readCallback(int32_t tag, int event, int status, void *userdata);
+
+    int window;
+    int time_out_ms;
+    uint32_t next_seq = 0;
+    ScanStats last_stats;
+    const std::atomic<bool> *cancel_flag = nullptr;
+
+    std::mutex completed_mutex;
+    std::condition_variable completed_cv;
+    std::deque<std::pair<size_t, int32_t>> completed;
+};
+
+
+
+//============================================================================
+// Async bulk create.
+//
+// The same window scheme for creating handles: every tag string goes to
+// plc_tag_create_ex() with timeout 0 and a callback that queues the
+// PLCTAG_EVENT_CREATED status, so up to `window` creates (and the first read
+// each create does) share the wire instead of costing a round trip apiece.
+// The callback is unregistered before a handle is handed out, so a scanner
+// can register its own. Failed and timed out creates are destroyed here.
+struct CreateStats {
+    int32_t creates = 0;
+    int32_t errors = 0;
+    int64_t duration_us = 0;
+
+    double createRate() const {
+        return duration_us > 0 ? creates / (duration_us / 1000000.0) : 0.0;
+    }
+};
+
+class AsyncTagCreator {
+public:
+    using ProgressFn = AsyncTagScanner::ProgressFn;
+
+    explicit AsyncTagCreator(int window = CREATE_WINDOW, int time_out_ms = DATA_TIMEOUT)
+        : window(window), time_out_ms(time_out_ms) {}
+
+    /* handles[i] is the handle for tagstrings[i] or its error code; cip_types may be empty */
+    int32_t create(string &error_string, const vector<string> &tagstrings, const vector<uint16_t> &cip_types,
+                   vector<int32_t> &handles, const ProgressFn &on_progress = nullptr);
+
+    const CreateStats &stats() const { return last_stats; }
+
+    /* create() destroys what is pending and returns PLCTAG_ERR_ABORT once *flag is set */
+    void setCancel(const std::atomic<bool> *flag) { cancel_flag = flag; }
+
+private:
+    struct Slot {
+        AsyncTagCreator *owner;
+        size_t index;
+        int32_t handle;
+        int64_t deadline_ms;
+        uint64_t issued_ns;
+        bool in_flight;
+    };
+
+    static void createCallback(int32_t tag, int event, int status, void *userdata);
+
+    int window;
+    int time_out_ms;
+    CreateStats last_stats;
+    const std::atomic<bool> *cancel_flag = nullptr;
+
+    std::mutex completed_mutex;
+    std::condition_variable completed_cv;
+    std::deque<std::pair<size_t, int32_t>> completed;
+};
+
+
+
+//============================================================================
+// Sharded array reads.
+//
+// One big array read goes through one session as a chain of fragmented reads.
+// ShardedTag splits it into element ranges (name[start] with elem_count),
+// spreads those over `connections` sessions via connection_group_id and reads
+// them all at once through AsyncTagScanner. decode() appends the shards in
+// order, so the caller sees one contiguous vector. Only ab-eip arrays with a
+// single dimension are split, anything else is read as one shard.
+//
+// open() creates the shard handles (concurrently) and keeps them, hold on to
+// the ShardedTag for repeated reads so the sessions stay connected.
+struct ShardOptions {
+    int shard_elems = 0;                        /* elements per shard, 0: SHARD_DEFAULT_BYTES worth */
+    int connections = SHARD_DEFAULT_CONNECTIONS;
+    int time_out_ms = DATA_TIMEOUT;
+};
+
+class ShardedTag {
+public:
+    ~ShardedTag() { close(); }
+
+    int32_t open(string &error_string, const string &gateway, const string &tagname, int count, int elem_size,
+                 const ShardOptions &options = ShardOptions(), string path = DEFAULT_PATH, string cpu = DEFAULT_CPU,
+                 string protocol = DEFAULT_PROTOCOL, const string &extra_attrs = "");
+    int32_t read(string &error_string);
+    void close();
+
+    template <typename T>
+    int32_t decode(string &error_string, vector<T> &values) {
+        size_t first = values.size();
+        values.reserve(first + (size_t)elem_count);
+
+        for(const auto &shard : shards) {
+            int32_t rc = decodeNumericTag(error_string, shard.handle, values);
+            if(rc != PLCTAG_STATUS_OK) {
+                values.resize(first);
+                return rc;
+            }
+        }
+
+        return PLCTAG_STATUS_OK;
+    }
+
+    size_t shardCount() const { return shards.size(); }
+    const ScanStats &stats() const { return last_stats; }
+
+private:
+    struct Shard {
+        int32_t handle;
+        int start;
+        int count;
+    };
+
+    vector<Shard> shards;
+    vector<int32_t> handles;
+    int elem_count = 0;
+    int time_out_ms = DATA_TIMEOUT;
+    ScanStats last_stats;
+};
+
+// one shot: open, read, decode and close; use a ShardedTag directly to read the same array repeatedly
+template <typename T>
+int32_t readNumericTagSharded(string &error_string, const string &gateway, const string &tagname, int count, vector<T> &values,
+                              const ShardOptions &options = ShardOptions(), string path = DEFAULT_PATH,
+                              string cpu = DEFAULT_CPU, string protocol = DEFAULT_PROTOCOL) {
+    ShardedTag sharded;
+
+    int32_t rc = sharded.open(error_string, gateway, tagname, count, (int)sizeof(T), options, path, cpu, protocol);
+    if(rc == PLCTAG_STATUS_OK) rc = sharded.read(error_string);
+    if(rc == PLCTAG_STATUS_OK) rc = sharded.decode(error_string, values);
+
+    return rc;
+}
+
+
+
+//============================================================================
+// Tag handle cache.
+//
+// Keeps created tag handles open, keyed by the full tag string, so repeated
+// reads/writes skip plc_tag_create (session lookup, attribute parsing and the
+// create-time first read). acquire() returns the handle locked with
+// plc_tag_lock so concurrent users of the same tag string are serialized;
+// every acquire() must be paired with a release(). Pass discard = true to
+// release() after an error so a broken handle is not handed out again.
+//
+// Unreferenced handles are destroyed when the cache is over capacity (least
+// recently used first) or when they have been idle for idle_ms; the idle ones
+// only when somebody calls evictIdle(), the PlcWorker does between jobs.
+class TagHandleCache {
+public:
+    explicit TagHandleCache(size_t capacity = TAG_CACHE_CAPACITY, int idle_ms = TAG_CACHE_IDLE_MS)
+        : capacity(capacity), idle_ms(idle_ms) {}
+    ~TagHandleCache() { clear(); }
+
+    int32_t acquire(string &error_string, const string &tagstring, int time_out_ms = DATA_TIMEOUT, uint16_t cip_type = 0);
+    void release(int32_t tag, bool discard = false);
+
+    void evictIdle();
+    void clear();
+
+    uint64_t hits() const { return hit_count.load(); }
+    uint64_t misses() const { return miss_count.load(); }
+    size_t size() const;
+
+private:
+    struct Entry {
+        int32_t tag;
+        string key;
+        int refs;
+        bool stale;         /* no longer reachable by key, destroy on last release */
+        int64_t last_used_ms;
+    };
+    using EntryIt = std::list<Entry>::iterator;
+
+    void touch(EntryIt e);
+    void drop(int32_t tag, bool discard);
+    void collectEvictable(vector<int32_t> &doomed);
+
+    size_t capacity;
+    int idle_ms;
+
+    mutable std::mutex cache_mutex;
+    std::list<Entry> lru;    /* front = most recently used */
+    std::unordered_map<string, EntryIt> by_key;
+    std::unordered_map<int32_t, EntryIt> by_tag;
+
+    std::atomic<uint64_t> hit_count{0};
+    std::atomic<uint64_t> miss_count{0};
+};
+
+// shared cache used by the readXxxs/writeXxxs helpers
+TagHandleCache &tagHandleCache();
+
+
+
 //============================================================================
 enum class PLCTAGT_RESULT { SUCCESS=0, ERR_TAG_CREATE, ERR_TAG_READ, ERR_TAG_WRITE };
 
@@ -0,0 +1,641 @@
+#include <libplctag.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "scan_daemon.h"
+#include "plctags.h"
+#include "utility.h"
+
+using namespace std::chrono;
+
+#define SCAN_DAEMON_POLL_MS 50          /* longest wait for a completion while nothing is due */
+#define SCAN_DAEMON_CREATE_POLL_MS 10   /* the same while handles are still being created */
+#define SCAN_DAEMON_RETRY_MIN_MS 1000   /* first create retry after a failure, doubled every time */
+#define SCAN_DAEMON_RETRY_MAX_MS 60000
+#define SCAN_DAEMON_FLUSH_BYTES (64 << 10)
+
+
+static int64_t daemonNowMs() {
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t daemonWallNs() {
+    return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+bool loadScanList(const string &file, vector<ScanListEntry> &entries, string &error_string) {
+    std::ifstream in(file);
+    if(!in) {
+        error_string = ssprintf("Unable to open %s\n", file.c_str());
+        return false;
+    }
+
+    string line;
+    for(int line_no = 1; getline(in, line); line_no++) {
+        size_t hash = line.find('#');
+        if(hash != string::npos) line.resize(hash);
+
+        std::stringstream ss(line);
+        ScanListEntry entry;
+        string type;
+        if(!(ss >> entry.name)) continue;
+
+        if(!(ss >> type >> entry.period_ms >> entry.tagstring)) {
+            error_string = ssprintf("%s:%d: expected NAME TYPE PERIOD_MS TAG_STRING\n", file.c_str(), line_no);
+            return false;
+        }
+        if(entry.period_ms < 1) {
+            error_string = ssprintf("%s:%d: period of %s must be at least 1ms\n", file.c_str(), line_no, entry.name.c_str());
+            return false;
+        }
+
+        entry.cip_type = getTagTypeCode(type);
+        if(!tagCodec(entry.cip_type)) {
+            error_string = ssprintf("%s:%d: no codec for type \"%s\" of %s\n", file.c_str(), line_no, type.c_str(), entry.name.c_str());
+            return false;
+        }
+
+        entries.push_back(entry);
+    }
+
+    if(entries.empty()) {
+        error_string = ssprintf("%s: no tags in the scan list\n", file.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+
+//===============================================================================================================
+// ScanOutput
+
+template <typename T>
+static void putLE(string &out, T value) {
+    char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    std::reverse(bytes, bytes + sizeof(T));
+#endif
+    out.append(bytes, sizeof(T));
+}
+
+static void putJsonString(string &out, const string &s) {
+    out.push_back('"');
+    for(unsigned char c : s) {
+        if(c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back((char)c);
+        } else if(c < 0x20) {
+            out += ssprintf("\\u%04x", c);
+        } else {
+            out.push_back((char)c);
+        }
+    }
+    out.push_back('"');
+}
+
+/* codec output is already a JSON number except for the float specials */
+static void putJsonNumber(string &out, const string &s) {
+    if(s.empty() || s.find_first_of("nN") != string::npos) out += "null";
+    else out += s;
+}
+
+static bool writeAll(int fd, const char *data, size_t len) {
+    while(len > 0) {
+        ssize_t n = write(fd, data, len);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+int32_t ScanOutput::open(string &error_string, ScanFormat new_format, const string &path, const vector<ScanListEntry> &new_entries) {
+    close();
+
+    format = new_format;
+    entries = &new_entries;
+    broken = false;
+
+    if(path.empty()) {
+        if(format == ScanFormat::BINARY) appendDictionary(batch);
+        return PLCTAG_STATUS_OK;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path)) {
+        error_string = ssprintf("ERROR: socket path %s is too long.\n", path.c_str());
+        return PLCTAG_ERR_TOO_LARGE;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listen_fd < 0) {
+        error_string = ssprintf("ERROR: unable to create a socket: %s\n", strerror(errno));
+        return PLCTAG_ERR_CREATE;
+    }
+
+    unlink(path.c_str());
+    if(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+        error_string = ssprintf("ERROR: unable to listen on %s: %s\n", path.c_str(), strerror(errno));
+        ::close(listen_fd);
+        listen_fd = -1;
+        return PLCTAG_ERR_OPEN;
+    }
+
+    socket_path = path;
+
+    return PLCTAG_STATUS_OK;
+}
+
+void ScanOutput::close() {
+    if(listen_fd < 0 && !batch.empty()) flush();
+
+    for(Client &client : clients) ::close(client.fd);
+    clients.clear();
+
+    if(listen_fd >= 0) {
+        ::close(listen_fd);
+        unlink(socket_path.c_str());
+        listen_fd = -1;
+    }
+
+    socket_path.clear();
+    batch.clear();
+}
+
+void ScanOutput::appendDictionary(string &out) const {
+    for(size_t i = 0; i < entries->size(); i++) {
+        const ScanListEntry &entry = (*entries)[i];
+        uint16_t name_len = (uint16_t)min(entry.name.size(), (size_t)UINT16_MAX);
+
+        putLE<uint32_t>(out, 1 + 4 + 2 + 2 + 4 + 2 + name_len);
+        putLE<uint8_t>(out, SCAN_FRAME_TAG);
+        putLE<uint32_t>(out, (uint32_t)i);
+        putLE<uint16_t>(out, entry.cip_type);
+        putLE<uint16_t>(out, 0);
+        putLE<uint32_t>(out, (uint32_t)entry.period_ms);
+        putLE<uint16_t>(out, name_len);
+        out.append(entry.name, 0, name_len);
+    }
+}
+
+void ScanOutput::sample(uint32_t index, int64_t timestamp_ns, int32_t status, int32_t tag, const TagCodec *codec) {
+    const ScanListEntry &entry = (*entries)[index];
+
+    if(format == ScanFormat::BINARY) {
+        /* the frame is built straight from the tag buffer, no copy of it in between */
+        const uint8_t *data = nullptr;
+        int size = 0;
+        bool borrowed = false;
+
+        if(status == PLCTAG_STATUS_OK) {
+            int rc = plc_tag_borrow_data(tag, &data, &size);
+            if(rc == PLCTAG_STATUS_OK) {
+                borrowed = true;
+            } else {
+                status = rc;
+                size = 0;
+            }
+        }
+
+        putLE<uint32_t>(batch, 1 + 4 + 4 + 8 + 4 + (uint32_t)size);
+        putLE<uint8_t>(batch, SCAN_FRAME_SAMPLE);
+        putLE<uint32_t>(batch, index);
+        putLE<int32_t>(batch, status);
+        putLE<int64_t>(batch, timestamp_ns);
+        putLE<uint32_t>(batch, (uint32_t)size);
+        if(size > 0) batch.append((const char *)data, (size_t)size);
+
+        if(borrowed) plc_tag_release_data(tag);
+    } else {
+        values.clear();
+        if(status == PLCTAG_STATUS_OK) {
+            string es;
+            status = codec->decode(es, tag, &values);
+        }
+
+        batch += "{\"ts\":";
+        batch += std::to_string(timestamp_ns);
+        batch += ",\"name\":";
+        putJsonString(batch, entry.name);
+        batch += ",\"period\":";
+        batch += std::to_string(entry.period_ms);
+        batch += ",\"status\":";
+        putJsonString(batch, plc_tag_decode_error(status));
+
+        if(status == PLCTAG_STATUS_OK) {
+            batch += ",\"values\":[";
+            for(size_t i = 0; i < values.size(); i++) {
+                if(i) batch.push_back(',');
+                if(codec->elem_size == 0) putJsonString(batch, values[i]);
+                else putJsonNumber(batch, values[i]);
+            }
+            batch.push_back(']');
+        }
+        batch += "}\n";
+    }
+
+    if(batch.size() >= SCAN_DAEMON_FLUSH_BYTES) flush();
+}
+
+void ScanOutput::acceptClients() {
+    for(;;) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) {
+            if(errno == EINTR) continue;
+            return;
+        }
+
+        Client client{ fd, string() };
+        if(format == ScanFormat::BINARY) appendDictionary(client.pending);
+        clients.push_back(std::move(client));
+    }
+}
+
+void ScanOutput::flush() {
+    if(listen_fd < 0) {
+        if(!batch.empty() && !writeAll(STDOUT_FILENO, batch.data(), batch.size())) broken = true;
+        batch.clear();
+        return;
+    }
+
+    acceptClients();
+
+    size_t kept = 0;
+    for(size_t c = 0; c < clients.size(); c++) {
+        Client &client = clients[c];
+        bool alive = true;
+
+        client.pending += batch;
+        while(alive && !client.pending.empty()) {
+            ssize_t n = send(client.fd, client.pending.data(), client.pending.size(), MSG_NOSIGNAL);
+            if(n > 0) {
+                client.pending.erase(0, (size_t)n);
+            } else if(n < 0 && errno == EINTR) {
+                continue;
+            } else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                alive = false;
+            }
+        }
+
+        /* a reader that cannot keep up is dropped instead of slowing the scan down */
+        if(client.pending.size() > SCAN_DAEMON_CLIENT_BACKLOG) alive = false;
+
+        if(!alive) {
+            ::close(client.fd);
+            continue;
+        }
+        if(kept != c) clients[kept] = std::move(client);
+        kept++;
+    }
+    clients.resize(kept);
+
+    batch.clear();
+}
+
+
+
+//===============================================================================================================
+// ScanDaemon
+
+/* set by issue() around plc_tag_read(), which delivers the events still pending on the handle itself */
+static thread_local bool daemon_issuing = false;
+
+/*
+ * Runs with the tag API mutex held, on the tickler thread or inside plc_tag_read(): only queue the result here.
+ *
+ * READ_STARTED is only raised by plc_tag_read() in issue(), so started_seq is the read being waited for. A
+ * completion that the library still had pending from an aborted read is either delivered before that (old
+ * started_seq) or inside plc_tag_read() itself; a real completion always comes later from the tickler.
+ */
+void ScanDaemon::readCallback(int32_t tag, int event, int status, void *userdata) {
+    (void)tag;
+
+    Item *item = static_cast<Item *>(userdata);
+
+    if(event == PLCTAG_EVENT_READ_STARTED) {
+        item->started_seq = item->seq;
+        return;
+    }
+
+    if(event != PLCTAG_EVENT_READ_COMPLETED || daemon_issuing) return;
+
+    ScanDaemon *self = item->owner;
+    {
+        std::lock_guard<std::mutex> lock(self->completed_mutex);
+        self->completed.push_back({ item->index, item->started_seq, status, daemonWallNs() });
+    }
+    self->completed_cv.notify_one();
+}
+
+int32_t ScanDaemon::open(string &error_string, const vector<ScanListEntry> &entries) {
+    close();
+
+    if(max_in_flight < 1) {
+        error_string = ssprintf("ERROR: in flight limit %d must be at least 1.\n", max_in_flight);
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    /* one scan class per distinct period, fastest first */
+    vector<int> periods;
+    for(const ScanListEntry &entry : entries) periods.push_back(entry.period_ms);
+    sort(periods.begin(), periods.end());
+    periods.erase(unique(periods.begin(), periods.end()), periods.end());
+
+    class_items.assign(periods.size(), {});
+    class_stats.assign(periods.size(), ScanClassStats());
+    for(size_t c = 0; c < periods.size(); c++) class_stats[c].period_ms = periods[c];
+
+    /* items is never resized after this, the callbacks hold pointers into it */
+    items.reserve(entries.size());
+    for(size_t i = 0; i < entries.size(); i++) {
+        const ScanListEntry &entry = entries[i];
+        uint32_t c = (uint32_t)(lower_bound(periods.begin(), periods.end(), entry.period_ms) - periods.begin());
+
+        class_items[c].push_back((uint32_t)i);
+        class_stats[c].tags++;
+
+        /* timeout 0: every create goes out at once, the status is polled below */
+        string es;
+        int32_t handle = createTag(es, entry.tagstring, 0, entry.cip_type);
+        items.push_back({ this, (uint32_t)i, c, tagCodec(entry.cip_type), entry.tagstring, handle,
+                          handle < 0 ? handle : PLCTAG_STATUS_PENDING, false, false, false, 0, 0, 0, 0, 0 });
+    }
+
+    int64_t deadline = daemonNowMs() + time_out_ms;
+    for(bool pending_create = true; pending_create; ) {
+        pending_create = false;
+        int64_t now = daemonNowMs();
+
+        for(Item &item : items) {
+            if(item.create_status != PLCTAG_STATUS_PENDING) continue;
+
+            int32_t rc = plc_tag_status(item.handle);
+            if(rc == PLCTAG_STATUS_PENDING && now < deadline) {
+                pending_create = true;
+                continue;
+            }
+
+            item.create_status = rc == PLCTAG_STATUS_PENDING ? PLCTAG_ERR_TIMEOUT : rc;
+            if(item.create_status == PLCTAG_STATUS_OK) {
+                item.create_status = plc_tag_register_callback_ex(item.handle, readCallback, &item);
+            }
+        }
+
+        if(pending_create) usleep(SCAN_DAEMON_CREATE_POLL_MS * 1000);
+    }
+
+    size_t failed = 0;
+    int64_t now = daemonNowMs();
+    for(Item &item : items) {
+        if(item.create_status == PLCTAG_STATUS_OK) continue;
+
+        createFailed(item, item.create_status, now);
+        retrying.push_back(item.index);
+
+        if(failed++ < 10) {
+            error_string += ssprintf("%s: %s\n", entries[item.index].name.c_str(), plc_tag_decode_error(item.create_status));
+        }
+    }
+    if(failed > 0) {
+        error_string += ssprintf("%zu of %zu tags could not be created.\n", failed, items.size());
+    }
+
+    return failed == items.size() ? PLCTAG_ERR_CREATE : PLCTAG_STATUS_OK;
+}
+
+void ScanDaemon::close() {
+    for(Item &item : items) {
+        if(item.handle < 0) continue;
+
+        plc_tag_unregister_callback(item.handle);
+        if(item.in_flight) plc_tag_abort(item.handle);
+        destroyTag(item.handle);
+    }
+
+    items.clear();
+    retrying.clear();
+    class_items.clear();
+    class_due_ms.clear();
+    pending.clear();
+    issued.clear();
+    in_flight = 0;
+
+    std::lock_guard<std::mutex> lock(completed_mutex);
+    completed.clear();
+}
+
+void ScanDaemon::issue(Item &item, ScanOutput &output) {
+    item.queued = false;
+
+    int32_t rc = item.create_status;
+    if(rc == PLCTAG_STATUS_OK) {
+        item.in_flight = true;
+        item.deadline_ms = daemonNowMs() + time_out_ms;
+        item.seq++;
+
+        daemon_issuing = true;
+        rc = plc_tag_read(item.handle, 0);
+        daemon_issuing = false;
+        if(rc == PLCTAG_STATUS_PENDING) {
+            in_flight++;
+            issued.emplace_back(item.index, item.deadline_ms);
+            return;
+        }
+        item.in_flight = false;
+    }
+
+    /* failed handles and immediate read errors are reported every cycle like any other sample */
+    ScanClassStats &stats = class_stats[item.scan_class];
+    stats.reads++;
+    if(rc != PLCTAG_STATUS_OK) stats.errors++;
+    output.sample(item.index, daemonWallNs(), rc, item.handle, item.codec);
+}
+
+void ScanDaemon::createFailed(Item &item, int32_t status, int64_t now) {
+    if(item.handle >= 0) destroyTag(item.handle);
+    item.handle = -1;
+    item.creating = false;
+    item.create_status = status;
+    item.backoff_ms = item.backoff_ms ? min(item.backoff_ms * 2, SCAN_DAEMON_RETRY_MAX_MS) : SCAN_DAEMON_RETRY_MIN_MS;
+    item.retry_ms = now + item.backoff_ms;
+}
+
+/* starts the creates that are due and polls the ones in progress, returns when it wants to be called again */
+int64_t ScanDaemon::retryCreates(int64_t now) {
+    int64_t next = INT64_MAX;
+    size_t kept = 0;
+
+    for(uint32_t index : retrying) {
+        Item &item = items[index];
+
+        if(!item.creating && now >= item.retry_ms) {
+            /* timeout 0 as in open(), the status is polled on the next calls */
+            string es;
+            int32_t handle = createTag(es, item.tagstring, 0, item.codec->type);
+            if(handle < 0) {
+                createFailed(item, handle, now);
+            } else {
+                item.handle = handle;
+                item.creating = true;
+                item.deadline_ms = now + time_out_ms;
+            }
+        } else if(item.creating) {
+            int32_t rc = plc_tag_status(item.handle);
+            if(rc == PLCTAG_STATUS_OK) rc = plc_tag_register_callback_ex(item.handle, readCallback, &item);
+
+            if(rc == PLCTAG_STATUS_OK) {
+                item.creating = false;
+                item.create_status = PLCTAG_STATUS_OK;
+                item.backoff_ms = 0;
+                continue;
+            }
+            if(rc != PLCTAG_STATUS_PENDING || now >= item.deadline_ms) {
+                createFailed(item, rc == PLCTAG_STATUS_PENDING ? PLCTAG_ERR_TIMEOUT : rc, now);
+            }
+        }
+
+        next = min(next, item.creating ? now + SCAN_DAEMON_CREATE_POLL_MS : item.retry_ms);
+        retrying[kept++] = index;
+    }
+    retrying.resize(kept);
+
+    return next;
+}
+
+void ScanDaemon::printStats(double seconds) const {
+    for(const ScanClassStats &stats : class_stats) {
+        fprintf(stderr, "scan class %6dms %6zu tags %10.1f reads/s %8llu errors %8llu overruns\n", stats.period_ms,
+                stats.tags, stats.reads / seconds, (unsigned long long)stats.errors, (unsigned long long)stats.overruns);
+    }
+}
+
+int32_t ScanDaemon::run(string &error_string, ScanOutput &output, const std::atomic<bool> &stop, int stats_every_s) {
+    if(items.empty()) {
+        error_string = ssprintf("ERROR: no tags to scan.\n");
+        return PLCTAG_ERR_BAD_PARAM;
+    }
+
+    int64_t start = daemonNowMs();
+    int64_t stats_start = start;
+    vector<Completion> batch;
+
+    class_due_ms.assign(class_items.size(), start);
+
+    while(!stop.load()) {
+        if(output.broken) {
+            error_string = ssprintf("ERROR: the output was closed.\n");
+            return PLCTAG_ERR_WRITE;
+        }
+
+        int64_t now = daemonNowMs();
+        int64_t next_retry = retrying.empty() ? INT64_MAX : retryCreates(now);
+
+        for(size_t c = 0; c < class_items.size(); c++) {
+            if(now < class_due_ms[c]) continue;
+
+            ScanClassStats &stats = class_stats[c];
+            for(uint32_t index : class_items[c]) {
+                Item &item = items[index];
+                if(item.in_flight || item.queued) {
+                    stats.overruns++;
+                } else {
+                    item.queued = true;
+                    pending.push_back(index);
+                }
+            }
+            stats.cycles++;
+
+            /* fixed rate, but a class that fell a whole period behind starts over from now */
+            class_due_ms[c] += stats.period_ms;
+            if(class_due_ms[c] <= now) class_due_ms[c] = now + stats.period_ms;
+        }
+
+        while(in_flight < max_in_flight && !pending.empty()) {
+            uint32_t index = pending.front();
+            pending.pop_front();
+            issue(items[index], output);
+        }
+
+        int64_t next_due = now + SCAN_DAEMON_POLL_MS;
+        for(int64_t due : class_due_ms) next_due = min(next_due, due);
+        if(!issued.empty()) next_due = min(next_due, issued.front().second);
+        next_due = min(next_due, next_retry);
+
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(completed_mutex);
+            if(completed.empty() && next_due > now) {
+                completed_cv.wait_for(lock, milliseconds(next_due - now), [this] { return !completed.empty(); });
+            }
+            batch.swap(completed);
+        }
+
+        for(const Completion &done : batch) {
+            Item &item = items[done.index];
+            if(!item.in_flight || done.seq != item.seq) continue;
+
+            item.in_flight = false;
+            in_flight--;
+
+            ScanClassStats &stats = class_stats[item.scan_class];
+            stats.reads++;
+            if(done.status != PLCTAG_STATUS_OK) stats.errors++;
+            output.sample(item.index, done.timestamp_ns, done.status, item.handle, item.codec);
+        }
+
+        /* expire reads that have been in flight too long, oldest first */
+        now = daemonNowMs();
+        while(!issued.empty()) {
+            auto [index, deadline] = issued.front();
+            Item &item = items[index];
+            if(!item.in_flight || item.deadline_ms != deadline) {
+                issued.pop_front();
+            } else if(deadline <= now) {
+                issued.pop_front();
+                plc_tag_abort(item.handle);
+                item.in_flight = false;
+                in_flight--;
+
+                ScanClassStats &stats = class_stats[item.scan_class];
+                stats.reads++;
+                stats.errors++;
+                output.sample(item.index, daemonWallNs(), PLCTAG_ERR_TIMEOUT, item.handle, item.codec);
+            } else {
+                break;
+            }
+        }
+
+        output.flush();
+
+        if(stats_every_s > 0 && now - stats_start >= stats_every_s * 1000) {
+            printStats((now - stats_start) / 1000.0);
+            for(ScanClassStats &stats : class_stats) stats.reads = stats.errors = stats.overruns = 0;
+            stats_start = now;
+        }
+    }
+
+    output.flush();
+
+    return PLCTAG_STATUS_OK;
+}
@@ -0,0 +1,175 @@
+#ifndef SCAN_DAEMON_H
+#define SCAN_DAEMON_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+#include "tag_codec.h"
+
+using namespace std;
+
+#define SCAN_DAEMON_MAX_IN_FLIGHT 256       /* reads outstanding over all scan classes */
+#define SCAN_DAEMON_CLIENT_BACKLOG (8 << 20)    /* bytes a socket client may fall behind before it is dropped */
+
+/* one line of the scan list: NAME TYPE PERIOD_MS TAG_STRING, the data_dumper.conf format */
+struct ScanListEntry {
+    string name;
+    uint16_t cip_type;
+    int period_ms;
+    string tagstring;
+};
+
+bool loadScanList(const string &file, vector<ScanListEntry> &entries, string &error_string);
+
+/*
+ * Where the samples go: stdout, or every client of a Unix socket.
+ *
+ * NDJSON is one object per sample:
+ *   {"ts":<ns since epoch>,"name":"...","period":<ms>,"status":"PLCTAG_STATUS_OK","values":[...]}
+ * values is only there when the read succeeded; strings are JSON strings, NaN and
+ * infinities are null.
+ *
+ * The binary format is a stream of little endian frames:
+ *   u32 length             bytes after this field
+ *   u8  kind               SCAN_FRAME_TAG or SCAN_FRAME_SAMPLE
+ *   tag:     u32 index, u16 cip_type, u16 reserved, u32 period_ms, u16 name_len, name
+ *   sample:  u32 index, i32 status, i64 timestamp_ns, u32 data_len, data
+ * Every reader gets all tag frames first. data is the raw tag buffer, as the
+ * tag codecs read it (little endian for Logix), and is empty for failed reads.
+ */
+enum class ScanFormat : uint8_t { NDJSON, BINARY };
+
+#define SCAN_FRAME_TAG 1
+#define SCAN_FRAME_SAMPLE 2
+
+class ScanOutput {
+public:
+    ~ScanOutput() { close(); }
+
+    /* empty socket_path: stdout */
+    int32_t open(string &error_string, ScanFormat format, const string &socket_path, const vector<ScanListEntry> &entries);
+    void close();
+
+    void sample(uint32_t index, int64_t timestamp_ns, int32_t status, int32_t tag, const TagCodec *codec);
+
+    /* writes what was buffered, and takes on new socket clients */
+    void flush();
+
+    size_t clientCount() const { return clients.size(); }
+    bool broken = false;        /* stdout was closed by the reader */
+
+private:
+    struct Client {
+        int fd;
+        string pending;
+    };
+
+    void appendDictionary(string &out) const;
+    void acceptClients();
+
+    ScanFormat format = ScanFormat::NDJSON;
+    const vector<ScanListEntry> *entries = nullptr;
+    string batch;
+    vector<string> values;
+
+    int listen_fd = -1;
+    string socket_path;
+    vector<Client> clients;
+};
+
+struct ScanClassStats {
+    int period_ms;
+    size_t tags;
+    uint64_t cycles = 0;
+    uint64_t reads = 0;
+    uint64_t errors = 0;
+    uint64_t overruns = 0;      /* tags still in flight when their class came due again */
+};
+
+/*
+ * Polls a scan list forever from one thread.
+ *
+ * Tags with the same period form a scan class. A class comes due every
+ * period (fixed rate, it skips ahead instead of bursting when it falls
+ * behind); its tags are queued and issued while fewer than max_in_flight
+ * reads are outstanding. The library does the I/O on its own threads and the
+ * read callbacks only queue the completion, decoding and output happen here.
+ * A tag whose last read has not come back when its class is due again is
+ * skipped for that cycle and counted as an overrun. A read that times out
+ * is aborted; every issue gets a sequence number so that a late completion
+ * of the aborted read is not taken for the next one. A tag whose handle could
+ * not be created is retried with a backoff that doubles up to a minute, so a
+ * controller that comes up late is picked up without a restart.
+ */
+class ScanDaemon {
+public:
+    explicit ScanDaemon(int max_in_flight = SCAN_DAEMON_MAX_IN_FLIGHT, int time_out_ms = 5000)
+        : max_in_flight(max_in_flight), time_out_ms(time_out_ms) {}
+    ~ScanDaemon() { close(); }
+
+    /* creates every handle at once and waits for them; tags that fail stay in the list, report the error and are created again by run() */
+    int32_t open(string &error_string, const vector<ScanListEntry> &entries);
+    void close();
+
+    /* until stop is set; stats_every_s > 0 prints the scan classes to stderr that often */
+    int32_t run(string &error_string, ScanOutput &output, const std::atomic<bool> &stop, int stats_every_s = 0);
+
+    const vector<ScanClassStats> &classStats() const { return class_stats; }
+
+private:
+    struct Item {
+        ScanDaemon *owner;
+        uint32_t index;
+        uint32_t scan_class;
+        const TagCodec *codec;
+        string tagstring;
+        int32_t handle;
+        int32_t create_status;  /* the last failure until a create succeeds */
+        bool creating;          /* a retry is in progress, deadline_ms is its timeout */
+        bool queued;
+        bool in_flight;
+        int64_t deadline_ms;
+        int64_t retry_ms;       /* next create attempt */
+        int32_t backoff_ms;
+        uint32_t seq;           /* bumped for every read issued, run thread only */
+        uint32_t started_seq;   /* seq of the read the library last started, set by the callback */
+    };
+
+    struct Completion {
+        uint32_t index;
+        uint32_t seq;           /* the read it belongs to, stale ones are dropped */
+        int32_t status;
+        int64_t timestamp_ns;
+    };
+
+    static void readCallback(int32_t tag, int event, int status, void *userdata);
+
+    void issue(Item &item, ScanOutput &output);
+    void createFailed(Item &item, int32_t status, int64_t now);
+    int64_t retryCreates(int64_t now);
+    void printStats(double seconds) const;
+
+    int max_in_flight;
+    int time_out_ms;
+
+    vector<Item> items;
+    vector<vector<uint32_t>> class_items;
+    vector<int64_t> class_due_ms;
+    vector<ScanClassStats> class_stats;
+    vector<uint32_t> retrying;          /* items without a handle yet */
+
+    std::deque<uint32_t> pending;       /* due, waiting for a free slot */
+    std::deque<std::pair<uint32_t, int64_t>> issued;    /* index and deadline in issue order, for the timeout check */
+    int in_flight = 0;
+
+    std::mutex completed_mutex;
+    std::condition_variable completed_cv;
+    vector<Completion> completed;
+};
+
+#endif // SCAN_DAEMON_H
@@ -0,0 +1,451 @@
+#include <libplctag.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "scan_recorder.h"
+#include "plctags.h"
+#include "utility.h"
+
+#define REC_INDEX_BYTES (sizeof(RecBlockHeader) + REC_INDEX_EVERY * sizeof(RecIndexEntry))
+
+static inline uint64_t recAlign(uint64_t n, uint64_t to) { return (n + to - 1) / to * to; }
+
+uint32_t recordedWidth(uint16_t cip_type, int elem_count) {
+    const TagCodec *codec = tagCodec(cip_type);
+    if(!codec || elem_count < 1) return 0;
+
+    return (uint32_t)elem_count * (codec->elem_size ? codec->elem_size : STRING_LGX_ELEM_SIZE);
+}
+
+/* timestamps, then the status bitmap, then the value columns in type order; returns the block size */
+static uint64_t recBlockLayout(const vector<RecordedTag> &tags, uint32_t block_cycles, uint64_t &status_offset,
+                               uint32_t &status_row, vector<uint64_t> &columns) {
+    status_row = (uint32_t)((tags.size() + 7) / 8);
+    status_offset = sizeof(RecBlockHeader) + (uint64_t)block_cycles * sizeof(int64_t);
+
+    vector<size_t> order(tags.size());
+    for(size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return tags[a].cip_type < tags[b].cip_type; });
+
+    uint64_t offset = recAlign(status_offset + (uint64_t)status_row * block_cycles, 8);
+    columns.assign(tags.size(), 0);
+    for(size_t i : order) {
+        columns[i] = offset;
+        offset = recAlign(offset + (uint64_t)tags[i].width * block_cycles, 8);
+    }
+
+    return recAlign(offset, 64);
+}
+
+
+
+//===============================================================================================================
+// ScanRecorder
+
+int32_t ScanRecorder::open(string &error_string, const string &path, const vector<RecordedTag> &tags) {
+    close();
+
+    if(tags.empty()) {
+        error_string = "Nothing to record.\n";
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    widths.clear();
+    uint64_t dict_bytes = 0;
+    for(const auto &t : tags) {
+        if(t.width == 0 || t.name.size() > 0xffff) {
+            error_string = ssprintf("ERROR: cannot record %s, no size for type %X!\n", t.name.c_str(), t.cip_type);
+            return PLCTAG_ERR_BAD_PARAM;
+        }
+        widths.push_back(t.width);
+        dict_bytes += recAlign(sizeof(RecTagEntry) + t.name.size(), 8);
+    }
+
+    block_bytes = recBlockLayout(tags, REC_BLOCK_CYCLES, status_offset, status_row, columns);
+    uint64_t first_block = recAlign(sizeof(RecHeader) + dict_bytes, 64);
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        error_string = ssprintf("ERROR: Unable to create %s: %s\n", path.c_str(), strerror(errno));
+        return PLCTAG_ERR_OPEN;
+    }
+
+    int32_t rc = reserve(error_string, first_block + REC_GROW_BLOCKS * block_bytes + REC_INDEX_BYTES);
+    if(rc != PLCTAG_STATUS_OK) {
+        close();
+        return rc;
+    }
+
+    RecHeader *h = header();
+    memcpy(h->magic, REC_MAGIC, sizeof(h->magic));
+    h->version = REC_VERSION;
+    h->tag_count = (uint32_t)tags.size();
+    h->block_cycles = REC_BLOCK_CYCLES;
+    h->index_every = REC_INDEX_EVERY;
+    h->block_bytes = block_bytes;
+    h->first_block = first_block;
+
+    uint8_t *p = map + sizeof(RecHeader);
+    for(size_t i = 0; i < tags.size(); i++) {
+        RecTagEntry entry = { tags[i].cip_type, (uint16_t)tags[i].name.size(), tags[i].width, columns[i] };
+        memcpy(p, &entry, sizeof(entry));
+        memcpy(p + sizeof(entry), tags[i].name.data(), tags[i].name.size());
+        p += recAlign(sizeof(entry) + tags[i].name.size(), 8);
+    }
+
+    used = first_block;
+    block_offset = 0;
+    slot = 0;
+    last_index = 0;
+    pending_index.clear();
+    pending_index.reserve(REC_INDEX_EVERY);
+
+    return PLCTAG_STATUS_OK;
+}
+
+void ScanRecorder::close() {
+    if(map) {
+        munmap(map, mapped);
+        map = nullptr;
+    }
+
+    if(fd >= 0) {
+        /* drop the unused preallocated tail, the last block stays full size */
+        if(used > 0 && ftruncate(fd, (off_t)used) != 0) { /* the tail is only wasted space */ }
+        ::close(fd);
+        fd = -1;
+    }
+
+    mapped = 0;
+    used = 0;
+}
+
+/* grows file and mapping to at least bytes; offsets stay valid, pointers into the old mapping do not */
+int32_t ScanRecorder::reserve(string &error_string, uint64_t bytes) {
+    if(bytes <= mapped) return PLCTAG_STATUS_OK;
+
+    uint64_t size = max(bytes, mapped + REC_GROW_BLOCKS * block_bytes);
+
+    if(ftruncate(fd, (off_t)size) != 0) {
+        error_string = ssprintf("ERROR: Unable to grow the recording to %llu bytes: %s\n", (unsigned long long)size, strerror(errno));
+        return PLCTAG_ERR_WRITE;
+    }
+
+    if(map) munmap(map, mapped);
+
+    void *m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(m == MAP_FAILED) {
+        map = nullptr;
+        mapped = 0;
+        error_string = ssprintf("ERROR: Unable to map the recording: %s\n", strerror(errno));
+        return PLCTAG_ERR_NO_MEM;
+    }
+
+    map = static_cast<uint8_t *>(m);
+    mapped = size;
+
+    return PLCTAG_STATUS_OK;
+}
+
+void ScanRecorder::writeIndex(uint64_t offset) {
+    RecBlockHeader index = {};
+    index.kind = REC_BLOCK_INDEX;
+    index.count = (uint32_t)pending_index.size();
+    index.prev_index = last_index;
+
+    memcpy(map + offset, &index, sizeof(index));
+    memcpy(map + offset + sizeof(index), pending_index.data(), pending_index.size() * sizeof(RecIndexEntry));
+
+    /* published last, a reader never sees a half written index */
+    header()->last_index = last_index = offset;
+    pending_index.clear();
+}
+
+int32_t ScanRecorder::startBlock(string &error_string) {
+    if(block_offset) {
+        const RecBlockHeader *b = block();
+        pending_index.push_back({ block_offset, b->first_ns, b->last_ns, b->count, 0 });
+    }
+
+    bool index_due = pending_index.size() == REC_INDEX_EVERY;
+
+    int32_t rc = reserve(error_string, used + (index_due ? REC_INDEX_BYTES : 0) + block_bytes);
+    if(rc != PLCTAG_STATUS_OK) return rc;
+
+    if(index_due) {
+        writeIndex(used);
+        used += REC_INDEX_BYTES;
+    }
+
+    block_offset = used;
+    used += block_bytes;
+    slot = 0;
+
+    RecBlockHeader *b = block();
+    memset(b, 0, sizeof(*b));
+    b->kind = REC_BLOCK_DATA;
+
+    return PLCTAG_STATUS_OK;
+}
+
+int32_t ScanRecorder::beginCycle(string &error_string, int64_t timestamp_ns) {
+    if(!map) {
+        error_string = "ERROR: recording is not open.\n";
+        return PLCTAG_ERR_NOT_FOUND;
+    }
+
+    if(block_offset == 0 || slot == REC_BLOCK_CYCLES) {
+        int32_t rc = startBlock(error_string);
+        if(rc != PLCTAG_STATUS_OK) return rc;
+    }
+
+    uint8_t *b = map + block_offset;
+    memcpy(b + sizeof(RecBlockHeader) + (uint64_t)slot * sizeof(int64_t), &timestamp_ns, sizeof(timestamp_ns));
+    memset(b + status_offset + (uint64_t)slot * status_row, 0, status_row);
+
+    if(slot == 0) block()->first_ns = timestamp_ns;
+    block()->last_ns = timestamp_ns;
+
+    return PLCTAG_STATUS_OK;
+}
+
+void ScanRecorder::record(size_t tag_index, int32_t tag, int32_t status) {
+    if(status != PLCTAG_STATUS_OK || tag_index >= widths.size()) return;
+
+    uint8_t *b = map + block_offset;
+    uint8_t *dst = b + columns[tag_index] + (uint64_t)slot * widths[tag_index];
+
+    /* straight from the tag buffer into the mapping; a tag smaller than its column stays failed */
+    if(plc_tag_get_raw_bytes(tag, 0, dst, (int)widths[tag_index]) != PLCTAG_STATUS_OK) return;
+
+    b[status_offset + (uint64_t)slot * status_row + tag_index / 8] |= (uint8_t)(1u << (tag_index % 8));
+}
+
+void ScanRecorder::record(size_t tag_index, const void *data, size_t len) {
+    if(tag_index >= widths.size()) return;
+
+    uint8_t *b = map + block_offset;
+    uint8_t *dst = b + columns[tag_index] + (uint64_t)slot * widths[tag_index];
+    size_t n = min(len, (size_t)widths[tag_index]);
+
+    memcpy(dst, data, n);
+    memset(dst + n, 0, widths[tag_index] - n);
+
+    b[status_offset + (uint64_t)slot * status_row + tag_index / 8] |= (uint8_t)(1u << (tag_index % 8));
+}
+
+void ScanRecorder::endCycle() {
+    if(!map || block_offset == 0) return;
+
+    slot++;
+    block()->count = slot;
+    header()->cycle_count++;
+}
+
+
+
+//===============================================================================================================
+// ScanRecording
+
+int32_t ScanRecording::open(string &error_string, const string &path) {
+    close();
+
+    fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        error_string = ssprintf("ERROR: Unable to open %s: %s\n", path.c_str(), strerror(errno));
+        return PLCTAG_ERR_OPEN;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(RecHeader)) {
+        error_string = ssprintf("ERROR: %s is not a recording.\n", path.c_str());
+        close();
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    mapped = (uint64_t)st.st_size;
+    void *m = mmap(nullptr, mapped, PROT_READ, MAP_SHARED, fd, 0);
+    if(m == MAP_FAILED) {
+        mapped = 0;
+        error_string = ssprintf("ERROR: Unable to map %s: %s\n", path.c_str(), strerror(errno));
+        close();
+        return PLCTAG_ERR_NO_MEM;
+    }
+    map = static_cast<uint8_t *>(m);
+
+    RecHeader h;
+    memcpy(&h, map, sizeof(h));
+    if(memcmp(h.magic, REC_MAGIC, sizeof(h.magic)) != 0 || h.version != REC_VERSION || h.block_cycles == 0 ||
+       h.first_block > mapped) {
+        error_string = ssprintf("ERROR: %s is not a version %d recording.\n", path.c_str(), REC_VERSION);
+        close();
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    /* dictionary */
+    const uint8_t *p = map + sizeof(RecHeader);
+    for(uint32_t i = 0; i < h.tag_count; i++) {
+        RecTagEntry entry;
+        if(p + sizeof(entry) > map + h.first_block) break;
+        memcpy(&entry, p, sizeof(entry));
+        if(p + sizeof(entry) + entry.name_len > map + h.first_block) break;
+
+        tags.push_back({ string(reinterpret_cast<const char *>(p + sizeof(entry)), entry.name_len), entry.cip_type, entry.width });
+        columns.push_back(entry.column);
+        p += recAlign(sizeof(entry) + entry.name_len, 8);
+    }
+
+    vector<uint64_t> check;
+    uint64_t block_bytes = recBlockLayout(tags, h.block_cycles, status_offset, status_row, check);
+    if(tags.size() != h.tag_count || check != columns || block_bytes != h.block_bytes) {
+        error_string = ssprintf("ERROR: %s has a damaged tag dictionary.\n", path.c_str());
+        close();
+        return PLCTAG_ERR_BAD_DATA;
+    }
+    block_cycles = h.block_cycles;
+
+    /*
+     * indexed blocks: newest index first, so collect backwards. The index is written after the blocks it lists
+     * and published last, so anything in it that is not inside the file means damage or truncation; every
+     * block it names must be a whole data block, sample() and friends do not check again.
+     */
+    vector<RecIndexEntry> indexed;
+    bool index_ok = block_bytes <= mapped;
+    for(uint64_t index = h.last_index; index && index_ok; ) {
+        RecBlockHeader ib;
+        if(index < h.first_block || index > mapped - REC_INDEX_BYTES) {
+            index_ok = false;
+            break;
+        }
+        memcpy(&ib, map + index, sizeof(ib));
+        if(ib.kind != REC_BLOCK_INDEX || ib.count > REC_INDEX_EVERY || ib.prev_index >= index) {
+            index_ok = false;
+            break;
+        }
+
+        const RecIndexEntry *entries = reinterpret_cast<const RecIndexEntry *>(map + index + sizeof(ib));
+        for(uint32_t i = 0; i < ib.count && index_ok; i++) {
+            const RecIndexEntry &e = entries[i];
+            index_ok = e.count > 0 && e.count <= block_cycles && e.offset >= h.first_block && e.offset <= mapped - block_bytes;
+            if(index_ok) {
+                RecBlockHeader bh;
+                memcpy(&bh, map + e.offset, sizeof(bh));
+                index_ok = bh.kind == REC_BLOCK_DATA;
+            }
+        }
+        indexed.insert(indexed.begin(), entries, entries + ib.count);
+        index = ib.prev_index;
+    }
+    if(!index_ok) {
+        error_string = ssprintf("ERROR: %s has a damaged or truncated block index.\n", path.c_str());
+        close();
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    uint64_t cycle = 0;
+    for(const auto &e : indexed) {
+        blocks.push_back({ e.offset, cycle, e.first_ns, e.count });
+        cycle += e.count;
+    }
+
+    /* the blocks written since the last index block */
+    uint64_t pos = h.last_index ? h.last_index + REC_INDEX_BYTES : h.first_block;
+    while(pos + block_bytes <= mapped) {
+        RecBlockHeader bh;
+        memcpy(&bh, map + pos, sizeof(bh));
+
+        if(bh.kind == REC_BLOCK_INDEX) {
+            pos += REC_INDEX_BYTES;
+            continue;
+        }
+        if(bh.kind != REC_BLOCK_DATA || bh.count == 0 || bh.count > block_cycles) break;
+
+        blocks.push_back({ pos, cycle, bh.first_ns, bh.count });
+        cycle += bh.count;
+        pos += block_bytes;
+    }
+
+    cycle_total = cycle;
+
+    return PLCTAG_STATUS_OK;
+}
+
+void ScanRecording::close() {
+    if(map) munmap(map, mapped);
+    if(fd >= 0) ::close(fd);
+
+    map = nullptr;
+    mapped = 0;
+    fd = -1;
+    tags.clear();
+    columns.clear();
+    blocks.clear();
+    cycle_total = 0;
+}
+
+const ScanRecording::Block &ScanRecording::blockFor(uint64_t cycle, uint32_t &slot) const {
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), cycle, [](uint64_t c, const Block &b) { return c < b.first_cycle; });
+    const Block &b = *(it - 1);
+
+    slot = (uint32_t)(cycle - b.first_cycle);
+    return b;
+}
+
+int64_t ScanRecording::timestampNs(uint64_t cycle) const {
+    if(cycle >= cycle_total) return 0;
+
+    uint32_t slot;
+    const Block &b = blockFor(cycle, slot);
+
+    int64_t ns;
+    memcpy(&ns, map + b.offset + sizeof(RecBlockHeader) + (uint64_t)slot * sizeof(int64_t), sizeof(ns));
+    return ns;
+}
+
+bool ScanRecording::ok(uint64_t cycle, size_t tag_index) const {
+    if(cycle >= cycle_total || tag_index >= tags.size()) return false;
+
+    uint32_t slot;
+    const Block &b = blockFor(cycle, slot);
+
+    return map[b.offset + status_offset + (uint64_t)slot * status_row + tag_index / 8] & (1u << (tag_index % 8));
+}
+
+const uint8_t *ScanRecording::sample(uint64_t cycle, size_t tag_index) const {
+    if(cycle >= cycle_total || tag_index >= tags.size()) return nullptr;
+
+    uint32_t slot;
+    const Block &b = blockFor(cycle, slot);
+
+    return map + b.offset + columns[tag_index] + (uint64_t)slot * tags[tag_index].width;
+}
+
+void ScanRecording::format(uint64_t cycle, size_t tag_index, vector<string> &values) const {
+    const uint8_t *p = sample(cycle, tag_index);
+    const TagCodec *codec = p ? tagCodec(tags[tag_index].cip_type) : nullptr;
+    if(!codec) return;
+
+    uint32_t elem = codec->elem_size ? codec->elem_size : STRING_LGX_ELEM_SIZE;
+    for(uint32_t off = 0; off + elem <= tags[tag_index].width; off += elem) {
+        values.push_back(codec->format_raw(p + off));
+    }
+}
+
+uint64_t ScanRecording::findCycle(int64_t timestamp_ns) const {
+    if(blocks.empty()) return 0;
+
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), timestamp_ns, [](int64_t t, const Block &b) { return t < b.first_ns; });
+    if(it == blocks.begin()) return 0;
+    const Block &b = *(it - 1);
+
+    const int64_t *ts = reinterpret_cast<const int64_t *>(map + b.offset + sizeof(RecBlockHeader));
+    uint32_t slot = (uint32_t)(std::upper_bound(ts, ts + b.count, timestamp_ns) - ts);
+
+    return b.first_cycle + (slot > 0 ? slot - 1 : 0);
+}
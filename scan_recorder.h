@@ -0,0 +1,177 @@
+#ifndef SCAN_RECORDER_H
+#define SCAN_RECORDER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "tag_codec.h"
+
+using namespace std;
+
+/*
+ * Scan recordings: an append-only, memory mapped, columnar file.
+ *
+ *   header      RecHeader, 64 bytes
+ *   dictionary  one RecTagEntry + name per tag, padded to 8 bytes
+ *   blocks      data blocks of REC_BLOCK_CYCLES scan cycles, with an index
+ *               block after every REC_INDEX_EVERY data blocks
+ *
+ * A data block holds its cycles column by column: the timestamps, a status
+ * bitmap (one row of bits per cycle, set = read OK), then one value column
+ * per tag with the raw tag buffer of every cycle. Value columns are ordered
+ * by type code, so all DINTs of a block are next to each other, then all
+ * REALs, and so on. An index block lists the offset and time range of the
+ * data blocks before it and points to the previous index block, so a reader
+ * finds any cycle by time without touching the data.
+ *
+ * Values are stored as the tag buffer holds them, i.e. little endian for
+ * Logix. Nothing is allocated per cycle: the file grows REC_GROW_BLOCKS
+ * blocks at a time and samples are copied straight into the mapping.
+ */
+
+#define REC_MAGIC "PLCTREC1"
+#define REC_VERSION 1
+#define REC_BLOCK_CYCLES 256        /* scan cycles per data block */
+#define REC_INDEX_EVERY 64          /* data blocks per index block */
+#define REC_GROW_BLOCKS 64          /* data blocks added to the file at a time */
+#define REC_FILE_SUFFIX ".rec"
+
+#define REC_BLOCK_DATA 0x41544144   /* "DATA" */
+#define REC_BLOCK_INDEX 0x58444e49  /* "INDX" */
+
+struct RecHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tag_count;
+    uint32_t block_cycles;
+    uint32_t index_every;
+    uint64_t block_bytes;       /* size of one data block */
+    uint64_t first_block;       /* file offset of the first block */
+    uint64_t last_index;        /* file offset of the newest index block, 0 while there is none */
+    uint64_t cycle_count;       /* committed cycles over all blocks */
+    uint64_t reserved;
+};
+
+struct RecTagEntry {
+    uint16_t cip_type;
+    uint16_t name_len;          /* name bytes follow the entry */
+    uint32_t width;             /* bytes per sample: element size * element count */
+    uint64_t column;            /* offset of the value column inside a data block */
+};
+
+struct RecBlockHeader {
+    uint32_t kind;              /* REC_BLOCK_DATA or REC_BLOCK_INDEX */
+    uint32_t count;             /* cycles in a data block, entries in an index block */
+    int64_t first_ns;           /* data: first and last cycle timestamp */
+    int64_t last_ns;
+    uint64_t prev_index;        /* index: the index block before this one, 0 for none */
+    uint64_t reserved[4];
+};
+
+struct RecIndexEntry {
+    uint64_t offset;
+    int64_t first_ns;
+    int64_t last_ns;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct RecordedTag {
+    string name;
+    uint16_t cip_type;
+    uint32_t width;
+};
+
+/* bytes per sample for count elements of a codec type, 0 if the type has no codec */
+uint32_t recordedWidth(uint16_t cip_type, int elem_count);
+
+
+class ScanRecorder {
+public:
+    ~ScanRecorder() { close(); }
+
+    int32_t open(string &error_string, const string &path, const vector<RecordedTag> &tags);
+    void close();
+    bool isOpen() const { return map != nullptr; }
+
+    /* one scan cycle: begin, record any of the tags (the others stay marked failed), end */
+    int32_t beginCycle(string &error_string, int64_t timestamp_ns);
+    void record(size_t tag_index, int32_t tag, int32_t status);
+    void record(size_t tag_index, const void *data, size_t len);
+    void endCycle();
+
+    uint64_t cycles() const { return map ? header()->cycle_count : 0; }
+    uint64_t bytesUsed() const { return used; }
+
+private:
+    RecHeader *header() const { return reinterpret_cast<RecHeader *>(map); }
+    RecBlockHeader *block() const { return reinterpret_cast<RecBlockHeader *>(map + block_offset); }
+    int32_t reserve(string &error_string, uint64_t bytes);
+    int32_t startBlock(string &error_string);
+    void writeIndex(uint64_t offset);
+
+    int fd = -1;
+    uint8_t *map = nullptr;
+    uint64_t mapped = 0;
+    uint64_t used = 0;              /* end of the last started block */
+
+    vector<uint32_t> widths;
+    vector<uint64_t> columns;
+    uint64_t block_bytes = 0;
+    uint64_t status_offset = 0;     /* of the status bitmap inside a block */
+    uint32_t status_row = 0;        /* bytes per cycle in the bitmap */
+
+    uint64_t block_offset = 0;      /* current data block, 0 before the first */
+    uint32_t slot = 0;              /* cycle slot inside it */
+    vector<RecIndexEntry> pending_index;    /* full blocks since the last index block */
+    uint64_t last_index = 0;
+};
+
+
+class ScanRecording {
+public:
+    ~ScanRecording() { close(); }
+
+    int32_t open(string &error_string, const string &path);
+    void close();
+    bool isOpen() const { return map != nullptr; }
+
+    size_t tagCount() const { return tags.size(); }
+    const RecordedTag &tag(size_t index) const { return tags[index]; }
+    uint64_t cycleCount() const { return cycle_total; }
+
+    int64_t timestampNs(uint64_t cycle) const;
+    bool ok(uint64_t cycle, size_t tag_index) const;
+    const uint8_t *sample(uint64_t cycle, size_t tag_index) const;
+
+    /* the sample formatted with the tag's codec, one string per element */
+    void format(uint64_t cycle, size_t tag_index, vector<string> &values) const;
+
+    /* the last cycle at or before timestamp_ns (0 when it is before the first) */
+    uint64_t findCycle(int64_t timestamp_ns) const;
+
+private:
+    struct Block {
+        uint64_t offset;
+        uint64_t first_cycle;
+        int64_t first_ns;
+        uint32_t count;
+    };
+
+    const Block &blockFor(uint64_t cycle, uint32_t &slot) const;
+
+    int fd = -1;
+    uint8_t *map = nullptr;
+    uint64_t mapped = 0;
+
+    vector<RecordedTag> tags;
+    vector<uint64_t> columns;
+    vector<Block> blocks;
+    uint64_t status_offset = 0;
+    uint32_t status_row = 0;
+    uint32_t block_cycles = 0;
+    uint64_t cycle_total = 0;
+};
+
+#endif // SCAN_RECORDER_H
@@ -0,0 +1,188 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "utility.h"
+#include "plctags.h"
+#include "plant_scan.h"
+
+
+#define SWEEP_USAGE \
+    "Usage: plctagt sweep --config FILE [options]\n" \
+    "  --config FILE       controllers and their tags, see below\n" \
+    "  --sweeps N          sweeps to run, handles are reused after the first (default 1)\n" \
+    "  --max-in-flight N   outstanding requests over all controllers (default 256)\n" \
+    "  --window N          outstanding requests per controller (default 32)\n" \
+    "  --timeout MS        per request timeout (default 5000)\n" \
+    "  --values            print every value of the last sweep\n" \
+    "\n" \
+    "Config file, one entry per line, # starts a comment:\n" \
+    "  controller NAME GATEWAY [PATH [CPU [ATTRS]]]\n" \
+    "  tag Name:TYPE[count]          belongs to the controller above it\n"
+
+
+static bool loadSweepConfig(const string &file, vector<PlantController> &controllers, string &error_string) {
+    std::ifstream in(file);
+    if(!in) {
+        error_string = ssprintf("Unable to open %s\n", file.c_str());
+        return false;
+    }
+
+    string line;
+    for(int line_no = 1; getline(in, line); line_no++) {
+        size_t hash = line.find('#');
+        if(hash != string::npos) line.resize(hash);
+
+        std::stringstream ss(line);
+        string keyword;
+        if(!(ss >> keyword)) continue;
+
+        if(keyword == "controller") {
+            PlantController pc;
+            if(!(ss >> pc.name >> pc.gateway)) {
+                error_string = ssprintf("%s:%d: controller needs a name and a gateway\n", file.c_str(), line_no);
+                return false;
+            }
+            string value;
+            if(ss >> value) pc.path = value;
+            if(ss >> value) pc.cpu = value;
+            if(ss >> value) pc.attrs = value;
+
+            controllers.push_back(pc);
+        } else if(keyword == "tag") {
+            string spec, type;
+            PlantTag pt;
+
+            if(controllers.empty()) {
+                error_string = ssprintf("%s:%d: tag before the first controller\n", file.c_str(), line_no);
+                return false;
+            }
+            if(!(ss >> spec) || !parseTagSpec(spec, pt.name, type, pt.count)) {
+                error_string = ssprintf("%s:%d: bad tag spec \"%s\"\n", file.c_str(), line_no, spec.c_str());
+                return false;
+            }
+
+            pt.cip_type = getTagTypeCode(type);
+            if(!tagCodec(pt.cip_type)) {
+                error_string = ssprintf("%s:%d: no codec for type \"%s\" of %s\n", file.c_str(), line_no, type.c_str(), pt.name.c_str());
+                return false;
+            }
+
+            controllers.back().tags.push_back(pt);
+        } else {
+            error_string = ssprintf("%s:%d: unknown keyword \"%s\"\n", file.c_str(), line_no, keyword.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+int sweep(int argc, char **argv) {
+    string config, es;
+    int sweeps = 1;
+    int max_in_flight = PLANT_MAX_IN_FLIGHT;
+    int window = PLANT_CONTROLLER_WINDOW;
+    int time_out_ms = DATA_TIMEOUT;
+    bool values = false;
+
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if(arg == "--help" || arg == "-h") {
+            fputs(SWEEP_USAGE, stdout);
+            return 0;
+        } else if(arg == "--values") {
+            values = true;
+            continue;
+        } else if(i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n%s", arg.c_str(), SWEEP_USAGE);
+            return 1;
+        }
+
+        string value = argv[++i];
+        if(arg == "--config") {
+            config = value;
+        } else if(arg == "--sweeps") {
+            sweeps = max(1, atoi(value.c_str()));
+        } else if(arg == "--max-in-flight") {
+            max_in_flight = max(1, atoi(value.c_str()));
+        } else if(arg == "--window") {
+            window = max(1, atoi(value.c_str()));
+        } else if(arg == "--timeout") {
+            time_out_ms = max(1, atoi(value.c_str()));
+        } else {
+            fprintf(stderr, "Unknown option %s\n%s", arg.c_str(), SWEEP_USAGE);
+            return 1;
+        }
+    }
+
+    vector<PlantController> controllers;
+    if(config.empty()) {
+        fprintf(stderr, "No --config given.\n%s", SWEEP_USAGE);
+        return 1;
+    }
+    if(!loadSweepConfig(config, controllers, es)) {
+        fputs(es.c_str(), stderr);
+        return 1;
+    }
+
+    PlantScanner scanner(max_in_flight, window, time_out_ms);
+    PlantResultStore store;
+    int32_t errors = 0;
+
+    scanner.open(controllers);
+
+    printf("%zu controllers, max in flight %d, window %d\n", controllers.size(), max_in_flight, window);
+    printf("%-6s %-16s %-22s %6s %7s %10s\n", "SWEEP", "CONTROLLER", "GATEWAY", "TAGS", "ERRORS", "TIME(ms)");
+
+    for(int s = 1; s <= sweeps; s++) {
+        es.clear();
+        int32_t rc = scanner.sweep(es, store);
+        if(rc != PLCTAG_STATUS_OK) {
+            fputs(es.c_str(), stderr);
+            return 1;
+        }
+
+        /* per controller time against the wall time of the whole sweep: the sweep should be about the slowest one */
+        const vector<PlantControllerStats> &stats = scanner.controllerStats();
+        int64_t sum_us = 0, slowest_us = 0;
+        errors = 0;
+
+        for(size_t c = 0; c < controllers.size(); c++) {
+            printf("%-6d %-16s %-22s %6d %7d %10.1f\n", s, controllers[c].name.c_str(), controllers[c].gateway.c_str(),
+                   stats[c].reads, stats[c].errors, stats[c].duration_us / 1000.0);
+            sum_us += stats[c].duration_us;
+            slowest_us = max(slowest_us, stats[c].duration_us);
+            errors += stats[c].errors;
+        }
+
+        printf("%-6d %-16s sweep %.1fms, slowest controller %.1fms, sum of controllers %.1fms\n", s, "ALL",
+               scanner.durationUs() / 1000.0, slowest_us / 1000.0, sum_us / 1000.0);
+    }
+
+    if(values) {
+        vector<string> lines;
+        store.forEach([&](const string &controller, const string &tag, const PlantValue &value) {
+            string text;
+            if(value.status != PLCTAG_STATUS_OK) {
+                text = plc_tag_decode_error(value.status);
+            } else {
+                for(size_t i = 0; i < value.values.size(); i++) text += (i ? " " : "") + value.values[i];
+            }
+            lines.push_back(ssprintf("%s/%s = %s", controller.c_str(), tag.c_str(), text.c_str()));
+        });
+
+        sort(lines.begin(), lines.end());
+        for(const auto &line : lines) printf("%s\n", line.c_str());
+    }
+
+    scanner.close();
+
+    return errors > 0 ? 2 : 0;
+}
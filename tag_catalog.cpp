@@ -0,0 +1,324 @@
+#include <libplctag.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+
+#include "tag_catalog.h"
+
+
+#define NO_STRING ((uint32_t)0xFFFFFFFF)
+
+
+struct catalog_header_s {
+    char magic[4];
+    uint32_t version;
+    uint32_t endian_check;      /* 0x01020304 written in host order */
+    uint32_t listing_size;
+    uint32_t program_count;
+    uint32_t tag_count;
+    uint32_t udt_count;
+    uint32_t field_count;
+    uint32_t strings_size;
+    uint32_t reserved;
+    uint64_t listing_hash;      /* tagCatalogHash() of the controller listing */
+};
+
+struct catalog_tag_s {
+    uint32_t name;
+    uint32_t parent_name;
+    uint16_t instance_id;
+    uint16_t type;
+    uint16_t elem_size;
+    uint16_t elem_count;
+    uint16_t num_dimensions;
+    uint16_t dimensions[3];
+};
+
+struct catalog_udt_s {
+    uint32_t name;
+    uint16_t id;
+    uint16_t struct_handle;
+    uint32_t instance_size;
+    uint32_t num_fields;
+};
+
+struct catalog_field_s {
+    uint32_t name;
+    uint16_t type;
+    uint16_t metadata;
+    uint32_t offset;
+};
+
+
+/* appends s to the string table, "" always maps to offset 0 */
+static uint32_t add_string(std::string &strings, std::string_view s) {
+    if(s.empty()) { return 0; }
+
+    uint32_t offset = (uint32_t)strings.size();
+    strings.append(s);
+    strings.push_back('\0');
+
+    return offset;
+}
+
+
+static const char *get_string(const char *strings, uint32_t strings_size, uint32_t offset) {
+    if(offset == NO_STRING || offset >= strings_size) { return NULL; }
+    return strings + offset;
+}
+
+
+static int make_dirs(const std::string &dir) {
+    for(size_t pos = 1; pos <= dir.size(); pos++) {
+        if(pos == dir.size() || dir[pos] == '/') {
+            std::string part = dir.substr(0, pos);
+            if(mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) { return PLCTAG_ERR_CREATE; }
+        }
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+std::string tagCatalogPath(const std::string &gateway, const std::string &path) {
+    std::string dir;
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if(xdg && *xdg) {
+        dir = std::string(xdg) + "/plctagt";
+    } else if(home && *home) {
+        dir = std::string(home) + "/.cache/plctagt";
+    } else {
+        return "";
+    }
+
+    std::string key = gateway + "_" + path;
+    for(char &c : key) {
+        if(!isalnum((unsigned char)c) && c != '.' && c != '-') { c = '_'; }
+    }
+
+    return dir + "/catalog_" + key + ".bin";
+}
+
+
+uint64_t tagCatalogHash(const uint8_t *data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for(size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+
+int loadTagCatalog(const std::string &file, uint32_t listing_size, uint64_t listing_hash, const std::vector<std::string> &programs,
+                   TagTable &tagtable, std::vector<UdtEntry> &udtentries) {
+    int rc = PLCTAG_STATUS_OK;
+    struct stat st;
+
+    if(file.empty()) { return PLCTAG_ERR_NOT_FOUND; }
+
+    int fd = open(file.c_str(), O_RDONLY);
+    if(fd < 0) { return PLCTAG_ERR_NOT_FOUND; }
+
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(catalog_header_s)) {
+        close(fd);
+        return PLCTAG_ERR_BAD_DATA;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) { return PLCTAG_ERR_OPEN; }
+
+    const uint8_t *base = (const uint8_t *)map;
+    const catalog_header_s *header = (const catalog_header_s *)base;
+
+    do {
+        if(memcmp(header->magic, TAG_CATALOG_MAGIC, 4) != 0 || header->version != TAG_CATALOG_VERSION
+           || header->endian_check != 0x01020304) {
+            rc = PLCTAG_ERR_BAD_DATA;
+            break;
+        }
+
+        /* cheap revalidation first: the controller listing and program list must not have changed. */
+        if(header->listing_size != listing_size || header->listing_hash != listing_hash
+           || header->program_count != programs.size()) {
+            rc = PLCTAG_ERR_NO_MATCH;
+            break;
+        }
+
+        uint64_t expected = sizeof(catalog_header_s) + (uint64_t)header->program_count * sizeof(uint32_t)
+                            + (uint64_t)header->tag_count * sizeof(catalog_tag_s)
+                            + (uint64_t)header->udt_count * sizeof(catalog_udt_s)
+                            + (uint64_t)header->field_count * sizeof(catalog_field_s) + header->strings_size;
+        if(expected != size || header->strings_size == 0) {
+            rc = PLCTAG_ERR_BAD_DATA;
+            break;
+        }
+
+        const uint32_t *program_names = (const uint32_t *)(base + sizeof(catalog_header_s));
+        const catalog_tag_s *tags = (const catalog_tag_s *)(program_names + header->program_count);
+        const catalog_udt_s *udts = (const catalog_udt_s *)(tags + header->tag_count);
+        const catalog_field_s *fields = (const catalog_field_s *)(udts + header->udt_count);
+        const char *strings = (const char *)(fields + header->field_count);
+        uint32_t strings_size = header->strings_size;
+
+        if(strings[strings_size - 1] != '\0') {
+            rc = PLCTAG_ERR_BAD_DATA;
+            break;
+        }
+
+        for(uint32_t i = 0; i < header->program_count && rc == PLCTAG_STATUS_OK; i++) {
+            const char *name = get_string(strings, strings_size, program_names[i]);
+            if(!name || programs[i] != name) { rc = PLCTAG_ERR_NO_MATCH; }
+        }
+        if(rc != PLCTAG_STATUS_OK) { break; }
+
+        TagTable new_tags;
+        new_tags.reserve(header->tag_count, strings_size);
+        for(uint32_t i = 0; i < header->tag_count && rc == PLCTAG_STATUS_OK; i++) {
+            const catalog_tag_s *t = &tags[i];
+            const char *name = get_string(strings, strings_size, t->name);
+            const char *parent = get_string(strings, strings_size, t->parent_name);
+
+            if(!name || !parent) {
+                rc = PLCTAG_ERR_BAD_DATA;
+                break;
+            }
+
+            new_tags.add(name, parent, t->instance_id, t->type, t->elem_size, t->elem_count, t->num_dimensions, t->dimensions);
+        }
+        if(rc != PLCTAG_STATUS_OK) { break; }
+
+        std::vector<UdtEntry> new_udts;
+        new_udts.reserve(header->udt_count);
+        uint32_t next_field = 0;
+        for(uint32_t i = 0; i < header->udt_count && rc == PLCTAG_STATUS_OK; i++) {
+            const catalog_udt_s *u = &udts[i];
+            const char *name = get_string(strings, strings_size, u->name);
+
+            if(!name || u->num_fields > header->field_count - next_field) {
+                rc = PLCTAG_ERR_BAD_DATA;
+                break;
+            }
+
+            UdtEntry udt = {name, u->id, u->struct_handle, u->instance_size, {}};
+            udt.fields.reserve(u->num_fields);
+            for(uint32_t f = 0; f < u->num_fields; f++) {
+                const catalog_field_s *field = &fields[next_field++];
+                const char *field_name = get_string(strings, strings_size, field->name);
+
+                udt.fields.push_back({field_name ? field_name : "", field->type, field->metadata, field->offset});
+            }
+
+            new_udts.push_back(std::move(udt));
+        }
+        if(rc != PLCTAG_STATUS_OK) { break; }
+
+        tagtable.append(new_tags);
+        udtentries.insert(udtentries.end(), new_udts.begin(), new_udts.end());
+    } while(0);
+
+    munmap(map, size);
+
+    return rc;
+}
+
+
+int saveTagCatalog(const std::string &file, uint32_t listing_size, uint64_t listing_hash, const std::vector<std::string> &programs,
+                   const TagTable &tagtable, const std::vector<UdtEntry> &udtentries) {
+    std::string strings(1, '\0');
+    std::vector<uint32_t> program_names;
+    std::vector<catalog_tag_s> tags;
+    std::vector<catalog_udt_s> udts;
+    std::vector<catalog_field_s> fields;
+
+    if(file.empty()) { return PLCTAG_ERR_NOT_FOUND; }
+
+    for(const auto &p : programs) { program_names.push_back(add_string(strings, p)); }
+
+    /* parents are interned in the table, write each of them once too */
+    std::unordered_map<std::string_view, uint32_t> parents;
+    for(size_t row = 0; row < tagtable.size(); row++) {
+        std::string_view parent = tagtable.parent(row);
+        auto it = parents.find(parent);
+        if(it == parents.end()) { it = parents.emplace(parent, add_string(strings, parent)).first; }
+
+        tags.push_back({add_string(strings, tagtable.name(row)), it->second, tagtable.instanceId(row), tagtable.type(row),
+                        tagtable.elemSize(row), tagtable.elemCount(row), tagtable.numDimensions(row),
+                        {tagtable.dimension(row, 0), tagtable.dimension(row, 1), tagtable.dimension(row, 2)}});
+    }
+
+    for(const auto &u : udtentries) {
+        udts.push_back({add_string(strings, u.name), u.id, u.struct_handle, u.instance_size, (uint32_t)u.fields.size()});
+        for(const auto &f : u.fields) {
+            fields.push_back({f.name.empty() ? NO_STRING : add_string(strings, f.name), f.type, f.metadata, f.offset});
+        }
+    }
+
+    catalog_header_s header;
+    memcpy(header.magic, TAG_CATALOG_MAGIC, 4);
+    header.version = TAG_CATALOG_VERSION;
+    header.endian_check = 0x01020304;
+    header.listing_size = listing_size;
+    header.program_count = (uint32_t)program_names.size();
+    header.tag_count = (uint32_t)tags.size();
+    header.udt_count = (uint32_t)udts.size();
+    header.field_count = (uint32_t)fields.size();
+    header.strings_size = (uint32_t)strings.size();
+    header.reserved = 0;
+    header.listing_hash = listing_hash;
+
+    size_t slash = file.rfind('/');
+    if(slash != std::string::npos && make_dirs(file.substr(0, slash)) != PLCTAG_STATUS_OK) { return PLCTAG_ERR_CREATE; }
+
+    /*
+     * write a temporary file and rename it so a reader never maps a half written catalog. mkstemp gives
+     * every writer its own file, two instances listing the same PLC do not write into each other's.
+     */
+    std::string tmp = file + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    if(fd < 0) { return PLCTAG_ERR_OPEN; }
+
+    /* mkstemp creates it 0600, the catalog is as readable as any other file */
+    mode_t mask = umask(0);
+    umask(mask);
+    if(fchmod(fd, 0666 & ~mask) != 0) { /* only the permissions, the catalog is still fine */ }
+
+    FILE *fp = fdopen(fd, "wb");
+    if(!fp) {
+        close(fd);
+        unlink(tmp.c_str());
+        return PLCTAG_ERR_OPEN;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && fwrite(program_names.data(), sizeof(uint32_t), program_names.size(), fp) == program_names.size();
+    ok = ok && fwrite(tags.data(), sizeof(catalog_tag_s), tags.size(), fp) == tags.size();
+    ok = ok && fwrite(udts.data(), sizeof(catalog_udt_s), udts.size(), fp) == udts.size();
+    ok = ok && fwrite(fields.data(), sizeof(catalog_field_s), fields.size(), fp) == fields.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), fp) == strings.size();
+    ok = (fclose(fp) == 0) && ok;
+
+    if(!ok || rename(tmp.c_str(), file.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return PLCTAG_ERR_WRITE;
+    }
+
+    return PLCTAG_STATUS_OK;
+}
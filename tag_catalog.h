@@ -0,0 +1,47 @@
+#ifndef TAG_CATALOG_H
+#define TAG_CATALOG_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "list_tags.h"
+#include "tag_table.h"
+
+#define TAG_CATALOG_MAGIC "PTCG"
+#define TAG_CATALOG_VERSION 2
+
+/*
+ * On-disk tag/UDT catalog, one file per gateway+path.
+ *
+ * list_tags() stores what it enumerated (controller and program tags plus all
+ * UDT definitions) together with the size and a hash of the raw controller
+ * @tags listing and the names of the programs in it. On the next run the
+ * controller listing is read again and, when it and the program list still
+ * match, the catalog is used instead of reading every Program:*.@tags and
+ * @udt/<id>. The hash covers every entry's instance ID, type and name, so a
+ * tag retyped or replaced by one with a name of the same length is noticed.
+ *
+ * Layout (host byte order, the magic doubles as an endian check):
+ *   header
+ *   uint32_t program_names[program_count]       string offsets
+ *   catalog_tag_s tags[tag_count]
+ *   catalog_udt_s udts[udt_count]
+ *   catalog_field_s fields[field_count]
+ *   char strings[strings_size]                  zero terminated, offset 0 is ""
+ */
+
+/* file the catalog for this gateway/path lives in, empty if there is no cache directory */
+std::string tagCatalogPath(const std::string &gateway, const std::string &path);
+
+/* FNV-1a of the raw controller listing, what listing_hash is compared against */
+uint64_t tagCatalogHash(const uint8_t *data, size_t size);
+
+/* PLCTAG_STATUS_OK if the file exists, is intact and matches listing_size/listing_hash/programs (sorted) */
+int loadTagCatalog(const std::string &file, uint32_t listing_size, uint64_t listing_hash, const std::vector<std::string> &programs,
+                   TagTable &tags, std::vector<UdtEntry> &udtentries);
+
+int saveTagCatalog(const std::string &file, uint32_t listing_size, uint64_t listing_hash, const std::vector<std::string> &programs,
+                   const TagTable &tags, const std::vector<UdtEntry> &udtentries);
+
+#endif // TAG_CATALOG_H
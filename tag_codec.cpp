@@ -0,0 +1,171 @@
+#include <libplctag.h>
+#include <array>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tag_codec.h"
+#include "plctags.h"
+#include "utility.h"
+
+
+template <typename T>
+static T getElement(int32_t tag, int offset, int bit) {
+    if        constexpr (std::is_same_v<T, bool>) {
+        return plc_tag_get_bit(tag, offset * 8 + bit) == 1;
+    } else if constexpr (std::is_same_v<T, int8_t>) {
+        return plc_tag_get_int8(tag, offset);
+    } else if constexpr (std::is_same_v<T, uint8_t>) {
+        return plc_tag_get_uint8(tag, offset);
+    } else if constexpr (std::is_same_v<T, int16_t>) {
+        return plc_tag_get_int16(tag, offset);
+    } else if constexpr (std::is_same_v<T, uint16_t>) {
+        return plc_tag_get_uint16(tag, offset);
+    } else if constexpr (std::is_same_v<T, int32_t>) {
+        return plc_tag_get_int32(tag, offset);
+    } else if constexpr (std::is_same_v<T, uint32_t>) {
+        return plc_tag_get_uint32(tag, offset);
+    } else if constexpr (std::is_same_v<T, int64_t>) {
+        return plc_tag_get_int64(tag, offset);
+    } else if constexpr (std::is_same_v<T, uint64_t>) {
+        return plc_tag_get_uint64(tag, offset);
+    } else if constexpr (std::is_same_v<T, float_t>) {
+        return plc_tag_get_float32(tag, offset);
+    } else {
+        return plc_tag_get_float64(tag, offset);
+    }
+}
+
+/* floats get enough digits to survive a read, edit, write round trip in section 3 */
+template <typename T>
+static string formatValue(T value) {
+    if        constexpr (std::is_same_v<T, float_t>) {
+        return ssprintf("%.9g", value);
+    } else if constexpr (std::is_same_v<T, double_t>) {
+        return ssprintf("%.15g", value);
+    } else {
+        return to_string(value);
+    }
+}
+
+template <typename T>
+static int32_t decodeAs(string &error_string, int32_t tag, vector<string> *display) {
+    /* reused so decode-only scans do not allocate per tag */
+    static thread_local vector<T> values;
+    values.clear();
+
+    int32_t rc = decodeNumericTag(error_string, tag, values);
+    if(rc == PLCTAG_STATUS_OK && display) {
+        for(size_t i = 0; i < values.size(); i++) { display->push_back(formatValue<T>(values[i])); }
+    }
+
+    return rc;
+}
+
+template <typename T>
+static int32_t writeAs(string &error_string, int32_t tag, const vector<string> &display, int time_out_ms) {
+    vector<T> values = toNumericVector<T>(display);
+    return writeNumericTag(error_string, tag, values, time_out_ms);
+}
+
+template <typename T>
+static string formatAs(int32_t tag, int offset, int bit) {
+    return formatValue<T>(getElement<T>(tag, offset, bit));
+}
+
+template <typename T>
+static string formatRawAs(const uint8_t *elem) {
+    if constexpr (std::is_same_v<T, bool>) {
+        return formatValue<bool>(elem[0] != 0);
+    } else {
+        T value;
+        memcpy(&value, elem, sizeof(T));
+        return formatValue<T>(value);
+    }
+}
+
+template <typename T>
+static constexpr TagCodec numericCodec(uint16_t type, const char *name, uint8_t elem_size) {
+    return { type, name, elem_size, decodeAs<T>, writeAs<T>, formatAs<T>, formatRawAs<T> };
+}
+
+
+static int32_t decodeString(string &error_string, int32_t tag, vector<string> *display) {
+    if(display) return decodeStringTag(error_string, tag, *display);
+
+    /* decode only: views into the snapshot, nothing is copied */
+    static thread_local vector<string_view> views;
+    views.clear();
+
+    return decodeStringTagViews(error_string, tag, views);
+}
+
+static int32_t writeString(string &error_string, int32_t tag, const vector<string> &display, int time_out_ms) {
+    return writeStringTag(error_string, tag, display, time_out_ms);
+}
+
+
+/* 4 byte LEN, then the data, see STRING_LGX_ELEM_SIZE */
+static string formatStringRaw(const uint8_t *elem) {
+    int32_t len;
+    memcpy(&len, elem, sizeof(len));
+    len = len < 0 ? 0 : min(len, STRING_LGX_DATA_SIZE);
+
+    return string(reinterpret_cast<const char *>(elem + 4), (size_t)len);
+}
+
+
+static constexpr std::array<TagCodec, 256> makeCodecTable() {
+    std::array<TagCodec, 256> table{};
+
+    table[0xC0] = numericCodec<int64_t>(0xC0, "DT", 8);
+    table[0xC1] = numericCodec<bool>(0xC1, "BIT", 1);
+    table[0xC2] = numericCodec<int8_t>(0xC2, "SINT", 1);
+    table[0xC3] = numericCodec<int16_t>(0xC3, "INT", 2);
+    table[0xC4] = numericCodec<int32_t>(0xC4, "DINT", 4);
+    table[0xC5] = numericCodec<int64_t>(0xC5, "LINT", 8);
+    table[0xC6] = numericCodec<uint8_t>(0xC6, "USINT", 1);
+    table[0xC7] = numericCodec<uint16_t>(0xC7, "UINT", 2);
+    table[0xC8] = numericCodec<uint32_t>(0xC8, "UDINT", 4);
+    table[0xC9] = numericCodec<uint64_t>(0xC9, "ULINT", 8);
+    table[0xCA] = numericCodec<float_t>(0xCA, "REAL", 4);
+    table[0xCB] = numericCodec<double_t>(0xCB, "LREAL", 8);
+    table[0xD1] = numericCodec<uint8_t>(0xD1, "BYTE", 1);
+    table[0xD2] = numericCodec<uint16_t>(0xD2, "WORD", 2);
+    table[0xD3] = numericCodec<uint32_t>(0xD3, "DWORD", 4);    /* also BOOL arrays */
+    table[0xD4] = numericCodec<uint64_t>(0xD4, "LWORD", 8);
+    table[0xD7] = numericCodec<int64_t>(0xD7, "LTIME", 8);
+
+    return table;
+}
+
+static constexpr std::array<TagCodec, 256> tag_codecs = makeCodecTable();
+
+static constexpr TagCodec string_lgx_codec = { CIP_TYPE_STRING_LGX, "STRING_LGX", 0, decodeString, writeString, nullptr, formatStringRaw };
+
+
+const TagCodec *tagCodec(uint16_t type) {
+    if(type & 0x8000) {
+        /* struct: only the built in STRING has a fixed codec, the dimension bits do not matter */
+        return (type & 0x9fff) == CIP_TYPE_STRING_LGX ? &string_lgx_codec : nullptr;
+    }
+
+    const TagCodec *codec = &tag_codecs[type & 0xff];
+    return codec->type ? codec : nullptr;
+}
+
+
+const TagCodec *tagCodecForUiType(const string &ui_type) {
+    static const struct { const char *ui_type; uint16_t type; } ui_types[] = {
+        { "BIT", 0xC1 },    { "BOOL", 0xC2 },
+        { "INT8", 0xC2 },   { "INT16", 0xC3 },  { "INT32", 0xC4 },  { "INT64", 0xC5 },
+        { "UINT8", 0xC6 },  { "UINT16", 0xC7 }, { "UINT32", 0xC8 }, { "UINT64", 0xC9 },
+        { "REAL32", 0xCA }, { "REAL64", 0xCB }, { "STRING", CIP_TYPE_STRING_LGX },
+    };
+
+    for(const auto &t : ui_types) {
+        if(ui_type == t.ui_type) return tagCodec(t.type);
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,44 @@
+#ifndef TAG_CODEC_H
+#define TAG_CODEC_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+#define CIP_TYPE_STRING_LGX ((uint16_t)0x8fce)
+
+/*
+ * Per CIP type codec, looked up by type code instead of by getTagType() name.
+ *
+ * Atomic types live in a flat table indexed by the low byte of the type code
+ * (the listing puts array dimensions and BOOL bit numbers in the high bits);
+ * STRING_LGX is the one struct type with a codec of its own. UDT instances are
+ * decoded from their flattened template, see UdtLayouts::find().
+ */
+struct TagCodec {
+    uint16_t type;          /* CIP type code, 0 marks an empty table slot */
+    const char *name;       /* same spelling as cip_data_map */
+    uint8_t elem_size;      /* bytes per element in the tag buffer, 0 for strings */
+
+    /* an already read tag, appended to display as strings; display may be nullptr to only decode */
+    int32_t (*decode)(string &error_string, int32_t tag, vector<string> *display);
+
+    /* parse the display strings into the tag buffer and write it */
+    int32_t (*write)(string &error_string, int32_t tag, const vector<string> &values, int time_out_ms);
+
+    /* one element of an already read buffer at offset (bit is only used by BIT), nullptr for strings */
+    string (*format)(int32_t tag, int offset, int bit);
+
+    /* one element copied out of a little endian tag buffer (recordings), strings included */
+    string (*format_raw)(const uint8_t *elem);
+};
+
+/* nullptr for types we have no codec for (UDTs, system structs, unknown codes) */
+const TagCodec *tagCodec(uint16_t type);
+
+/* codec for a type name of the GUI type field (INT8, REAL32, STRING, ...), nullptr if unknown */
+const TagCodec *tagCodecForUiType(const string &ui_type);
+
+#endif // TAG_CODEC_H
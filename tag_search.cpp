@@ -0,0 +1,277 @@
+#include <libplctag.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+#include "tag_search.h"
+#include "plctags.h"
+#include "utility.h"
+
+
+#define SEARCH_DIM_MASK ((uint16_t)0x6000)      /* array dimension bits of a listed type */
+
+
+static string lowerCase(string_view s) {
+    string r(s);
+    for(char &c : r) c = (char)tolower((unsigned char)c);
+    return r;
+}
+
+static string upperCase(const string &s) {
+    string r = s;
+    for(char &c : r) c = (char)toupper((unsigned char)c);
+    return r;
+}
+
+static uint32_t gramAt(string_view s, size_t pos) {
+    return (uint32_t)(uint8_t)s[pos] << 16 | (uint32_t)(uint8_t)s[pos + 1] << 8 | (uint32_t)(uint8_t)s[pos + 2];
+}
+
+
+//===============================================================================================================
+// TagSearchQuery
+
+int32_t TagSearchQuery::parse(string &error_string, const string &text) {
+    std::stringstream ss(text);
+    string word;
+
+    words.clear();
+    type = TAG_SEARCH_NO_TYPE;
+    program.clear();
+
+    while(ss >> word) {
+        if(word.compare(0, 5, "type:") == 0 && word.size() > 5) {
+            string name = word.substr(5);
+            char *end = nullptr;
+
+            type = getTagTypeCode(upperCase(name));
+            if(type == TAG_SEARCH_NO_TYPE) type = (uint16_t)strtoul(name.c_str(), &end, 16);
+            if(type == TAG_SEARCH_NO_TYPE || (end && *end)) {
+                error_string = ssprintf("unknown type %s", name.c_str());
+                type = TAG_SEARCH_NO_TYPE;
+                return PLCTAG_ERR_BAD_PARAM;
+            }
+        } else if(word.compare(0, 5, "prog:") == 0 && word.size() > 5) {
+            program = lowerCase(word.substr(5));
+        } else {
+            words.push_back(lowerCase(word));
+        }
+    }
+
+    return PLCTAG_STATUS_OK;
+}
+
+
+
+//===============================================================================================================
+// TagSearchIndex
+
+void TagSearchIndex::clear() {
+    docs.clear();
+    keys.clear();
+    by_key.clear();
+    postings.clear();
+    by_type.clear();
+    programs.assign(1, "");
+    program_ids.clear();
+    by_program.assign(1, {});
+    live_count = 0;
+    have_last = false;
+}
+
+uint32_t TagSearchIndex::addDoc(const string &key, uint16_t type, uint32_t program) {
+    uint32_t id = (uint32_t)docs.size();
+    docs.push_back({ (uint32_t)keys.size(), (uint32_t)key.size(), type, program, 0, false });
+    keys += key;
+    by_type[type & ~SEARCH_DIM_MASK].push_back(id);
+    by_program[program].push_back(id);
+
+    /* ids only grow, so every posting list stays sorted */
+    for(size_t i = 0; i + TAG_SEARCH_GRAM <= key.size(); i++) {
+        vector<uint32_t> &list = postings[gramAt(key, i)];
+        if(list.empty() || list.back() != id) list.push_back(id);
+    }
+
+    return id;
+}
+
+void TagSearchIndex::rebuild(const TagTable &tags) {
+    clear();
+    update(tags);
+}
+
+void TagSearchIndex::update(const TagTable &tags) {
+    if(programs.empty()) {
+        programs.assign(1, "");
+        by_program.assign(1, {});
+    }
+
+    for(Doc &doc : docs) doc.live = false;
+    live_count = 0;
+    have_last = false;
+
+    for(uint32_t e = 0; e < (uint32_t)tags.size(); e++) {
+        uint16_t type = tags.type(e);
+        string parent = lowerCase(tags.parent(e));
+        string key = parent.empty() ? lowerCase(tags.name(e)) : parent + "." + lowerCase(tags.name(e));
+
+        uint32_t program = 0;
+        if(!parent.empty()) {
+            auto [it, added] = program_ids.emplace(parent, (uint32_t)programs.size());
+            if(added) {
+                programs.push_back(parent);
+                by_program.emplace_back();
+            }
+            program = it->second;
+        }
+
+        /* the type is part of the identity: a tag that changed type is a different document */
+        string identity = key;
+        identity.append(1, '\0').append((const char *)&type, sizeof(type));
+
+        auto [it, added] = by_key.emplace(identity, 0);
+        if(added) it->second = addDoc(key, type, program);
+
+        Doc &doc = docs[it->second];
+        if(!doc.live) live_count++;
+        doc.live = true;
+        doc.entry = e;
+    }
+
+    if(docs.size() > 2 * live_count + 1024) rebuild(tags);
+}
+
+bool TagSearchIndex::matches(const Doc &doc, const TagSearchQuery &query) const {
+    if(!doc.live) return false;
+
+    if(query.type != TAG_SEARCH_NO_TYPE && (doc.type & ~SEARCH_DIM_MASK) != (query.type & ~SEARCH_DIM_MASK)) return false;
+
+    if(query.program == "-") {
+        if(doc.program != 0) return false;
+    } else if(!query.program.empty()) {
+        if(doc.program == 0 || programs[doc.program].find(query.program) == string::npos) return false;
+    }
+
+    string_view name = key(doc);
+    for(const string &word : query.words) {
+        if(name.find(word) == string::npos) return false;
+    }
+
+    return true;
+}
+
+/* every hit of query is a hit of the last query: same filters, and each old word is inside a new one */
+bool TagSearchIndex::narrows(const TagSearchQuery &query) const {
+    if(!have_last || !query.sameFilters(last_query)) return false;
+
+    for(const string &old_word : last_query.words) {
+        bool kept = false;
+        for(const string &word : query.words) {
+            if(word.find(old_word) != string::npos) { kept = true; break; }
+        }
+        if(!kept) return false;
+    }
+
+    return true;
+}
+
+/*
+ * docs holding every trigram of word, a superset of the docs holding word.
+ * false, and nothing done, when that cannot get below limit docs.
+ */
+bool TagSearchIndex::candidates(const string &word, size_t limit, vector<uint32_t> &result) const {
+    vector<const vector<uint32_t> *> lists;
+
+    result.clear();
+    for(size_t i = 0; i + TAG_SEARCH_GRAM <= word.size(); i++) {
+        auto it = postings.find(gramAt(word, i));
+        if(it == postings.end()) return true;
+        lists.push_back(&it->second);
+    }
+
+    sort(lists.begin(), lists.end(), [](const vector<uint32_t> *a, const vector<uint32_t> *b) { return a->size() < b->size(); });
+    if(lists[0]->size() >= limit) return false;
+
+    result = *lists[0];
+    for(size_t l = 1; l < lists.size() && !result.empty(); l++) {
+        const vector<uint32_t> &list = *lists[l];
+        size_t kept = 0;
+        auto from = list.begin();
+
+        for(uint32_t id : result) {
+            from = lower_bound(from, list.end(), id);
+            if(from == list.end()) break;
+            if(*from == id) result[kept++] = id;
+        }
+        result.resize(kept);
+    }
+
+    return true;
+}
+
+/* docs of every program whose name holds part, "-" for controller scope */
+void TagSearchIndex::programDocs(const string &part, vector<uint32_t> &result) const {
+    result.clear();
+    if(part == "-") {
+        result = by_program[0];
+        return;
+    }
+
+    size_t merged = 0;
+    for(uint32_t p = 1; p < (uint32_t)programs.size(); p++) {
+        if(programs[p].find(part) == string::npos) continue;
+
+        result.insert(result.end(), by_program[p].begin(), by_program[p].end());
+        if(merged++) inplace_merge(result.begin(), result.end() - by_program[p].size(), result.end());
+    }
+}
+
+void TagSearchIndex::search(const TagSearchQuery &query, vector<uint32_t> &hits) {
+    static const vector<uint32_t> none;
+    vector<uint32_t> found, word_docs, program_docs;
+    const vector<uint32_t> *base = nullptr;     /* sorted docs every hit is in, nullptr for all docs */
+
+    auto consider = [&](const vector<uint32_t> *list) {
+        if(!base || list->size() < base->size()) base = list;
+    };
+
+    /* start from the shortest list that must hold every hit */
+    const string *longest = nullptr;
+    for(const string &word : query.words) {
+        if(word.size() >= TAG_SEARCH_GRAM && (!longest || word.size() > longest->size())) longest = &word;
+    }
+
+    if(narrows(query)) consider(&last_docs);
+    if(query.type != TAG_SEARCH_NO_TYPE) {
+        auto it = by_type.find(query.type & ~SEARCH_DIM_MASK);
+        consider(it == by_type.end() ? &none : &it->second);
+    }
+    if(!query.program.empty()) {
+        programDocs(query.program, program_docs);
+        consider(&program_docs);
+    }
+    if(longest && candidates(*longest, base ? base->size() : docs.size(), word_docs)) consider(&word_docs);
+
+    if(base) {
+        for(uint32_t id : *base) {
+            if(matches(docs[id], query)) found.push_back(id);
+        }
+    } else {
+        for(uint32_t id = 0; id < (uint32_t)docs.size(); id++) {
+            if(matches(docs[id], query)) found.push_back(id);
+        }
+    }
+
+    /* doc order is listing order until a re-list adds tags in the middle */
+    hits.resize(found.size());
+    for(size_t i = 0; i < found.size(); i++) hits[i] = docs[found[i]].entry;
+    if(!is_sorted(hits.begin(), hits.end())) sort(hits.begin(), hits.end());
+
+    last_query = query;
+    last_docs.swap(found);
+    have_last = true;
+}
@@ -0,0 +1,94 @@
+#ifndef TAG_SEARCH_H
+#define TAG_SEARCH_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "tag_table.h"
+
+using namespace std;
+
+#define TAG_SEARCH_GRAM 3               /* n-gram length of the index */
+#define TAG_SEARCH_NO_TYPE 0            /* type filter off */
+
+/*
+ * What the user typed, e.g. "type:DINT prog:main motor spd".
+ *
+ * Plain words must all be found in the full tag name (Program:Main.Motor_1.Speed),
+ * in any order and ignoring case. "type:" takes a CIP type name or a hex code,
+ * "prog:" a part of the program name, or "-" for controller scoped tags.
+ */
+struct TagSearchQuery {
+    vector<string> words;       /* lower case */
+    uint16_t type = TAG_SEARCH_NO_TYPE;
+    string program;             /* lower case, empty for any */
+
+    int32_t parse(string &error_string, const string &text);
+    bool sameFilters(const TagSearchQuery &other) const { return type == other.type && program == other.program; }
+};
+
+/*
+ * Trigram index over the full names of a tag listing.
+ *
+ * Every tag is a document; every three character window of its lower case
+ * name points to it. A word of three or more characters is looked up by
+ * intersecting the posting lists of its trigrams, smallest first, and the few
+ * candidates left are checked with a plain substring search. The type and
+ * program filters have document lists of their own; a query starts from the
+ * shortest list that must hold all of its hits and checks the rest on those.
+ *
+ * update() keeps documents across listings: a re-list only indexes the tags
+ * that are new and marks the missing ones dead, the index is rebuilt once more
+ * than half of it is dead. A query that only extends the previous one (one
+ * more character or one more word, same filters) can also start from the
+ * previous hits, so typing stays cheap however long the list is.
+ */
+class TagSearchIndex {
+public:
+    void update(const TagTable &tags);
+    void clear();
+
+    size_t size() const { return live_count; }
+
+    /* rows of the table of the last update(), in listing order */
+    void search(const TagSearchQuery &query, vector<uint32_t> &hits);
+
+private:
+    struct Doc {
+        uint32_t key;           /* lower case full name in keys */
+        uint32_t key_len;
+        uint16_t type;
+        uint32_t program;       /* into programs, 0 is controller scope */
+        uint32_t entry;         /* index in the last listing */
+        bool live;
+    };
+
+    uint32_t addDoc(const string &key, uint16_t type, uint32_t program);
+    void rebuild(const TagTable &tags);
+    bool matches(const Doc &doc, const TagSearchQuery &query) const;
+    bool narrows(const TagSearchQuery &query) const;
+    bool candidates(const string &word, size_t limit, vector<uint32_t> &docs) const;
+    void programDocs(const string &part, vector<uint32_t> &docs) const;
+
+    string_view key(const Doc &doc) const { return string_view(keys).substr(doc.key, doc.key_len); }
+
+    vector<Doc> docs;
+    string keys;                                            /* all names back to back, a scan stays in cache */
+    unordered_map<string, uint32_t> by_key;                 /* key + type -> doc */
+    unordered_map<uint32_t, vector<uint32_t>> postings;     /* trigram -> docs, ascending */
+    unordered_map<uint16_t, vector<uint32_t>> by_type;      /* type without dimension bits -> docs */
+    vector<string> programs;                                /* lower case, programs[0] = "" */
+    unordered_map<string, uint32_t> program_ids;
+    vector<vector<uint32_t>> by_program;                    /* program -> docs */
+    size_t live_count = 0;
+
+    /* the last query and its hits as doc ids, for narrowing */
+    TagSearchQuery last_query;
+    vector<uint32_t> last_docs;
+    bool have_last = false;
+};
+
+#endif // TAG_SEARCH_H
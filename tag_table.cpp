@@ -0,0 +1,144 @@
+#include <string>
+#include <vector>
+
+#include "tag_table.h"
+
+
+//===============================================================================================================
+// TagTable
+
+void TagTable::clear() {
+    arena.assign(1, '\0');
+    interned.clear();
+
+    names.clear();
+    parents.clear();
+    instance_ids.clear();
+    types.clear();
+    elem_sizes.clear();
+    elem_counts.clear();
+    num_dimensions.clear();
+    dimensions.clear();
+}
+
+void TagTable::reserve(size_t rows, size_t name_bytes) {
+    arena.reserve(arena.size() + name_bytes);
+
+    names.reserve(rows);
+    parents.reserve(rows);
+    instance_ids.reserve(rows);
+    types.reserve(rows);
+    elem_sizes.reserve(rows);
+    elem_counts.reserve(rows);
+    num_dimensions.reserve(rows);
+    dimensions.reserve(rows * 3);
+}
+
+uint32_t TagTable::store(string_view s) {
+    if(s.empty()) return 0;
+
+    uint32_t offset = (uint32_t)arena.size();
+    arena.append(s);
+    arena.push_back('\0');
+
+    return offset;
+}
+
+uint32_t TagTable::intern(string_view s) {
+    if(s.empty()) return 0;
+
+#ifdef __cpp_lib_generic_unordered_lookup
+    auto it = interned.find(s);
+#else
+    intern_key.assign(s.data(), s.size());
+    auto it = interned.find(intern_key);
+#endif
+    if(it != interned.end()) return it->second;
+
+    uint32_t offset = store(s);
+    interned.emplace(string(s), offset);
+
+    return offset;
+}
+
+void TagTable::add(string_view name, string_view parent, uint16_t instance_id, uint16_t type, uint16_t elem_size,
+                   uint16_t elem_count, uint16_t dims, const uint16_t dim[3]) {
+    parents.push_back(intern(parent));
+    names.push_back(store(name));
+    instance_ids.push_back(instance_id);
+    types.push_back(type);
+    elem_sizes.push_back(elem_size);
+    elem_counts.push_back(elem_count);
+    num_dimensions.push_back(dims);
+    dimensions.insert(dimensions.end(), dim, dim + 3);
+}
+
+void TagTable::add(const TagEntry &e) {
+    add(e.name, e.parentName, e.instance_id, e.type, e.elem_size, e.elem_count, e.num_dimensions, e.dimensions);
+}
+
+void TagTable::append(const TagTable &other) {
+    if(empty()) {
+        *this = other;
+        return;
+    }
+
+    reserve(other.size(), other.arena.size());
+    for(size_t row = 0; row < other.size(); row++) {
+        add(other.name(row), other.parent(row), other.instance_ids[row], other.types[row], other.elem_sizes[row],
+            other.elem_counts[row], other.num_dimensions[row], &other.dimensions[row * 3]);
+    }
+}
+
+string_view TagTable::fullName(size_t row, string &scratch) const {
+    if(parents[row] == 0) return name(row);
+
+    scratch.assign(parent(row));
+    scratch.push_back('.');
+    scratch.append(name(row));
+
+    return scratch;
+}
+
+TagEntry TagTable::entry(size_t row) const {
+    return { row + 1 < size() ? string(name(row + 1)) : "", string(name(row)), string(parent(row)),
+             instance_ids[row], types[row], elem_sizes[row], elem_counts[row], num_dimensions[row],
+             { dimensions[row * 3], dimensions[row * 3 + 1], dimensions[row * 3 + 2] } };
+}
+
+void TagTable::toEntries(vector<TagEntry> &entries) const {
+    entries.reserve(entries.size() + size());
+    for(size_t row = 0; row < size(); row++) entries.push_back(entry(row));
+}
+
+void TagTable::moveRow(size_t from, size_t to) {
+    names[to] = names[from];
+    parents[to] = parents[from];
+    instance_ids[to] = instance_ids[from];
+    types[to] = types[from];
+    elem_sizes[to] = elem_sizes[from];
+    elem_counts[to] = elem_counts[from];
+    num_dimensions[to] = num_dimensions[from];
+    for(int d = 0; d < 3; d++) dimensions[to * 3 + d] = dimensions[from * 3 + d];
+}
+
+void TagTable::resize(size_t rows) {
+    names.resize(rows);
+    parents.resize(rows);
+    instance_ids.resize(rows);
+    types.resize(rows);
+    elem_sizes.resize(rows);
+    elem_counts.resize(rows);
+    num_dimensions.resize(rows);
+    dimensions.resize(rows * 3);
+}
+
+size_t TagTable::bytes() const {
+    size_t interned_bytes = 0;
+    for(const auto &[s, offset] : interned) interned_bytes += sizeof(s) + s.capacity() + sizeof(offset);
+
+    return arena.capacity() + interned_bytes
+           + names.capacity() * sizeof(uint32_t) + parents.capacity() * sizeof(uint32_t)
+           + (instance_ids.capacity() + types.capacity() + elem_sizes.capacity() + elem_counts.capacity()
+              + num_dimensions.capacity() + dimensions.capacity()) * sizeof(uint16_t);
+}
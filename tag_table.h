@@ -0,0 +1,97 @@
+#ifndef TAG_TABLE_H
+#define TAG_TABLE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <stdint.h>
+
+#include "list_tags.h"
+
+using namespace std;
+
+/*
+ * A tag listing stored column by column.
+ *
+ * Names live back to back in one zero terminated string arena and the rows
+ * hold 32 bit offsets into it; offset 0 is "". Parent names (Program:Main)
+ * are interned, so the tags of a program all point at one copy. A row costs
+ * 24 bytes plus its name, where a TagEntry costs three std::string and often
+ * a heap block for each.
+ *
+ * Views returned by name(), parent() and fullName() point into the arena or
+ * the caller's scratch string and stay valid until the next add().
+ */
+class TagTable {
+public:
+    TagTable() { clear(); }
+
+    void clear();
+    void reserve(size_t rows, size_t name_bytes);
+    size_t size() const { return names.size(); }
+    bool empty() const { return names.empty(); }
+
+    void add(string_view name, string_view parent, uint16_t instance_id, uint16_t type, uint16_t elem_size,
+             uint16_t elem_count, uint16_t num_dimensions, const uint16_t dimensions[3]);
+    void add(const TagEntry &e);
+    void append(const TagTable &other);
+
+    string_view name(size_t row) const { return arena.data() + names[row]; }
+    string_view parent(size_t row) const { return arena.data() + parents[row]; }
+    uint16_t instanceId(size_t row) const { return instance_ids[row]; }
+    uint16_t type(size_t row) const { return types[row]; }
+    uint16_t elemSize(size_t row) const { return elem_sizes[row]; }
+    uint16_t elemCount(size_t row) const { return elem_counts[row]; }
+    uint16_t numDimensions(size_t row) const { return num_dimensions[row]; }
+    uint16_t dimension(size_t row, int d) const { return dimensions[row * 3 + d]; }
+
+    /* "Parent.Name"; controller scope tags are a view of the arena, program tags are joined in scratch */
+    string_view fullName(size_t row, string &scratch) const;
+
+    TagEntry entry(size_t row) const;
+    void toEntries(vector<TagEntry> &entries) const;    /* appends, nextName is the following row */
+
+    /* drops the rows keep(row) is false for, in place; their names stay in the arena */
+    template<class F> void keepIf(F keep) {
+        size_t kept = 0;
+        for(size_t row = 0; row < size(); row++) {
+            if(!keep(row)) continue;
+            if(kept != row) moveRow(row, kept);
+            kept++;
+        }
+        resize(kept);
+    }
+
+    size_t bytes() const;
+
+private:
+    uint32_t store(string_view s);
+    uint32_t intern(string_view s);
+    void moveRow(size_t from, size_t to);
+    void resize(size_t rows);
+
+    /* hashes a string and a string_view of it alike, so intern() looks up views without building a string */
+    struct InternHash {
+        using is_transparent = void;
+        size_t operator()(string_view s) const { return std::hash<string_view>()(s); }
+    };
+
+    string arena;
+    unordered_map<string, uint32_t, InternHash, std::equal_to<>> interned;
+#ifndef __cpp_lib_generic_unordered_lookup
+    string intern_key;      /* before C++20 find() takes only the key type, this buffer is reused for it */
+#endif
+
+    vector<uint32_t> names;
+    vector<uint32_t> parents;
+    vector<uint16_t> instance_ids;
+    vector<uint16_t> types;
+    vector<uint16_t> elem_sizes;
+    vector<uint16_t> elem_counts;
+    vector<uint16_t> num_dimensions;
+    vector<uint16_t> dimensions;        /* three per row */
+};
+
+#endif // TAG_TABLE_H
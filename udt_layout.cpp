@@ -0,0 +1,138 @@
+#include <libplctag.h>
+#include <string>
+#include <vector>
+
+#include "udt_layout.h"
+#include "tag_codec.h"
+#include "plctags.h"
+#include "utility.h"
+
+
+int udtAtomicSize(uint16_t type) {
+    const TagCodec *codec = (type & TYPE_IS_STRUCT) ? nullptr : tagCodec(type);
+    return codec ? codec->elem_size : 0;
+}
+
+
+void UdtLayouts::build(const vector<UdtEntry> &udts) {
+    definitions.clear();
+    layouts.clear();
+    by_id.clear();
+
+    for(const auto &udt : udts) { definitions[udt.id] = &udt; }
+    for(const auto &udt : udts) { flatten(udt.id, 0); }
+
+    /* the layouts are self contained, the definitions can go away */
+    definitions.clear();
+
+    /* the map nodes do not move any more, index them by id for find() */
+    by_id.assign((size_t)TYPE_UDT_ID_MASK + 1, nullptr);
+    for(const auto &kv : layouts) {
+        if(!kv.second.leaves.empty()) { by_id[kv.first & TYPE_UDT_ID_MASK] = &kv.second; }
+    }
+}
+
+
+const UdtLayout *UdtLayouts::flatten(uint16_t id, int depth) {
+    auto done = layouts.find(id);
+    if(done != layouts.end()) { return &done->second; }
+
+    auto def_it = definitions.find(id);
+    if(def_it == definitions.end() || depth > UDT_MAX_DEPTH) { return nullptr; }
+    const UdtEntry &def = *def_it->second;
+
+    UdtLayout layout = { id, def.name, def.instance_size, {}, 0 };
+
+    /* STRING and the user defined STRINGnn types are a DINT LEN followed by SINT DATA[n], decode those whole */
+    if(def.fields.size() == 2 && def.fields[0].name == "LEN" && (def.fields[0].type & 0xff) == 0xC4
+       && def.fields[1].name == "DATA" && (def.fields[1].type & 0xff) == 0xC2) {
+        layout.leaves.push_back({ "", UDT_LEAF_STRING, 0, 0, def.fields[1].metadata });
+        return &(layouts[id] = layout);
+    }
+
+    for(const auto &field : def.fields) {
+        /* hidden host bytes for BOOL members and unnamed padding */
+        if(field.name.empty() || field.name.rfind("ZZZZZZZZZZ", 0) == 0) { continue; }
+
+        bool is_array = (field.type & UDT_FIELD_IS_ARRAY) != 0;
+        int count = is_array ? (field.metadata > 0 ? field.metadata : 1) : 1;
+
+        if(field.type & TYPE_IS_STRUCT) {
+            const UdtLayout *child = (field.type & TYPE_IS_SYSTEM) ? nullptr : flatten(field.type & TYPE_UDT_ID_MASK, depth + 1);
+            if(!child || child->leaves.empty()) {
+                layout.skipped++;
+                continue;
+            }
+
+            for(int i = 0; i < count; i++) {
+                string prefix = is_array ? field.name + "[" + to_string(i) + "]" : field.name;
+                uint32_t base = field.offset + (uint32_t)i * child->instance_size;
+
+                for(const auto &leaf : child->leaves) {
+                    layout.leaves.push_back({ leaf.name.empty() ? prefix : prefix + "." + leaf.name,
+                                              leaf.type, base + leaf.offset, leaf.bit, leaf.capacity });
+                }
+            }
+        } else {
+            uint16_t type = field.type & 0xff;
+            int size = udtAtomicSize(type);
+
+            if(size == 0) {
+                layout.skipped++;
+                continue;
+            }
+
+            if(type == 0xC1) {
+                /* BOOL member, metadata is the bit number in the host byte */
+                layout.leaves.push_back({ field.name, type, field.offset, field.metadata, 0 });
+                continue;
+            }
+
+            for(int i = 0; i < count; i++) {
+                layout.leaves.push_back({ is_array ? field.name + "[" + to_string(i) + "]" : field.name,
+                                          type, field.offset + (uint32_t)(i * size), 0, 0 });
+            }
+        }
+    }
+
+    return &(layouts[id] = layout);
+}
+
+
+int32_t decodeUdtLeaves(string &error_string, int32_t tag, const UdtLayout &layout, int base_offset, vector<string> &values) {
+    uint64_t start_ns = latencyNowNs();
+    int tag_size = plc_tag_get_size(tag);
+
+    if(tag_size < 0) {
+        error_string = ssprintf("ERROR: Unable to get the tag size! Error code %d: %s\n", tag_size, plc_tag_decode_error(tag_size));
+        return tag_size;
+    }
+
+    for(const auto &leaf : layout.leaves) {
+        int offset = base_offset + (int)leaf.offset;
+        int size = leaf.type == UDT_LEAF_STRING ? 4 + leaf.capacity : udtAtomicSize(leaf.type);
+
+        if(offset + size > tag_size) {
+            error_string = ssprintf("ERROR: %s.%s at offset %d is past the end of the %d byte tag!\n",
+                                    layout.name.c_str(), leaf.name.c_str(), offset, tag_size);
+            return PLCTAG_ERR_OUT_OF_BOUNDS;
+        }
+
+        if(leaf.type == UDT_LEAF_STRING) {
+            int32_t len = plc_tag_get_int32(tag, offset);
+            if(len < 0) len = 0;
+            if(len > leaf.capacity) len = leaf.capacity;
+
+            string s((size_t)len, '\0');
+            if(len > 0) { plc_tag_get_raw_bytes(tag, offset + 4, reinterpret_cast<uint8_t *>(&s[0]), len); }
+            values.push_back(s);
+        } else {
+            /* flatten() only keeps leaves udtAtomicSize() knows, so there is always a codec */
+            values.push_back(tagCodec(leaf.type)->format(tag, offset, leaf.bit));
+        }
+    }
+
+    recordLatency(TagOp::DECODE, TYPE_IS_STRUCT | layout.id, latencyNowNs() - start_ns);
+
+    return PLCTAG_STATUS_OK;
+}
@@ -0,0 +1,72 @@
+#ifndef UDT_LAYOUT_H
+#define UDT_LAYOUT_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "list_tags.h"
+
+#ifndef TYPE_IS_STRUCT
+#define TYPE_IS_STRUCT ((uint16_t)0x8000)
+#define TYPE_IS_SYSTEM ((uint16_t)0x1000)
+#define TYPE_UDT_ID_MASK ((uint16_t)0x0FFF)
+#endif
+
+#define UDT_FIELD_IS_ARRAY ((uint16_t)0x2000)   /* template field type flag, metadata is the element count */
+#define UDT_LEAF_STRING ((uint16_t)0x8fce)      /* leaf type used for any LEN/DATA string struct */
+#define UDT_MAX_DEPTH 16
+
+using namespace std;
+
+/* one decodable value inside a UDT instance */
+struct UdtLeaf {
+    string name;        /* path below the instance, e.g. "Ch0Config.RangeType" or "LIGHTS[1]" */
+    uint16_t type;      /* atomic CIP type, or UDT_LEAF_STRING */
+    uint32_t offset;    /* byte offset from the start of the instance */
+    uint16_t bit;       /* BIT leaves: bit number in the byte at offset */
+    uint16_t capacity;  /* string leaves: size of DATA */
+};
+
+struct UdtLayout {
+    uint16_t id;
+    string name;
+    uint32_t instance_size;
+    vector<UdtLeaf> leaves;
+    int skipped;        /* fields of a type we cannot decode */
+};
+
+/*
+ * Flattened UDT templates, built from the definitions list_tags() returns.
+ *
+ * Nested structs and arrays are expanded down to atomic leaves with absolute
+ * offsets, so one read of a whole instance can be decoded locally instead of
+ * reading every member as its own tag.
+ */
+class UdtLayouts {
+public:
+    void build(const vector<UdtEntry> &udts);
+    void clear() { layouts.clear(); by_id.clear(); }
+
+    /* layout for a tag/field type, nullptr for atomic types or templates we do not have */
+    const UdtLayout *find(uint16_t type) const {
+        if(!(type & TYPE_IS_STRUCT) || (type & TYPE_IS_SYSTEM) || by_id.empty()) { return nullptr; }
+        return by_id[type & TYPE_UDT_ID_MASK];
+    }
+
+private:
+    const UdtLayout *flatten(uint16_t id, int depth);
+
+    unordered_map<uint16_t, const UdtEntry *> definitions;
+    unordered_map<uint16_t, UdtLayout> layouts;
+    vector<const UdtLayout *> by_id;    /* indexed by template id, nullptr if there is nothing to decode */
+};
+
+/* byte size of an atomic CIP type, 0 if it is not one we decode */
+int udtAtomicSize(uint16_t type);
+
+/* decode every leaf of the instance starting at base_offset in an already read tag, formatted for display */
+int32_t decodeUdtLeaves(string &error_string, int32_t tag, const UdtLayout &layout, int base_offset, vector<string> &values);
+
+#endif // UDT_LAYOUT_H